@@ -0,0 +1,242 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
+#include <Bee8086/bee8086.h>
+#include <Bee8086/analyzer.h>
+using namespace bee8086;
+using namespace std;
+
+// Maps a raw image into an otherwise empty 1 MB address space
+class ImageInterface : public Bee8086Interface
+{
+    public:
+	ImageInterface(vector<uint8_t> &data, uint32_t addr) : image(data), base_addr(addr)
+	{
+
+	}
+
+	~ImageInterface()
+	{
+
+	}
+
+	uint8_t readByte(uint32_t addr)
+	{
+	    uint32_t offs = ((addr & 0xFFFFF) - base_addr);
+	    return (offs < image.size()) ? image[offs] : 0x00;
+	}
+
+	void writeByte(uint32_t addr, uint8_t val)
+	{
+	    return;
+	}
+
+	uint8_t portIn(uint16_t port)
+	{
+	    return 0xFF;
+	}
+
+	void portOut(uint16_t port, uint8_t val)
+	{
+	    return;
+	}
+
+	bool isInterruptOverride(uint8_t int_num)
+	{
+	    return false;
+	}
+
+	void interruptOverride(Bee8086 &state, uint8_t int_num)
+	{
+	    return;
+	}
+
+	uint32_t convertSeg(uint16_t seg, uint16_t offs)
+	{
+	    return (((seg << 4) + offs) & 0xFFFFF);
+	}
+
+    private:
+	vector<uint8_t> &image;
+	uint32_t base_addr = 0;
+};
+
+void printusage()
+{
+    cout << "Usage: Bee8086-Dasm [options] [image] ([load address]) ([number of threads])" << endl;
+    cout << "If no load address is specified, 512-byte images are loaded at 0x7C00 (boot sector)," << endl;
+    cout << "and images of up to 64 KB are loaded so that they end at 0xFFFFF (BIOS)." << endl;
+    cout << endl;
+    cout << "Options:" << endl;
+    cout << "--dot                 Print the control-flow graph in DOT format instead of a listing" << endl;
+    cout << "--json                Print the control-flow graph in JSON format instead of a listing" << endl;
+    cout << "--entry=SSSS:OOOO     Add an entry point for the control-flow graph" << endl;
+    cout << "--ivt                 Add the interrupt vector table entries as entry points" << endl;
+    cout << "(if no entry points are given, the boot sector or reset vector is used)" << endl;
+}
+
+// Parses a whole argument as an unsigned number, and returns false if it isn't one
+bool parsenumber(string str, int base, unsigned long &value)
+{
+    if (str.empty() || (str[0] == '-') || (str[0] == '+'))
+    {
+	return false;
+    }
+
+    char *end = NULL;
+    value = strtoul(str.c_str(), &end, base);
+    return (*end == '\0');
+}
+
+vector<uint8_t> loadfile(string filename)
+{
+    vector<uint8_t> temp;
+    ifstream file(filename.c_str(), ios::in | ios::binary | ios::ate);
+
+    if (!file.is_open())
+    {
+	cout << "Error: could not load " << filename << endl;
+	return temp;
+    }
+
+    streampos size = file.tellg();
+    temp.resize(size, 0);
+    file.seekg(0, ios::beg);
+    file.read((char*)temp.data(), size);
+    file.close();
+    return temp;
+}
+
+int main(int argc, char *argv[])
+{
+    vector<string> args;
+    string graph_format = "";
+    bool use_ivt = false;
+    Bee8086Analyzer analyzer;
+    size_t num_entries = 0;
+
+    for (int index = 1; index < argc; index++)
+    {
+	string arg = argv[index];
+
+	if ((arg == "--dot") || (arg == "--json"))
+	{
+	    graph_format = arg.substr(2);
+	}
+	else if (arg == "--ivt")
+	{
+	    use_ivt = true;
+	}
+	else if (arg.compare(0, 8, "--entry=") == 0)
+	{
+	    size_t colon = arg.find(':', 8);
+	    unsigned long seg = 0;
+	    unsigned long offs = 0;
+
+	    if ((colon == string::npos) || !parsenumber(arg.substr(8, (colon - 8)), 16, seg) || !parsenumber(arg.substr(colon + 1), 16, offs) || (seg > 0xFFFF) || (offs > 0xFFFF))
+	    {
+		printusage();
+		return 1;
+	    }
+
+	    analyzer.addentry(uint16_t(seg), uint16_t(offs));
+	    num_entries += 1;
+	}
+	else
+	{
+	    args.push_back(arg);
+	}
+    }
+
+    unsigned long load_addr = 0;
+    unsigned long num_threads = 0;
+
+    if (args.empty() || (args.size() > 3) || ((args.size() > 1) && !parsenumber(args[1], 16, load_addr)) || ((args.size() > 2) && !parsenumber(args[2], 10, num_threads)))
+    {
+	printusage();
+	return 1;
+    }
+
+    vector<uint8_t> image = loadfile(args[0]);
+
+    if (image.empty())
+    {
+	return 1;
+    }
+
+    uint32_t base_addr = 0;
+
+    if (args.size() > 1)
+    {
+	base_addr = (uint32_t(load_addr) & 0xFFFFF);
+    }
+    else if (image.size() == 512)
+    {
+	base_addr = 0x7C00;
+    }
+    else if (image.size() <= 0x10000)
+    {
+	base_addr = (0x100000 - image.size());
+    }
+
+    if (graph_format != "")
+    {
+	ImageInterface inter(image, base_addr);
+	analyzer.setinterface(&inter);
+
+	if (use_ivt)
+	{
+	    analyzer.addivtentries();
+	}
+	else if (num_entries == 0)
+	{
+	    if (base_addr == 0x7C00)
+	    {
+		analyzer.addentry(0x0000, 0x7C00);
+	    }
+	    else
+	    {
+		analyzer.addentry(0xFFFF, 0x0000);
+	    }
+	}
+
+	analyzer.analyze();
+
+	if (graph_format == "dot")
+	{
+	    analyzer.exportdot(cout);
+	}
+	else
+	{
+	    analyzer.exportjson(cout);
+	}
+
+	return 0;
+    }
+
+    Bee8086 core;
+    vector<Bee8086DasmLine> listing = core.disassembleimage(image.data(), image.size(), base_addr, int(min<unsigned long>(num_threads, INT_MAX)));
+
+    for (auto &line : listing)
+    {
+	stringstream bytes;
+	size_t offs = (line.addr - base_addr);
+
+	for (size_t index = 0; index < line.length; index++)
+	{
+	    uint8_t byte = ((offs + index) < image.size()) ? image[offs + index] : 0x00;
+	    bytes << hex << setw(2) << setfill('0') << int(byte) << " ";
+	}
+
+	cout << hex << uppercase << setw(5) << setfill('0') << int(line.addr) << nouppercase << ": ";
+	cout << left << setw(20) << setfill(' ') << bytes.str() << right << line.text << "\n";
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,280 @@
+#ifndef BEECAPTURE_H
+#define BEECAPTURE_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <array>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+
+// Records the display to a Y4M video (if the file name ends in .y4m) or a sequence of PPM images (if it ends in .ppm)
+//
+// Frames are handed to a writer thread through a fixed ring of frame buffers, which only uses atomics,
+// so the emulation thread never waits on the disk (if the writer falls behind, frames are dropped instead)
+//
+// Frames the display says are unchanged are passed along without copying them,
+// and are written out again from the last frame (Y4M), or skipped entirely (PPM)
+class BeeCapture
+{
+    public:
+	BeeCapture()
+	{
+
+	}
+
+	~BeeCapture()
+	{
+	    close();
+	}
+
+	BeeCapture(const BeeCapture&) = delete;
+	BeeCapture &operator=(const BeeCapture&) = delete;
+
+	// Opens "filename" for frames of "w" x "h" pixels, at "rate_num / rate_den" frames per second,
+	// where each row of pixels is shown "line_scale" times
+	bool open(string filename, int w, int h, uint64_t rate_num, uint64_t rate_den, int line_scale = 1)
+	{
+	    close();
+	    width = w;
+	    height = h;
+
+	    if (hasextension(filename, ".y4m"))
+	    {
+		is_y4m = true;
+		file.open(filename, ios::out | ios::binary | ios::trunc);
+
+		if (!file.is_open())
+		{
+		    cout << "Error: could not open capture file " << filename << endl;
+		    return false;
+		}
+
+		// The stream is in 4:4:4, so there's no chroma subsampling to blur the text
+		file << "YUV4MPEG2 W" << dec << width << " H" << height << " F" << rate_num << ":" << rate_den;
+		file << " Ip A1:" << line_scale << " C444\n";
+		yuv_frame.resize(width * height * 3);
+	    }
+	    else if (hasextension(filename, ".ppm"))
+	    {
+		is_y4m = false;
+		image_prefix = filename.substr(0, (filename.size() - 4));
+		ppm_frame.resize(width * height * 3);
+	    }
+	    else
+	    {
+		cout << "Error: capture file " << filename << " should end in .y4m or .ppm" << endl;
+		return false;
+	    }
+
+	    for (auto &slot : slots)
+	    {
+		slot.pixels.resize(width * height);
+	    }
+
+	    read_pos = 0;
+	    write_pos = 0;
+	    frame_index = 0;
+	    num_written = 0;
+	    num_repeated = 0;
+	    num_dropped = 0;
+	    is_error = false;
+	    is_forced = true;
+	    is_stopping = false;
+	    writer_thread = thread(&BeeCapture::writerloop, this);
+	    return true;
+	}
+
+	// Writes out every frame that's been captured, and then closes the capture
+	void close()
+	{
+	    if (!writer_thread.joinable())
+	    {
+		return;
+	    }
+
+	    is_stopping = true;
+	    writer_thread.join();
+	    file.close();
+
+	    cout << "Captured " << dec << frame_index << " frames (" << num_written << " written, " << num_repeated << " unchanged, " << num_dropped << " dropped)" << endl;
+
+	    if (is_error)
+	    {
+		cout << "Error: some frames could not be written" << endl;
+	    }
+	}
+
+	bool isopen()
+	{
+	    return writer_thread.joinable();
+	}
+
+	// Hands a frame (in ARGB8888 format) to the writer thread, where "is_changed" is false if it's the same as the last one
+	void pushframe(const uint32_t *framebuffer, bool is_changed)
+	{
+	    size_t pos = write_pos.load(memory_order_relaxed);
+
+	    if ((pos - read_pos.load(memory_order_acquire)) == num_slots)
+	    {
+		// The frame after a dropped one can't be passed along as unchanged
+		num_dropped += 1;
+		frame_index += 1;
+		is_forced = true;
+		return;
+	    }
+
+	    Frame &frame = slots[(pos % num_slots)];
+	    frame.index = frame_index;
+	    frame.is_repeat = (!is_changed && !is_forced);
+
+	    if (!frame.is_repeat)
+	    {
+		memcpy(frame.pixels.data(), framebuffer, (frame.pixels.size() * 4));
+	    }
+
+	    is_forced = false;
+	    frame_index += 1;
+	    write_pos.store((pos + 1), memory_order_release);
+	}
+
+    private:
+	struct Frame
+	{
+	    vector<uint32_t> pixels;
+	    uint64_t index = 0;
+	    bool is_repeat = false;
+	};
+
+	static constexpr size_t num_slots = 8;
+	array<Frame, num_slots> slots;
+
+	// Only the emulation thread writes "write_pos", and only the writer thread writes "read_pos"
+	atomic<size_t> read_pos{0};
+	atomic<size_t> write_pos{0};
+	atomic<bool> is_stopping{false};
+	thread writer_thread;
+
+	int width = 0;
+	int height = 0;
+	bool is_y4m = false;
+	ofstream file;
+	string image_prefix = "";
+	vector<uint8_t> yuv_frame;
+	vector<uint8_t> ppm_frame;
+
+	// Only touched by the emulation thread
+	uint64_t frame_index = 0;
+	uint64_t num_dropped = 0;
+	bool is_forced = true;
+
+	// Only touched by the writer thread (until it's been joined)
+	uint64_t num_written = 0;
+	uint64_t num_repeated = 0;
+	bool is_error = false;
+
+	bool hasextension(const string &filename, const string &ext)
+	{
+	    return ((filename.size() > ext.size()) && (filename.compare((filename.size() - ext.size()), ext.size(), ext) == 0));
+	}
+
+	void writerloop()
+	{
+	    while (true)
+	    {
+		size_t pos = read_pos.load(memory_order_relaxed);
+
+		if (pos == write_pos.load(memory_order_acquire))
+		{
+		    // Check for new frames once more after seeing the stop request, so none are left behind
+		    if (is_stopping.load(memory_order_acquire) && (pos == write_pos.load(memory_order_acquire)))
+		    {
+			break;
+		    }
+
+		    this_thread::sleep_for(chrono::milliseconds(1));
+		    continue;
+		}
+
+		writeframe(slots[(pos % num_slots)]);
+		read_pos.store((pos + 1), memory_order_release);
+	    }
+	}
+
+	void writeframe(const Frame &frame)
+	{
+	    if (frame.is_repeat)
+	    {
+		num_repeated += 1;
+	    }
+	    else
+	    {
+		num_written += 1;
+	    }
+
+	    if (is_y4m)
+	    {
+		if (!frame.is_repeat)
+		{
+		    converttoyuv(frame.pixels);
+		}
+
+		file << "FRAME\n";
+		file.write((char*)yuv_frame.data(), yuv_frame.size());
+		is_error |= !file.good();
+		return;
+	    }
+
+	    // An unchanged frame shows up as a gap in the numbering
+	    if (frame.is_repeat)
+	    {
+		return;
+	    }
+
+	    for (size_t index = 0; index < frame.pixels.size(); index++)
+	    {
+		uint32_t color = frame.pixels[index];
+		ppm_frame[(index * 3)] = ((color >> 16) & 0xFF);
+		ppm_frame[((index * 3) + 1)] = ((color >> 8) & 0xFF);
+		ppm_frame[((index * 3) + 2)] = (color & 0xFF);
+	    }
+
+	    stringstream image_name;
+	    image_name << image_prefix << "_" << setw(6) << setfill('0') << dec << frame.index << ".ppm";
+
+	    ofstream image(image_name.str(), ios::out | ios::binary | ios::trunc);
+	    image << "P6\n" << dec << width << " " << height << "\n255\n";
+	    image.write((char*)ppm_frame.data(), ppm_frame.size());
+	    is_error |= !image.good();
+	}
+
+	// Converts a frame into separate Y, U and V planes (with BT.601's studio range)
+	void converttoyuv(const vector<uint32_t> &pixels)
+	{
+	    size_t plane_size = pixels.size();
+	    uint8_t *y_plane = yuv_frame.data();
+	    uint8_t *u_plane = (y_plane + plane_size);
+	    uint8_t *v_plane = (u_plane + plane_size);
+
+	    for (size_t index = 0; index < plane_size; index++)
+	    {
+		int red = ((pixels[index] >> 16) & 0xFF);
+		int green = ((pixels[index] >> 8) & 0xFF);
+		int blue = (pixels[index] & 0xFF);
+
+		y_plane[index] = (((66 * red + 129 * green + 25 * blue + 128) >> 8) + 16);
+		u_plane[index] = (((-38 * red - 74 * green + 112 * blue + 128) >> 8) + 128);
+		v_plane[index] = (((112 * red - 94 * green - 18 * blue + 128) >> 8) + 128);
+	    }
+	}
+};
+
+#endif // BEECAPTURE_H
\ No newline at end of file
@@ -0,0 +1,457 @@
+#ifndef BEE8086_CGA
+#define BEE8086_CGA
+
+#include <iostream>
+#include <array>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <Bee8086/memorymap.h>
+#include <Bee8086/scheduler.h>
+#include "beevideo.h"
+#include "beeglyph.h"
+#include "beecrtc.h"
+using namespace bee8086;
+using namespace beecrtc;
+using namespace std;
+
+namespace beecga
+{
+    // IBM Color Graphics Adapter
+    //
+    // Supports 40x25 and 80x25 text (with 8x8 characters), 320x200 graphics in 4 colors and 640x200 graphics in 2 colors,
+    // which are all drawn into a 640x200 framebuffer (with 40 column text and 320x200 graphics using double-wide pixels)
+    //
+    // Like the MDA, nothing is drawn as the guest writes to VRAM; instead, the memory map's dirty bits are used to skip
+    // unchanged frames, and then only the text cells (or scanlines) that differ from the last frame are redrawn
+    class BeeCGA : public BeeVideo
+    {
+	public:
+	    static constexpr int width = 640;
+	    static constexpr int height = 200;
+
+	    BeeCGA(Bee8086MemoryMap &memory, Bee8086Scheduler &sched, const array<uint8_t, 0x2000> &font) : memory_map(memory), crtc(sched, dot_clock, 8, crtc_defaults), font_rom(font)
+	    {
+		reset();
+	    }
+
+	    ~BeeCGA()
+	    {
+
+	    }
+
+	    void reset()
+	    {
+		mode = 0;
+		color_select = 0;
+		frame_count = 0;
+		crtc.setclock((dot_clock / 2), 8);
+		framebuffer.fill(palette[0]);
+		invalidate();
+	    }
+
+	    void start(Callback func)
+	    {
+		crtc.start(func);
+	    }
+
+	    void writeReg(uint8_t data)
+	    {
+		crtc.selectReg(data);
+	    }
+
+	    void writeData(uint8_t data)
+	    {
+		crtc.writeData(data);
+
+		// The start address and cursor position are picked up by comparing each cell (or scanline),
+		// but the rest change how everything is drawn
+		switch (crtc.getselected())
+		{
+		    case BeeCRTC::StartAddrHigh:
+		    case BeeCRTC::StartAddrLow:
+		    case BeeCRTC::CursorAddrHigh:
+		    case BeeCRTC::CursorAddrLow: is_redraw = true; break;
+		    default: invalidate(); break;
+		}
+	    }
+
+	    uint8_t readData()
+	    {
+		return crtc.readData();
+	    }
+
+	    // Mode control register (port 0x3D8)
+	    void writeMode(uint8_t data)
+	    {
+		mode = (data & 0x3F);
+
+		// The high resolution modes run the CRTC from the full 14.318 MHz pixel clock, and the others from half of it
+		crtc.setclock(testbit(mode, 0) ? dot_clock : (dot_clock / 2), 8);
+		invalidate();
+	    }
+
+	    // Color select register (port 0x3D9)
+	    void writeColor(uint8_t data)
+	    {
+		color_select = (data & 0x3F);
+		invalidate();
+	    }
+
+	    // Bit 0 is set whenever the beam is outside of the visible part of the screen (so VRAM can be accessed without snow),
+	    // and bit 3 is set during vertical retrace
+	    uint8_t readStatus()
+	    {
+		uint8_t status = 0xF0;
+
+		if (!crtc.isdisplayenabled())
+		{
+		    status |= 0x01;
+		}
+
+		if (crtc.isvsync())
+		{
+		    status |= 0x08;
+		}
+
+		return status;
+	    }
+
+	    bool renderframe()
+	    {
+		// Characters blink at 1/32 of the frame rate, and the cursor blinks at 1/16
+		int blink_phase = (frame_count & 0x18);
+		frame_count += 1;
+
+		bool is_vram_dirty = memory_map.fetchdirty(vram_addr, vram_size);
+
+		if (!is_vram_dirty && !is_redraw && (blink_phase == last_blink_phase))
+		{
+		    return false;
+		}
+
+		is_redraw = false;
+		last_blink_phase = blink_phase;
+		memory_map.readBlock(vram_addr, vram.data(), vram_size);
+
+		dirty_top = height;
+		dirty_bottom = 0;
+
+		if (!testbit(mode, 3))
+		{
+		    drawblank();
+		}
+		else if (testbit(mode, 1))
+		{
+		    drawgraphics();
+		}
+		else
+		{
+		    drawtext(((blink_phase & 0x10) == 0), ((blink_phase & 0x08) == 0));
+		}
+
+		return (dirty_top < dirty_bottom);
+	    }
+
+	    void getdirtyrows(int &top, int &count)
+	    {
+		top = dirty_top;
+		count = max(0, (dirty_bottom - dirty_top));
+	    }
+
+	    const uint32_t *getframebuffer()
+	    {
+		return framebuffer.data();
+	    }
+
+	    int getwidth()
+	    {
+		return width;
+	    }
+
+	    int getheight()
+	    {
+		return height;
+	    }
+
+	    uint64_t getframecycles()
+	    {
+		return crtc.getframecycles();
+	    }
+
+	    // 200 lines are shown as 400, which is close enough to the 4:3 a CGA monitor stretches them to
+	    int getlinescale()
+	    {
+		return 2;
+	    }
+
+	private:
+	    template<typename T>
+	    bool testbit(T reg, int bit)
+	    {
+		return ((reg >> bit) & 1) ? true : false;
+	    }
+
+	    // Pixel clock of 14.318 MHz
+	    static constexpr uint64_t dot_clock = 14318180;
+
+	    // The IBM BIOS' CRTC settings for 80x25 text mode
+	    // (giving 262 scanlines of 912 pixels, or about 60 Hz)
+	    const array<uint8_t, 18> crtc_defaults = {
+		0x71, 0x50, 0x5A, 0x0A, 0x1F, 0x06, 0x19, 0x1C, 0x02,
+		0x07, 0x06, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	    };
+
+	    // The 16 RGBI colors (with dark yellow turned into brown, like on IBM's monitor)
+	    const array<uint32_t, 16> palette = {
+		0xFF000000, 0xFF0000AA, 0xFF00AA00, 0xFF00AAAA, 0xFFAA0000, 0xFFAA00AA, 0xFFAA5500, 0xFFAAAAAA,
+		0xFF555555, 0xFF5555FF, 0xFF55FF55, 0xFF55FFFF, 0xFFFF5555, 0xFFFF55FF, 0xFFFFFF55, 0xFFFFFFFF,
+	    };
+
+	    Bee8086MemoryMap &memory_map;
+	    BeeCRTC crtc;
+	    const array<uint8_t, 0x2000> &font_rom;
+
+	    // The CGA's font is in the last quarter of the character ROM
+	    static constexpr int font_offs = 0x1800;
+
+	    static constexpr uint32_t vram_addr = 0xB8000;
+	    static constexpr int vram_size = 0x4000;
+	    static constexpr int cols = 80;
+	    static constexpr int rows = 25;
+	    static constexpr int cell_height = 8;
+
+	    // Graphics modes split even and odd scanlines into two 8 KB banks, with 80 bytes for each scanline
+	    static constexpr int bank_size = 0x2000;
+	    static constexpr int line_bytes = 80;
+
+	    uint8_t mode = 0;
+	    uint8_t color_select = 0;
+	    bool is_redraw = true;
+	    int last_blink_phase = 0;
+	    uint32_t frame_count = 0;
+
+	    array<uint8_t, vram_size> vram;
+
+	    // The character, colors and cursor last drawn in each text cell,
+	    // and the bytes last drawn on each scanline in graphics modes
+	    array<uint32_t, (cols * rows)> cells;
+	    array<array<uint8_t, line_bytes>, height> lines;
+	    bool is_lines_valid = false;
+	    bool is_blank = false;
+
+	    array<uint32_t, (width * height)> framebuffer;
+	    int dirty_top = 0;
+	    int dirty_bottom = 0;
+
+	    // Forces the whole screen to be redrawn on the next frame
+	    void invalidate()
+	    {
+		cells.fill(0xFFFFFFFF);
+		is_lines_valid = false;
+		is_blank = false;
+		is_redraw = true;
+	    }
+
+	    void markdirty(int top, int bottom)
+	    {
+		dirty_top = min(dirty_top, top);
+		dirty_bottom = max(dirty_bottom, bottom);
+	    }
+
+	    void drawblank()
+	    {
+		if (is_blank)
+		{
+		    return;
+		}
+
+		framebuffer.fill(palette[0]);
+		markdirty(0, height);
+		invalidate();
+		is_blank = true;
+		is_redraw = false;
+	    }
+
+	    void drawtext(bool is_blink_phase, bool is_cursor_phase)
+	    {
+		bool is_wide = !testbit(mode, 0);
+		bool is_blink_enabled = testbit(mode, 5);
+		int mode_cols = is_wide ? (cols / 2) : cols;
+
+		// The CRTC can display fewer (but not more) rows and columns than fit in the framebuffer
+		int num_cols = min(crtc.getcolumns(), mode_cols);
+		int num_rows = min(crtc.getrows(), int(rows));
+		int start_addr = crtc.getstartaddr();
+		int cursor_addr = crtc.getcursoraddr();
+		int cursor_mode = crtc.getcursormode();
+		bool is_cursor_shown = (cursor_mode == 0) || ((cursor_mode != 1) && is_cursor_phase);
+
+		for (int row = 0; row < rows; row++)
+		{
+		    for (int col = 0; col < mode_cols; col++)
+		    {
+			// Each row of text starts right after the last one, and the address wraps around the 16 KB of VRAM
+			int addr = (start_addr + (row * crtc.getcolumns()) + col);
+			uint8_t character = vram[((addr * 2) & 0x3FFF)];
+			uint8_t attribute = vram[(((addr * 2) + 1) & 0x3FFF)];
+
+			int foreground = (attribute & 0xF);
+			int background = (attribute >> 4);
+
+			// With blinking enabled, bit 7 makes the character blink instead of selecting a bright background
+			if (is_blink_enabled)
+			{
+			    background &= 7;
+
+			    if (testbit(attribute, 7) && !is_blink_phase)
+			    {
+				foreground = background;
+			    }
+			}
+
+			// The area outside of the displayed rows and columns is drawn as black spaces
+			bool is_displayed = ((row < num_rows) && (col < num_cols));
+			bool is_cursor = (is_displayed && is_cursor_shown && (addr == cursor_addr));
+
+			if (!is_displayed)
+			{
+			    character = 0;
+			    foreground = 0;
+			    background = 0;
+			}
+
+			uint32_t cell_key = ((is_cursor ? 0x10000 : 0) | (background << 12) | (foreground << 8) | character);
+			int cell = ((row * cols) + col);
+
+			if (cells[cell] == cell_key)
+			{
+			    continue;
+			}
+
+			cells[cell] = cell_key;
+			drawcell(row, col, character, palette[foreground], palette[background], is_cursor, is_wide);
+			markdirty((row * cell_height), ((row + 1) * cell_height));
+		    }
+		}
+	    }
+
+	    void drawcell(int row, int col, uint8_t character, uint32_t foreground, uint32_t background, bool is_cursor, bool is_wide)
+	    {
+		int cell_width = is_wide ? 16 : 8;
+		uint32_t *dst = &framebuffer[(((row * cell_height) * width) + (col * cell_width))];
+		int cursor_end = min(crtc.getcursorend(), (cell_height - 1));
+
+		for (int y = 0; y < cell_height; y++)
+		{
+		    uint8_t line = font_rom[(font_offs + (character * 8) + y)];
+
+		    // The cursor covers its scanlines in the character's foreground color
+		    if (is_cursor && (y >= crtc.getcursorstart()) && (y <= cursor_end))
+		    {
+			line = 0xFF;
+		    }
+
+		    if (is_wide)
+		    {
+			uint32_t pixels[8];
+			expandglyphrow(line, 8, foreground, background, pixels);
+			doublepixels(pixels, 8, dst);
+		    }
+		    else
+		    {
+			expandglyphrow(line, 8, foreground, background, dst);
+		    }
+
+		    dst += width;
+		}
+	    }
+
+	    void drawgraphics()
+	    {
+		bool is_hires = testbit(mode, 4);
+		array<uint32_t, 4> colors = getgraphicscolors();
+		uint32_t foreground = palette[(color_select & 0xF)];
+
+		// The start address counts 16-bit words
+		int start_offs = (crtc.getstartaddr() * 2);
+
+		for (int y = 0; y < height; y++)
+		{
+		    array<uint8_t, line_bytes> line;
+		    int bank = ((y & 1) * bank_size);
+		    int offs = (start_offs + ((y >> 1) * line_bytes));
+
+		    for (int index = 0; index < line_bytes; index++)
+		    {
+			line[index] = vram[(bank + ((offs + index) & (bank_size - 1)))];
+		    }
+
+		    if (is_lines_valid && (memcmp(lines[y].data(), line.data(), line_bytes) == 0))
+		    {
+			continue;
+		    }
+
+		    lines[y] = line;
+		    uint32_t *dst = &framebuffer[(y * width)];
+
+		    for (int index = 0; index < line_bytes; index++)
+		    {
+			if (is_hires)
+			{
+			    // 640x200 has 8 pixels in each byte, in the foreground color on black
+			    expandglyphrow(line[index], 8, foreground, palette[0], (dst + (index * 8)));
+			}
+			else
+			{
+			    // 320x200 has 4 pixels in each byte, which pick one of 4 colors
+			    uint32_t pixels[4];
+
+			    for (int x = 0; x < 4; x++)
+			    {
+				pixels[x] = colors[((line[index] >> (6 - (x * 2))) & 3)];
+			    }
+
+			    doublepixels(pixels, 4, (dst + (index * 8)));
+			}
+		    }
+
+		    markdirty(y, (y + 1));
+		}
+
+		is_lines_valid = true;
+	    }
+
+	    // The colors of each 320x200 pixel value
+	    array<uint32_t, 4> getgraphicscolors()
+	    {
+		// Color 0 is the background color, and the other 3 are green/red/brown, cyan/magenta/white,
+		// or (when color burst is turned off) cyan/red/white
+		int intensity = testbit(color_select, 4) ? 8 : 0;
+		int first = testbit(color_select, 5) ? 3 : 2;
+		int second = testbit(color_select, 5) ? 5 : 4;
+		int third = testbit(color_select, 5) ? 7 : 6;
+
+		if (testbit(mode, 2))
+		{
+		    first = 3;
+		    second = 4;
+		    third = 7;
+		}
+
+		return {palette[(color_select & 0xF)], palette[(first + intensity)], palette[(second + intensity)], palette[(third + intensity)]};
+	    }
+
+	    void doublepixels(const uint32_t *pixels, int count, uint32_t *dst)
+	    {
+		for (int x = 0; x < count; x++)
+		{
+		    dst[(x * 2)] = pixels[x];
+		    dst[((x * 2) + 1)] = pixels[x];
+		}
+	    }
+    };
+}
+
+
+#endif // BEE8086_CGA
\ No newline at end of file
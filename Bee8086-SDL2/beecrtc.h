@@ -0,0 +1,282 @@
+#ifndef BEE8086_CRTC
+#define BEE8086_CRTC
+
+#include <iostream>
+#include <array>
+#include <functional>
+#include <cstdint>
+#include <Bee8086/scheduler.h>
+using namespace bee8086;
+using namespace std;
+
+namespace beecrtc
+{
+    // Motorola 6845 CRT controller
+    //
+    // Instead of counting characters and scanlines as the CPU runs, the beam position is worked out
+    // from the cycle count whenever the guest reads the status (or the adapter draws a frame),
+    // and the only scheduled event is the start of vertical retrace, once per frame
+    class BeeCRTC
+    {
+	public:
+	    using Callback = function<void()>;
+
+	    enum Register : int
+	    {
+		HorizontalTotal = 0,
+		HorizontalDisplayed = 1,
+		HorizontalSyncPos = 2,
+		SyncWidth = 3,
+		VerticalTotal = 4,
+		VerticalTotalAdjust = 5,
+		VerticalDisplayed = 6,
+		VerticalSyncPos = 7,
+		InterlaceMode = 8,
+		MaxScanline = 9,
+		CursorStart = 10,
+		CursorEnd = 11,
+		StartAddrHigh = 12,
+		StartAddrLow = 13,
+		CursorAddrHigh = 14,
+		CursorAddrLow = 15,
+		LightPenHigh = 16,
+		LightPenLow = 17,
+	    };
+
+	    // "dot_rate" is the pixel clock (in Hz), and "width" is the number of pixels in each character,
+	    // while "defaults" are the register values used until the guest programs them
+	    BeeCRTC(Bee8086Scheduler &sched, uint64_t dot_rate, int width, const array<uint8_t, 18> &defaults) : scheduler(sched), dot_clock(dot_rate), char_width(width)
+	    {
+		regs = defaults;
+	    }
+
+	    ~BeeCRTC()
+	    {
+
+	    }
+
+	    void selectReg(uint8_t data)
+	    {
+		reg_index = (data & 0x1F);
+	    }
+
+	    void writeData(uint8_t data)
+	    {
+		// Only the bits each register implements are kept
+		const array<uint8_t, 18> masks = {
+		    0xFF, 0xFF, 0xFF, 0xFF, 0x7F, 0x1F, 0x7F, 0x7F, 0x03,
+		    0x1F, 0x7F, 0x1F, 0x3F, 0xFF, 0x3F, 0xFF, 0x00, 0x00,
+		};
+
+		if (reg_index < 18)
+		{
+		    regs[reg_index] = (data & masks[reg_index]);
+		}
+
+		// Changing the timing restarts the frame
+		if ((reg_index <= MaxScanline) && vsync_func)
+		{
+		    restart();
+		}
+	    }
+
+	    // Only the cursor and light pen registers can be read back
+	    uint8_t readData()
+	    {
+		if ((reg_index >= CursorAddrHigh) && (reg_index <= LightPenLow))
+		{
+		    return regs[reg_index];
+		}
+
+		return 0x00;
+	    }
+
+	    int getselected()
+	    {
+		return reg_index;
+	    }
+
+	    uint8_t getreg(int reg)
+	    {
+		return regs[reg];
+	    }
+
+	    // Changes the pixel clock and character width (i.e. when the adapter switches between 40 and 80 columns)
+	    void setclock(uint64_t dot_rate, int width)
+	    {
+		if ((dot_rate == dot_clock) && (width == char_width))
+		{
+		    return;
+		}
+
+		dot_clock = dot_rate;
+		char_width = width;
+
+		if (vsync_func)
+		{
+		    restart();
+		}
+	    }
+
+	    // Starts the frame timing, and calls "func" at the start of every vertical retrace
+	    void start(Callback func)
+	    {
+		vsync_func = func;
+		restart();
+	    }
+
+	    uint16_t getstartaddr()
+	    {
+		return ((regs[StartAddrHigh] << 8) | regs[StartAddrLow]);
+	    }
+
+	    uint16_t getcursoraddr()
+	    {
+		return ((regs[CursorAddrHigh] << 8) | regs[CursorAddrLow]);
+	    }
+
+	    // Cursor blink mode (0 = steady, 1 = hidden, 2 = blinks at 1/16 of the frame rate, 3 = blinks at 1/32)
+	    int getcursormode()
+	    {
+		return ((regs[CursorStart] >> 5) & 3);
+	    }
+
+	    int getcursorstart()
+	    {
+		return (regs[CursorStart] & 0x1F);
+	    }
+
+	    int getcursorend()
+	    {
+		return (regs[CursorEnd] & 0x1F);
+	    }
+
+	    int getcolumns()
+	    {
+		return regs[HorizontalDisplayed];
+	    }
+
+	    int getrows()
+	    {
+		return regs[VerticalDisplayed];
+	    }
+
+	    int getcharheight()
+	    {
+		return (regs[MaxScanline] + 1);
+	    }
+
+	    // Number of CPU cycles in each frame
+	    uint64_t getframecycles()
+	    {
+		return max<uint64_t>(1, todotcycles(getframedots()));
+	    }
+
+	    // True while the beam is in the visible part of the screen
+	    bool isdisplayenabled()
+	    {
+		int line = 0;
+		int column = 0;
+		getposition(line, column);
+		return ((column < regs[HorizontalDisplayed]) && (line < (regs[VerticalDisplayed] * getcharheight())));
+	    }
+
+	    bool ishsync()
+	    {
+		int line = 0;
+		int column = 0;
+		getposition(line, column);
+
+		// A sync width of 0 means 16 characters
+		int width = (regs[SyncWidth] & 0xF);
+		width = (width == 0) ? 16 : width;
+		return ((column >= regs[HorizontalSyncPos]) && (column < (regs[HorizontalSyncPos] + width)));
+	    }
+
+	    bool isvsync()
+	    {
+		int line = 0;
+		int column = 0;
+		getposition(line, column);
+
+		// Vertical sync always lasts for 16 scanlines on the 6845
+		int sync_line = (regs[VerticalSyncPos] * getcharheight());
+		return ((line >= sync_line) && (line < (sync_line + 16)));
+	    }
+
+	private:
+	    Bee8086Scheduler &scheduler;
+	    uint64_t dot_clock = 0;
+	    int char_width = 0;
+
+	    // The CPU runs at 4.77 MHz (i.e. 14.318 MHz / 3)
+	    static constexpr uint64_t cpu_clock = 4772727;
+
+	    array<uint8_t, 18> regs;
+	    int reg_index = 0;
+
+	    Callback vsync_func;
+
+	    // CPU cycle at which the timing was last changed, and the number of frames since then
+	    uint64_t timing_start = 0;
+	    uint64_t frame_index = 0;
+	    int vsync_id = -1;
+
+	    uint64_t getlinedots()
+	    {
+		return ((regs[HorizontalTotal] + 1) * char_width);
+	    }
+
+	    uint64_t getframelines()
+	    {
+		return (((regs[VerticalTotal] + 1) * getcharheight()) + regs[VerticalTotalAdjust]);
+	    }
+
+	    uint64_t getframedots()
+	    {
+		return (getlinedots() * getframelines());
+	    }
+
+	    uint64_t todotcycles(uint64_t dots)
+	    {
+		return ((dots * cpu_clock) / dot_clock);
+	    }
+
+	    void getposition(int &line, int &column)
+	    {
+		uint64_t elapsed = (scheduler.getcycles() - timing_start);
+		uint64_t dots = (((elapsed * dot_clock) / cpu_clock) % getframedots());
+		line = int(dots / getlinedots());
+		column = int((dots % getlinedots()) / char_width);
+	    }
+
+	    void restart()
+	    {
+		if (vsync_id >= 0)
+		{
+		    scheduler.cancel(vsync_id);
+		}
+
+		timing_start = scheduler.getcycles();
+		frame_index = 0;
+		schedulevsync();
+	    }
+
+	    void schedulevsync()
+	    {
+		// Frames are timed from when the timing was last changed (in pixels), so they don't drift
+		uint64_t sync_dots = (regs[VerticalSyncPos] * getcharheight() * getlinedots());
+		uint64_t sync_cycle = (timing_start + todotcycles((frame_index * getframedots()) + sync_dots));
+
+		vsync_id = scheduler.scheduleat(sync_cycle, [this]()
+		{
+		    frame_index += 1;
+		    schedulevsync();
+		    vsync_func();
+		});
+	    }
+    };
+}
+
+
+#endif // BEE8086_CRTC
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef BEEDISK_H
+#define BEEDISK_H
+
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+// Fixed disk that INT 13h can access by LBA
+// (i.e. an image streamed from a file, or a volume built from a host directory)
+class BeeDisk
+{
+    public:
+	virtual ~BeeDisk()
+	{
+
+	}
+
+	virtual bool isopen() = 0;
+	virtual void close() = 0;
+
+	virtual uint64_t getsectorcount() = 0;
+
+	// Reads up to "count" sectors starting at "lba" into "data", and returns the number of sectors read
+	virtual size_t readSectors(uint32_t lba, size_t count, uint8_t *data) = 0;
+
+	// Writes up to "count" sectors from "data" starting at "lba", and returns the number of sectors written
+	virtual size_t writeSectors(uint32_t lba, size_t count, const uint8_t *data) = 0;
+
+	virtual bool isreadonly() = 0;
+
+	// Waits until every write so far has reached the host
+	virtual void sync()
+	{
+
+	}
+
+	// Writes any changes kept on the side (i.e. in an overlay) into the disk itself
+	virtual bool commit()
+	{
+	    return true;
+	}
+
+	uint32_t toLBA(int cylinder, int head, int sector)
+	{
+	    return (cylinder * numheads + head) * numsectors + (sector - 1);
+	}
+
+	bool isvalid(uint32_t lba)
+	{
+	    return (lba < getsectorcount());
+	}
+
+	int numcylinders = 0;
+	int numheads = 0;
+	int numsectors = 0;
+};
+
+#endif // BEEDISK_H
\ No newline at end of file
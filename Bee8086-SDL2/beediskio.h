@@ -0,0 +1,132 @@
+#ifndef BEEDISKIO_H
+#define BEEDISKIO_H
+
+#include <iostream>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+// Worker thread that runs disk requests off of the emulation thread
+//
+// Requests are run one at a time in the order they were submitted, so the disks
+// are only ever touched by this thread while it's running
+class BeeDiskIO
+{
+    public:
+	// Runs on the worker thread, and returns the number of sectors transferred
+	using Job = function<size_t()>;
+
+	struct Request
+	{
+	    Job job;
+	    size_t result = 0;
+	    atomic<bool> is_done{false};
+	};
+
+	using RequestRef = shared_ptr<Request>;
+
+	BeeDiskIO()
+	{
+
+	}
+
+	~BeeDiskIO()
+	{
+	    stop();
+	}
+
+	BeeDiskIO(const BeeDiskIO&) = delete;
+	BeeDiskIO &operator=(const BeeDiskIO&) = delete;
+
+	void start()
+	{
+	    if (worker_thread.joinable())
+	    {
+		return;
+	    }
+
+	    is_stopping = false;
+	    worker_thread = thread(&BeeDiskIO::workerloop, this);
+	}
+
+	// Finishes every request that's been submitted, and then stops the worker thread
+	void stop()
+	{
+	    if (!worker_thread.joinable())
+	    {
+		return;
+	    }
+
+	    {
+		lock_guard<mutex> lock(queue_mutex);
+		is_stopping = true;
+	    }
+
+	    queue_cond.notify_all();
+	    worker_thread.join();
+	}
+
+	// Blocks until "request" has finished
+	void wait(RequestRef request)
+	{
+	    unique_lock<mutex> lock(queue_mutex);
+	    done_cond.wait(lock, [&]() { return request->is_done.load(memory_order_acquire); });
+	}
+
+	// Queues up "job" to be run on the worker thread
+	RequestRef submit(Job job)
+	{
+	    RequestRef request = make_shared<Request>();
+	    request->job = job;
+
+	    {
+		lock_guard<mutex> lock(queue_mutex);
+		requests.push_back(request);
+	    }
+
+	    queue_cond.notify_all();
+	    return request;
+	}
+
+    private:
+	thread worker_thread;
+	mutex queue_mutex;
+	condition_variable queue_cond;
+	condition_variable done_cond;
+	deque<RequestRef> requests;
+	bool is_stopping = false;
+
+	void workerloop()
+	{
+	    unique_lock<mutex> lock(queue_mutex);
+
+	    while (true)
+	    {
+		queue_cond.wait(lock, [this]() { return (is_stopping || !requests.empty()); });
+
+		if (requests.empty())
+		{
+		    break;
+		}
+
+		RequestRef request = requests.front();
+		requests.pop_front();
+		lock.unlock();
+
+		request->result = request->job();
+		request->is_done.store(true, memory_order_release);
+
+		lock.lock();
+		done_cond.notify_all();
+	    }
+	}
+};
+
+#endif // BEEDISKIO_H
\ No newline at end of file
@@ -0,0 +1,267 @@
+#ifndef BEEDISKOVERLAY_H
+#define BEEDISKOVERLAY_H
+
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include "beediskwriter.h"
+
+using namespace std;
+
+// Copy-on-write overlay on top of a read-only base image
+//
+// Only the sectors the guest has changed are kept (so memory use is proportional to the writes),
+// and they can optionally be kept in an overlay file, which is written to in the background
+//
+// The overlay file starts with a header sector (which holds the size and hash of the base image,
+// so an overlay can't be applied to any other image), followed by a record for each changed sector
+// (made up of a sector holding its LBA and then the sector itself)
+class BeeDiskOverlay
+{
+    public:
+	using Sector = array<uint8_t, 512>;
+
+	BeeDiskOverlay()
+	{
+
+	}
+
+	~BeeDiskOverlay()
+	{
+	    close();
+	}
+
+	BeeDiskOverlay(const BeeDiskOverlay&) = delete;
+	BeeDiskOverlay &operator=(const BeeDiskOverlay&) = delete;
+
+	// Opens an overlay for a base image of "num_sectors" sectors with a hash of "hash",
+	// which is kept in memory if "filename" is empty, and is otherwise loaded from (or created as) "filename"
+	bool open(uint32_t num_sectors, uint64_t hash, string filename = "")
+	{
+	    close();
+	    base_sectors = num_sectors;
+	    base_hash = hash;
+	    overlay_name = filename;
+	    is_open = true;
+
+	    if (overlay_name == "")
+	    {
+		return true;
+	    }
+
+	    if (!loadfile() || !writer.open(overlay_name))
+	    {
+		cout << "Error: could not open overlay " << overlay_name << endl;
+		close();
+		return false;
+	    }
+
+	    cout << overlay_name << " succesfully loaded (" << dec << sectors.size() << " changed sectors)." << endl;
+	    return true;
+	}
+
+	void close()
+	{
+	    writer.close();
+	    sectors.clear();
+	    slots.clear();
+	    overlay_name = "";
+	    base_sectors = 0;
+	    base_hash = 0;
+	    is_open = false;
+	}
+
+	bool isopen()
+	{
+	    return is_open;
+	}
+
+	size_t getcount()
+	{
+	    return sectors.size();
+	}
+
+	// Stores "count" sectors from "data" starting at "lba" in the overlay
+	void write(uint32_t lba, const uint8_t *data, size_t count)
+	{
+	    for (size_t index = 0; index < count; index++)
+	    {
+		uint32_t sector = (lba + index);
+		const uint8_t *sector_data = (data + (index * 512));
+		memcpy(sectors[sector].data(), sector_data, 512);
+
+		if (overlay_name == "")
+		{
+		    continue;
+		}
+
+		// Sectors that are already in the file are rewritten in place,
+		// and the rest get a new record at the end of the file
+		auto it = slots.find(sector);
+
+		if (it == slots.end())
+		{
+		    uint32_t slot = slots.size();
+		    it = slots.emplace(sector, slot).first;
+
+		    uint8_t record[512] = {0};
+		    memcpy(record, "BEEOVREC", 8);
+		    putlong(&record[8], sector);
+		    writer.write(getrecordsector(slot), record, 1);
+		}
+
+		writer.write((getrecordsector(it->second) + 1), sector_data, 1);
+	    }
+	}
+
+	// Returns true if any sectors between "lba" and "lba + count" are in the overlay
+	bool intersects(uint32_t lba, size_t count)
+	{
+	    auto it = sectors.lower_bound(lba);
+	    return ((it != sectors.end()) && (it->first < (lba + count)));
+	}
+
+	// Patches any sectors between "lba" and "lba + count" that are in the overlay into "data"
+	void apply(uint32_t lba, uint8_t *data, size_t count)
+	{
+	    for (auto it = sectors.lower_bound(lba); (it != sectors.end()) && (it->first < (lba + count)); it++)
+	    {
+		memcpy((data + (size_t(it->first - lba) * 512)), it->second.data(), 512);
+	    }
+	}
+
+	// Passes every sector in the overlay to "func" (in order), i.e. to write them into the base image
+	template<typename Func>
+	void foreach(Func func)
+	{
+	    for (auto &sector : sectors)
+	    {
+		func(sector.first, sector.second.data());
+	    }
+	}
+
+	// Throws away every sector in the overlay (and empties the overlay file)
+	void discard()
+	{
+	    sectors.clear();
+	    slots.clear();
+
+	    if (overlay_name != "")
+	    {
+		writer.close();
+
+		if (!createfile() || !writer.open(overlay_name))
+		{
+		    cout << "Error: could not reset overlay " << overlay_name << endl;
+		}
+	    }
+	}
+
+	// Waits until the overlay file is up to date
+	void sync()
+	{
+	    writer.sync();
+	}
+
+    private:
+	BeeDiskWriter writer;
+	string overlay_name = "";
+	uint32_t base_sectors = 0;
+	uint64_t base_hash = 0;
+	bool is_open = false;
+
+	map<uint32_t, Sector> sectors;
+
+	// Which record in the overlay file holds each sector
+	map<uint32_t, uint32_t> slots;
+
+	uint32_t getrecordsector(uint32_t slot)
+	{
+	    return (1 + (slot * 2));
+	}
+
+	bool loadfile()
+	{
+	    ifstream file(overlay_name, ios::in | ios::binary);
+
+	    if (!file.is_open())
+	    {
+		return createfile();
+	    }
+
+	    uint8_t header[512];
+
+	    if (!file.read((char*)header, 512) || (memcmp(header, "BEE8086O", 8) != 0))
+	    {
+		cout << "Error: " << overlay_name << " is not an overlay" << endl;
+		return false;
+	    }
+
+	    if ((getlong(&header[8]) != 2) || (getlong(&header[12]) != base_sectors) || (getlonglong(&header[16]) != base_hash))
+	    {
+		cout << "Error: " << overlay_name << " was made for a different disk image" << endl;
+		return false;
+	    }
+
+	    uint8_t record[512];
+	    uint8_t data[512];
+
+	    while (file.read((char*)record, 512) && file.read((char*)data, 512))
+	    {
+		uint32_t sector = getlong(&record[8]);
+
+		if ((memcmp(record, "BEEOVREC", 8) != 0) || (sector >= base_sectors))
+		{
+		    break;
+		}
+
+		uint32_t slot = slots.size();
+		slots[sector] = slot;
+		memcpy(sectors[sector].data(), data, 512);
+	    }
+
+	    return true;
+	}
+
+	bool createfile()
+	{
+	    ofstream file(overlay_name, ios::out | ios::binary | ios::trunc);
+
+	    if (!file.is_open())
+	    {
+		return false;
+	    }
+
+	    uint8_t header[512] = {0};
+	    memcpy(header, "BEE8086O", 8);
+	    putlong(&header[8], 2);
+	    putlong(&header[12], base_sectors);
+	    putlong(&header[16], uint32_t(base_hash));
+	    putlong(&header[20], uint32_t(base_hash >> 32));
+	    file.write((char*)header, 512);
+	    return file.good();
+	}
+
+	uint32_t getlong(const uint8_t *data)
+	{
+	    return (data[0] | (data[1] << 8) | (data[2] << 16) | (uint32_t(data[3]) << 24));
+	}
+
+	uint64_t getlonglong(const uint8_t *data)
+	{
+	    return (getlong(data) | (uint64_t(getlong(data + 4)) << 32));
+	}
+
+	void putlong(uint8_t *data, uint32_t val)
+	{
+	    data[0] = (val & 0xFF);
+	    data[1] = ((val >> 8) & 0xFF);
+	    data[2] = ((val >> 16) & 0xFF);
+	    data[3] = (val >> 24);
+	}
+};
+
+#endif // BEEDISKOVERLAY_H
\ No newline at end of file
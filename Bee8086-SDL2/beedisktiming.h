@@ -0,0 +1,86 @@
+#ifndef BEEDISKTIMING_H
+#define BEEDISKTIMING_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+// Mechanical timing of a disk drive, which works out how long a request takes in emulated time
+//
+// The head's cylinder is kept between requests, and the platter's position comes from the cycle count,
+// so a request always takes the same number of cycles on every run (whatever the host is doing)
+class BeeDiskTiming
+{
+    public:
+	// Sets up a drive spinning at "rpm", whose head takes "step_us" microseconds per cylinder
+	// (and "settle_us" to settle after a seek), with seeks taking no longer than "max_seek_us"
+	BeeDiskTiming(uint64_t clock, int rpm, uint64_t step_us, uint64_t settle_us, uint64_t max_seek_us) : cpu_clock(clock)
+	{
+	    rotation_cycles = ((cpu_clock * 60) / rpm);
+	    step_cycles = tocycles(step_us);
+	    settle_cycles = tocycles(settle_us);
+	    max_seek_cycles = tocycles(max_seek_us);
+	}
+
+	// Returns the number of cycles from "now" until a transfer of "count" sectors starting at "lba" has finished,
+	// on a disk with "num_heads" heads and "num_sectors" sectors per track (and moves the head to where it ends up)
+	uint64_t getdelay(uint64_t now, uint32_t lba, size_t count, int num_heads, int num_sectors)
+	{
+	    if ((num_heads <= 0) || (num_sectors <= 0) || (count == 0))
+	    {
+		return 1;
+	    }
+
+	    uint32_t track_size = uint32_t(num_heads * num_sectors);
+	    int cylinder = int(lba / track_size);
+	    int end_cylinder = int((lba + count - 1) / track_size);
+	    uint64_t sector_cycles = (rotation_cycles / num_sectors);
+
+	    uint64_t seek_cycles = getseekcycles(abs(cylinder - current_cylinder));
+
+	    // Wait for the first sector to come round under the head
+	    uint64_t angle = ((now + seek_cycles) % rotation_cycles);
+	    uint64_t target = ((lba % num_sectors) * sector_cycles);
+	    uint64_t latency = (((target + rotation_cycles) - angle) % rotation_cycles);
+
+	    // Runs that cross into the next cylinder have to step the head along as well
+	    uint64_t transfer_cycles = ((count * sector_cycles) + ((end_cylinder - cylinder) * (step_cycles + settle_cycles)));
+
+	    current_cylinder = end_cylinder;
+	    return max<uint64_t>(1, (seek_cycles + latency + transfer_cycles));
+	}
+
+	// Moves the head back to cylinder 0 (i.e. when a new disk is inserted)
+	void reset()
+	{
+	    current_cylinder = 0;
+	}
+
+    private:
+	uint64_t cpu_clock = 0;
+	uint64_t rotation_cycles = 0;
+	uint64_t step_cycles = 0;
+	uint64_t settle_cycles = 0;
+	uint64_t max_seek_cycles = 0;
+	int current_cylinder = 0;
+
+	uint64_t tocycles(uint64_t us)
+	{
+	    return ((us * cpu_clock) / 1000000);
+	}
+
+	uint64_t getseekcycles(int distance)
+	{
+	    if (distance == 0)
+	    {
+		return 0;
+	    }
+
+	    return min(((distance * step_cycles) + settle_cycles), max_seek_cycles);
+	}
+};
+
+#endif // BEEDISKTIMING_H
\ No newline at end of file
@@ -0,0 +1,358 @@
+#ifndef BEEDISKWRITER_H
+#define BEEDISKWRITER_H
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <array>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Write-back cache for a disk image
+//
+// Guest writes land in a map of dirty sectors (which never touches the image file),
+// and a background thread coalesces runs of adjacent sectors and writes them back to the image
+//
+// Sectors stay in the map until they've been written out, so readthrough() can patch them
+// into anything the disk reads back from the image in the meantime
+// (or for good, with "keep_written" set, for disks that read from a mapping that may not see the writes)
+class BeeDiskWriter
+{
+    public:
+	using Sector = array<uint8_t, 512>;
+
+	BeeDiskWriter()
+	{
+
+	}
+
+	~BeeDiskWriter()
+	{
+	    close();
+	}
+
+	BeeDiskWriter(const BeeDiskWriter&) = delete;
+	BeeDiskWriter &operator=(const BeeDiskWriter&) = delete;
+
+	// Opens "filename" for writing, and returns false (leaving the disk read-only) if it can't be
+	bool open(string filename)
+	{
+	    close();
+	    written.clear();
+
+	    if (!openfile(filename))
+	    {
+		cout << "Warning: " << filename << " is read-only" << endl;
+		return false;
+	    }
+
+	    is_stopping = false;
+	    flush_thread = thread(&BeeDiskWriter::flushloop, this);
+	    return true;
+	}
+
+	// Writes out every pending sector before closing the image
+	void close()
+	{
+	    if (!flush_thread.joinable())
+	    {
+		return;
+	    }
+
+	    {
+		lock_guard<mutex> lock(writer_mutex);
+		is_stopping = true;
+	    }
+
+	    writer_cond.notify_all();
+	    flush_thread.join();
+	    syncfile();
+	    closefile();
+	}
+
+	bool isopen()
+	{
+	    return flush_thread.joinable();
+	}
+
+	// Queues up "count" sectors from "data" to be written starting at "lba"
+	// (this only copies the sectors into the map, and never waits on the image file)
+	void write(uint32_t lba, const uint8_t *data, size_t count)
+	{
+	    {
+		lock_guard<mutex> lock(writer_mutex);
+
+		for (size_t index = 0; index < count; index++)
+		{
+		    memcpy(pending[lba + index].data(), (data + (index * 512)), 512);
+		}
+	    }
+
+	    writer_cond.notify_all();
+	}
+
+	// Reads "count" sectors starting at "lba" into "data" with "func", and then patches in any of them
+	// that haven't been written out yet
+	//
+	// The lock is held throughout, so that a batch can't finish being written out
+	// between reading the image and looking the sectors up
+	template<typename Func>
+	bool readthrough(uint32_t lba, uint8_t *data, size_t count, Func func)
+	{
+	    lock_guard<mutex> lock(writer_mutex);
+
+	    if (!func())
+	    {
+		return false;
+	    }
+
+	    // Sectors being written out are older than the pending ones, so apply them first
+	    applyoverlay(written, lba, data, count);
+	    applyoverlay(flushing, lba, data, count);
+	    applyoverlay(pending, lba, data, count);
+	    return true;
+	}
+
+	// Returns true if any sectors between "lba" and "lba + count" are in the map
+	bool intersects(uint32_t lba, size_t count)
+	{
+	    lock_guard<mutex> lock(writer_mutex);
+	    return (intersects(written, lba, count) || intersects(flushing, lba, count) || intersects(pending, lba, count));
+	}
+
+	// Patches any sectors between "lba" and "lba + count" that are in the map into "data"
+	void apply(uint32_t lba, uint8_t *data, size_t count)
+	{
+	    lock_guard<mutex> lock(writer_mutex);
+	    applyoverlay(written, lba, data, count);
+	    applyoverlay(flushing, lba, data, count);
+	    applyoverlay(pending, lba, data, count);
+	}
+
+	// Waits until every sector written so far has reached the image file
+	void sync()
+	{
+	    unique_lock<mutex> lock(writer_mutex);
+
+	    if (!flush_thread.joinable())
+	    {
+		return;
+	    }
+
+	    is_syncing = true;
+	    writer_cond.notify_all();
+	    sync_cond.wait(lock, [this]() { return (pending.empty() && flushing.empty()); });
+	    is_syncing = false;
+	    lock.unlock();
+	    syncfile();
+	}
+
+	size_t getpendingcount()
+	{
+	    lock_guard<mutex> lock(writer_mutex);
+	    return (pending.size() + flushing.size());
+	}
+
+	// How long the flush thread waits for more writes to come in before writing out a batch
+	chrono::milliseconds flush_delay = chrono::milliseconds(100);
+
+	// Keeps sectors in the map once they've been written out (until the image is reopened)
+	bool keep_written = false;
+
+    private:
+	thread flush_thread;
+	mutex writer_mutex;
+	condition_variable writer_cond;
+	condition_variable sync_cond;
+	bool is_stopping = false;
+	bool is_syncing = false;
+
+	// Sectors written by the guest, the batch that's currently being written out,
+	// and the sectors that have already been written out (if "keep_written" is set)
+	map<uint32_t, Sector> pending;
+	map<uint32_t, Sector> flushing;
+	map<uint32_t, Sector> written;
+
+	bool intersects(map<uint32_t, Sector> &sectors, uint32_t lba, size_t count)
+	{
+	    auto it = sectors.lower_bound(lba);
+	    return ((it != sectors.end()) && (it->first < (lba + count)));
+	}
+
+	void applyoverlay(map<uint32_t, Sector> &sectors, uint32_t lba, uint8_t *data, size_t count)
+	{
+	    for (auto it = sectors.lower_bound(lba); (it != sectors.end()) && (it->first < (lba + count)); it++)
+	    {
+		memcpy((data + (size_t(it->first - lba) * 512)), it->second.data(), 512);
+	    }
+	}
+
+	void flushloop()
+	{
+	    unique_lock<mutex> lock(writer_mutex);
+
+	    while (true)
+	    {
+		writer_cond.wait(lock, [this]() { return (is_stopping || !pending.empty()); });
+
+		if (pending.empty())
+		{
+		    break;
+		}
+
+		// Give the guest a moment to finish what it's writing, so that it can be written out in larger runs
+		writer_cond.wait_for(lock, flush_delay, [this]() { return (is_stopping || is_syncing); });
+
+		flushing.swap(pending);
+		lock.unlock();
+
+		writesectors();
+
+		// Free the written sectors outside of the lock, so that a large batch doesn't hold up the guest
+		map<uint32_t, Sector> batch;
+		lock.lock();
+
+		if (keep_written)
+		{
+		    for (auto &sector : flushing)
+		    {
+			written[sector.first] = sector.second;
+		    }
+
+		    flushing.clear();
+		}
+		else
+		{
+		    batch.swap(flushing);
+		}
+
+		sync_cond.notify_all();
+		lock.unlock();
+		batch.clear();
+		lock.lock();
+	    }
+	}
+
+	// Writes out the batch in "flushing" as runs of consecutive sectors
+	// ("flushing" is only changed by this thread, so it can be read without holding the lock)
+	void writesectors()
+	{
+	    vector<uint8_t> buffer;
+
+	    for (auto it = flushing.begin(); it != flushing.end();)
+	    {
+		uint32_t start = it->first;
+		buffer.clear();
+
+		for (uint32_t lba = start; (it != flushing.end()) && (it->first == lba); it++, lba++)
+		{
+		    buffer.insert(buffer.end(), it->second.begin(), it->second.end());
+		}
+
+		if (!writeat((uint64_t(start) * 512), buffer.data(), buffer.size()))
+		{
+		    cout << "Error: could not write to disk image" << endl;
+		}
+	    }
+	}
+
+#ifdef _WIN32
+	HANDLE file_handle = INVALID_HANDLE_VALUE;
+
+	bool openfile(string filename)
+	{
+	    file_handle = CreateFileA(filename.c_str(), GENERIC_WRITE, (FILE_SHARE_READ | FILE_SHARE_WRITE), NULL, OPEN_EXISTING, 0, NULL);
+	    return (file_handle != INVALID_HANDLE_VALUE);
+	}
+
+	void closefile()
+	{
+	    if (file_handle != INVALID_HANDLE_VALUE)
+	    {
+		CloseHandle(file_handle);
+		file_handle = INVALID_HANDLE_VALUE;
+	    }
+	}
+
+	void syncfile()
+	{
+	    if (file_handle != INVALID_HANDLE_VALUE)
+	    {
+		FlushFileBuffers(file_handle);
+	    }
+	}
+
+	bool writeat(uint64_t offset, const uint8_t *data, size_t size)
+	{
+	    OVERLAPPED overlapped = {};
+	    overlapped.Offset = DWORD(offset & 0xFFFFFFFF);
+	    overlapped.OffsetHigh = DWORD(offset >> 32);
+
+	    DWORD num_written = 0;
+	    return (WriteFile(file_handle, data, DWORD(size), &num_written, &overlapped) && (num_written == size));
+	}
+#else
+	int file_fd = -1;
+
+	bool openfile(string filename)
+	{
+	    file_fd = ::open(filename.c_str(), O_WRONLY);
+	    return (file_fd >= 0);
+	}
+
+	void closefile()
+	{
+	    if (file_fd >= 0)
+	    {
+		::close(file_fd);
+		file_fd = -1;
+	    }
+	}
+
+	void syncfile()
+	{
+	    if (file_fd >= 0)
+	    {
+		fsync(file_fd);
+	    }
+	}
+
+	bool writeat(uint64_t offset, const uint8_t *data, size_t size)
+	{
+	    size_t num_written = 0;
+
+	    while (num_written < size)
+	    {
+		ssize_t result = pwrite(file_fd, (data + num_written), (size - num_written), off_t(offset + num_written));
+
+		if (result <= 0)
+		{
+		    return false;
+		}
+
+		num_written += size_t(result);
+	    }
+
+	    return true;
+	}
+#endif
+};
+
+#endif // BEEDISKWRITER_H
\ No newline at end of file
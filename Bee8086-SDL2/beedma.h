@@ -0,0 +1,296 @@
+#ifndef BEE8086_DMA
+#define BEE8086_DMA
+
+#include <iostream>
+#include <array>
+#include <functional>
+#include <cstdint>
+#include <Bee8086/memorymap.h>
+#include <Bee8086/scheduler.h>
+using namespace bee8086;
+using namespace std;
+
+namespace beedma
+{
+    // Intel 8237 DMA controller (along with the PC's DMA page registers)
+    //
+    // Instead of moving a byte for each DREQ, a device hands over its whole buffer with request(),
+    // and the transfer completes as a single block copy once the time it would have taken has elapsed
+    class BeeDMA
+    {
+	public:
+	    // Called once a transfer completes, with the number of bytes transferred
+	    // and whether the channel reached terminal count
+	    using Callback = function<void(size_t, bool)>;
+
+	    BeeDMA(Bee8086MemoryMap &memory, Bee8086Scheduler &sched) : memory_map(memory), scheduler(sched)
+	    {
+		reset();
+	    }
+
+	    ~BeeDMA()
+	    {
+
+	    }
+
+	    void reset()
+	    {
+		for (auto &channel : channels)
+		{
+		    channel = Channel();
+		}
+
+		command_reg = 0;
+		status_reg = 0;
+		temp_reg = 0;
+		is_flip_flop = false;
+	    }
+
+	    bool isport(uint16_t port)
+	    {
+		return ((port < 0x10) || (port == 0x81) || (port == 0x82) || (port == 0x83) || (port == 0x87));
+	    }
+
+	    uint8_t readPort(uint16_t port)
+	    {
+		if (port < 0x08)
+		{
+		    Channel &channel = channels[port >> 1];
+		    uint16_t value = testbit(port, 0) ? channel.cur_count : channel.cur_addr;
+		    return readflipflop(value);
+		}
+
+		switch (port)
+		{
+		    case 0x08:
+		    {
+			// Reading the status register clears the terminal count bits
+			uint8_t data = status_reg;
+			status_reg &= 0xF0;
+			return data;
+		    }
+		    break;
+		    case 0x0D: return temp_reg; break;
+		    case 0x81: return channels[2].page; break;
+		    case 0x82: return channels[3].page; break;
+		    case 0x83: return channels[1].page; break;
+		    case 0x87: return channels[0].page; break;
+		    default: break;
+		}
+
+		return 0xFF;
+	    }
+
+	    void writePort(uint16_t port, uint8_t data)
+	    {
+		if (port < 0x08)
+		{
+		    Channel &channel = channels[port >> 1];
+
+		    // Writes go to both the base and current registers
+		    if (testbit(port, 0))
+		    {
+			channel.base_count = writeflipflop(channel.base_count, data);
+			channel.cur_count = channel.base_count;
+		    }
+		    else
+		    {
+			channel.base_addr = writeflipflop(channel.base_addr, data);
+			channel.cur_addr = channel.base_addr;
+		    }
+
+		    return;
+		}
+
+		switch (port)
+		{
+		    case 0x08: command_reg = data; break;
+		    case 0x09:
+		    {
+			// Software DMA requests aren't used by anything on the PC
+			status_reg = setbit(status_reg, (4 + (data & 3)), testbit(data, 2));
+		    }
+		    break;
+		    case 0x0A: channels[data & 3].is_masked = testbit(data, 2); break;
+		    case 0x0B: channels[data & 3].mode = data; break;
+		    case 0x0C: is_flip_flop = false; break;
+		    case 0x0D: reset(); break;
+		    case 0x0E:
+		    {
+			for (auto &channel : channels)
+			{
+			    channel.is_masked = false;
+			}
+		    }
+		    break;
+		    case 0x0F:
+		    {
+			for (int index = 0; index < 4; index++)
+			{
+			    channels[index].is_masked = testbit(data, index);
+			}
+		    }
+		    break;
+		    case 0x81: channels[2].page = (data & 0xF); break;
+		    case 0x82: channels[3].page = (data & 0xF); break;
+		    case 0x83: channels[1].page = (data & 0xF); break;
+		    case 0x87: channels[0].page = (data & 0xF); break;
+		    default: break;
+		}
+	    }
+
+	    // Starts a transfer of up to "size" bytes between "buffer" and memory on channel "channel_num",
+	    // in whichever direction the channel has been programmed for (the transfer is cut short
+	    // at the channel's terminal count), which completes after "cycles_per_byte" cycles per byte
+	    //
+	    // "buffer" has to stay valid until "func" is called, and returns false if the channel is masked or busy
+	    bool request(int channel_num, uint8_t *buffer, size_t size, uint64_t cycles_per_byte, Callback func)
+	    {
+		Channel &channel = channels[channel_num & 3];
+
+		if (channel.is_masked || channel.is_busy || testbit(command_reg, 2) || (size == 0))
+		{
+		    return false;
+		}
+
+		// The count register holds one less than the number of bytes to transfer
+		size_t length = min<size_t>(size, (size_t(channel.cur_count) + 1));
+
+		channel.is_busy = true;
+		status_reg = setbit(status_reg, (4 + (channel_num & 3)), true);
+
+		scheduler.schedule((length * cycles_per_byte), [this, channel_num, buffer, length, func]()
+		{
+		    bool is_terminal_count = transfer((channel_num & 3), buffer, length);
+
+		    if (func)
+		    {
+			func(length, is_terminal_count);
+		    }
+		});
+
+		return true;
+	    }
+
+	    bool ismasked(int channel_num)
+	    {
+		return channels[channel_num & 3].is_masked;
+	    }
+
+	private:
+	    Bee8086MemoryMap &memory_map;
+	    Bee8086Scheduler &scheduler;
+
+	    struct Channel
+	    {
+		uint16_t base_addr = 0;
+		uint16_t base_count = 0;
+		uint16_t cur_addr = 0;
+		uint16_t cur_count = 0;
+		uint8_t mode = 0;
+		uint8_t page = 0;
+		bool is_masked = true;
+		bool is_busy = false;
+	    };
+
+	    array<Channel, 4> channels;
+	    uint8_t command_reg = 0;
+	    uint8_t status_reg = 0;
+	    uint8_t temp_reg = 0;
+	    bool is_flip_flop = false;
+
+	    // Moves "length" bytes, and returns true if the channel reached terminal count
+	    bool transfer(int channel_num, uint8_t *buffer, size_t length)
+	    {
+		Channel &channel = channels[channel_num];
+		int transfer_type = ((channel.mode >> 2) & 3);
+		bool is_decrement = testbit(channel.mode, 5);
+
+		// The address counter is only 16 bits wide, so transfers wrap around within their 64 KB page
+		size_t offs = 0;
+
+		while (offs < length)
+		{
+		    uint32_t addr = ((channel.page << 16) | channel.cur_addr);
+		    size_t run = is_decrement ? 1 : min<size_t>((length - offs), (0x10000 - channel.cur_addr));
+
+		    switch (transfer_type)
+		    {
+			case 1: memory_map.writeBlock(addr, (buffer + offs), run); break; // Write (device to memory)
+			case 2: memory_map.readBlock(addr, (buffer + offs), run); break; // Read (memory to device)
+			default: break; // Verify (nothing is moved)
+		    }
+
+		    channel.cur_addr = is_decrement ? (channel.cur_addr - 1) : (channel.cur_addr + run);
+		    offs += run;
+		}
+
+		bool is_terminal_count = (length == (size_t(channel.cur_count) + 1));
+		channel.cur_count -= length;
+		channel.is_busy = false;
+		status_reg = setbit(status_reg, (4 + channel_num), false);
+
+		if (is_terminal_count)
+		{
+		    status_reg = setbit(status_reg, channel_num, true);
+
+		    // Autoinitialize reloads the channel, and otherwise it masks itself
+		    if (testbit(channel.mode, 4))
+		    {
+			channel.cur_addr = channel.base_addr;
+			channel.cur_count = channel.base_count;
+		    }
+		    else
+		    {
+			channel.is_masked = true;
+		    }
+		}
+
+		return is_terminal_count;
+	    }
+
+	    uint8_t readflipflop(uint16_t value)
+	    {
+		uint8_t data = is_flip_flop ? (value >> 8) : (value & 0xFF);
+		is_flip_flop = !is_flip_flop;
+		return data;
+	    }
+
+	    uint16_t writeflipflop(uint16_t value, uint8_t data)
+	    {
+		if (is_flip_flop)
+		{
+		    value = ((value & 0xFF) | (data << 8));
+		}
+		else
+		{
+		    value = ((value & 0xFF00) | data);
+		}
+
+		is_flip_flop = !is_flip_flop;
+		return value;
+	    }
+
+	    template<typename T>
+	    bool testbit(T reg, int bit)
+	    {
+		return ((reg >> bit) & 1) ? true : false;
+	    }
+
+	    template<typename T>
+	    T setbit(T reg, int bit, bool val)
+	    {
+		if (val)
+		{
+		    return (reg | (1 << bit));
+		}
+		else
+		{
+		    return (reg & ~(1 << bit));
+		}
+	    }
+    };
+}
+
+
+#endif // BEE8086_DMA
\ No newline at end of file
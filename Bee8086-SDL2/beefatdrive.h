@@ -0,0 +1,749 @@
+#ifndef BEEFATDRIVE_H
+#define BEEFATDRIVE_H
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <set>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <sys/stat.h>
+#include "beedisk.h"
+#include "beediskoverlay.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+using namespace std;
+
+// Fixed disk that presents a host directory as a FAT12 or FAT16 volume
+//
+// The directory tree is scanned once when the drive is opened, and each file and directory
+// is given a contiguous run of clusters; the partition table, boot sector, FATs and directories
+// are then built on the fly as they're read, and file clusters are read straight from the host files
+//
+// The host directory is never written to, and the guest's writes are kept in an overlay in memory instead
+class BeeFatDrive : public BeeDisk
+{
+    public:
+	BeeFatDrive()
+	{
+
+	}
+
+	~BeeFatDrive()
+	{
+	    close();
+	}
+
+	BeeFatDrive(const BeeFatDrive&) = delete;
+	BeeFatDrive &operator=(const BeeFatDrive&) = delete;
+
+	static bool isdirectory(string path)
+	{
+	    struct stat path_stat;
+	    return ((stat(path.c_str(), &path_stat) == 0) && ((path_stat.st_mode & S_IFMT) == S_IFDIR));
+	}
+
+	bool open(string path)
+	{
+	    close();
+
+	    if (!isdirectory(path))
+	    {
+		cout << "Error: " << path << " is not a directory" << endl;
+		return false;
+	    }
+
+	    Entry root;
+	    root.is_dir = true;
+	    root.host_path = path;
+	    entries.push_back(root);
+	    scandir(0, 0);
+
+	    // The root directory has a fixed number of entries (including the volume label)
+	    if ((entries[0].children.size() + 1) > root_entries)
+	    {
+		cout << "Error: " << path << " has too many files to fit in the root directory" << endl;
+		close();
+		return false;
+	    }
+
+	    if (!buildlayout())
+	    {
+		cout << "Error: " << path << " is too large to fit in a FAT16 volume" << endl;
+		close();
+		return false;
+	    }
+
+	    overlay.open(uint32_t(disk_sectors), 0);
+
+	    cout << path << " succesfully loaded (" << dec << (entries.size() - 1) << " files and directories, ";
+	    cout << (is_fat16 ? "FAT16" : "FAT12") << ", " << num_clusters << " clusters of " << (cluster_sectors * 512) << " bytes)." << endl;
+	    return true;
+	}
+
+	void close() override
+	{
+	    overlay.close();
+	    host_file.close();
+	    host_entry = -1;
+	    entries.clear();
+	    chains.clear();
+	    disk_sectors = 0;
+	    numcylinders = 0;
+	    numheads = 0;
+	    numsectors = 0;
+	}
+
+	bool isopen() override
+	{
+	    return (disk_sectors != 0);
+	}
+
+	uint64_t getsectorcount() override
+	{
+	    return disk_sectors;
+	}
+
+	size_t readSectors(uint32_t lba, size_t count, uint8_t *data) override
+	{
+	    size_t num_read = 0;
+
+	    while ((num_read < count) && isvalid(lba + num_read))
+	    {
+		num_read += readrun((lba + num_read), (count - num_read), (data + (num_read * 512)));
+	    }
+
+	    overlay.apply(lba, data, num_read);
+	    return num_read;
+	}
+
+	size_t writeSectors(uint32_t lba, size_t count, const uint8_t *data) override
+	{
+	    size_t num_written = 0;
+
+	    while ((num_written < count) && isvalid(lba + num_written))
+	    {
+		num_written += 1;
+	    }
+
+	    overlay.write(lba, data, num_written);
+	    return num_written;
+	}
+
+	bool isreadonly() override
+	{
+	    return false;
+	}
+
+	// Amount of free space on the volume (in bytes)
+	uint32_t free_space = (1024 * 1024);
+
+    private:
+	struct Entry
+	{
+	    string host_path = "";
+	    char name[11] = {0};
+	    bool is_dir = false;
+	    uint32_t size = 0;
+	    uint16_t time = 0;
+	    uint16_t date = 0;
+	    uint32_t first_cluster = 0;
+	    uint32_t num_clusters = 0;
+	    int parent = 0;
+	    vector<int> children;
+	};
+
+	vector<Entry> entries;
+
+	// First cluster of each entry's chain (in order), for looking up which entry owns a cluster
+	vector<pair<uint32_t, int>> chains;
+
+	BeeDiskOverlay overlay;
+
+	// Most recently read host file
+	ifstream host_file;
+	int host_entry = -1;
+
+	const uint32_t root_entries = 512;
+	const uint32_t partition_start = 63;
+
+	uint64_t disk_sectors = 0;
+	bool is_fat16 = false;
+	uint32_t cluster_sectors = 0;
+	uint32_t num_clusters = 0;
+	uint32_t fat_sectors = 0;
+	uint32_t volume_sectors = 0;
+
+	// Layout of the volume (in sectors from the start of the partition)
+	uint32_t fat_start = 1;
+	uint32_t root_start = 0;
+	uint32_t data_start = 0;
+
+	void scandir(int index, int depth)
+	{
+	    vector<string> names = listdir(entries[index].host_path);
+	    sort(names.begin(), names.end());
+
+	    set<string> short_names;
+
+	    for (auto &name : names)
+	    {
+		string host_path = (entries[index].host_path + "/" + name);
+		struct stat path_stat;
+
+		if (stat(host_path.c_str(), &path_stat) != 0)
+		{
+		    continue;
+		}
+
+		Entry entry;
+		entry.host_path = host_path;
+		entry.parent = index;
+
+		if ((path_stat.st_mode & S_IFMT) == S_IFDIR)
+		{
+		    // Don't follow links around in circles
+		    if (depth >= 16)
+		    {
+			continue;
+		    }
+
+		    entry.is_dir = true;
+		}
+		else if ((path_stat.st_mode & S_IFMT) == S_IFREG)
+		{
+		    if (uint64_t(path_stat.st_size) > 0x7FFFFFFF)
+		    {
+			cout << "Warning: skipping " << host_path << " (too large for FAT)" << endl;
+			continue;
+		    }
+
+		    entry.size = uint32_t(path_stat.st_size);
+		}
+		else
+		{
+		    continue;
+		}
+
+		string short_name = getshortname(name, short_names);
+		short_names.insert(short_name);
+		memcpy(entry.name, short_name.data(), 11);
+		settimestamp(entry, path_stat.st_mtime);
+
+		int child = entries.size();
+		entries.push_back(entry);
+		entries[index].children.push_back(child);
+
+		if (entries[child].is_dir)
+		{
+		    scandir(child, (depth + 1));
+		}
+	    }
+	}
+
+	// Converts a host file name into a unique 8.3 name (padded out to 11 characters)
+	string getshortname(string name, set<string> &short_names)
+	{
+	    size_t dot_pos = name.find_last_of('.');
+	    string base = ((dot_pos == string::npos) || (dot_pos == 0)) ? name : name.substr(0, dot_pos);
+	    string ext = ((dot_pos == string::npos) || (dot_pos == 0)) ? "" : name.substr(dot_pos + 1);
+
+	    bool is_lossy = false;
+	    base = getshortpart(base, is_lossy);
+	    ext = getshortpart(ext, is_lossy);
+
+	    if (base.empty())
+	    {
+		base = "_";
+		is_lossy = true;
+	    }
+
+	    is_lossy |= ((base.size() > 8) || (ext.size() > 3));
+	    ext = ext.substr(0, 3);
+
+	    string short_name = padname(base.substr(0, 8), ext);
+
+	    // Names that had to be changed (or that clash with another name) get a numeric tail (i.e. LONGNA~1.TXT)
+	    for (int tail = 1; (is_lossy || (short_names.count(short_name) != 0)); tail++)
+	    {
+		string suffix = ("~" + to_string(tail));
+		short_name = padname((base.substr(0, (8 - suffix.size())) + suffix), ext);
+		is_lossy = false;
+	    }
+
+	    return short_name;
+	}
+
+	string getshortpart(string part, bool &is_lossy)
+	{
+	    string result = "";
+
+	    for (char c : part)
+	    {
+		if ((c == ' ') || (c == '.'))
+		{
+		    is_lossy = true;
+		    continue;
+		}
+
+		if ((c >= 'a') && (c <= 'z'))
+		{
+		    c -= 0x20;
+		}
+		else if (!(((c >= 'A') && (c <= 'Z')) || ((c >= '0') && (c <= '9')) || (strchr("!#$%&'()-@^_`{}~", c) != NULL)))
+		{
+		    c = '_';
+		    is_lossy = true;
+		}
+
+		result.push_back(c);
+	    }
+
+	    return result;
+	}
+
+	string padname(string base, string ext)
+	{
+	    base.resize(8, ' ');
+	    ext.resize(3, ' ');
+	    return (base + ext);
+	}
+
+	void settimestamp(Entry &entry, time_t mtime)
+	{
+	    struct tm *local = localtime(&mtime);
+
+	    if ((local == NULL) || (local->tm_year < 80))
+	    {
+		// 1980-01-01 is the earliest date FAT can hold
+		entry.date = ((0 << 9) | (1 << 5) | 1);
+		entry.time = 0;
+		return;
+	    }
+
+	    entry.date = (((local->tm_year - 80) << 9) | ((local->tm_mon + 1) << 5) | local->tm_mday);
+	    entry.time = ((local->tm_hour << 11) | (local->tm_min << 5) | (local->tm_sec / 2));
+	}
+
+	// Picks the smallest cluster size that fits everything in a FAT16 volume,
+	// and lays out the clusters and the rest of the disk
+	bool buildlayout()
+	{
+	    for (cluster_sectors = 1; cluster_sectors <= 64; cluster_sectors *= 2)
+	    {
+		uint32_t cluster_size = (cluster_sectors * 512);
+		uint64_t used_clusters = 0;
+
+		for (size_t index = 1; index < entries.size(); index++)
+		{
+		    used_clusters += getclustercount(entries[index], cluster_size);
+		}
+
+		uint64_t clusters = (used_clusters + ((free_space + cluster_size - 1) / cluster_size));
+
+		if (clusters > 65524)
+		{
+		    continue;
+		}
+
+		num_clusters = uint32_t(clusters);
+
+		// FAT12 only goes up to 4084 clusters (the FAT type is worked out from the cluster count)
+		is_fat16 = (num_clusters >= 4085);
+		uint32_t fat_bytes = is_fat16 ? ((num_clusters + 2) * 2) : (((num_clusters + 2) * 3 + 1) / 2);
+		fat_sectors = ((fat_bytes + 511) / 512);
+
+		root_start = (fat_start + (fat_sectors * 2));
+		data_start = (root_start + ((root_entries * 32) / 512));
+		volume_sectors = (data_start + (num_clusters * cluster_sectors));
+		allocateclusters(cluster_size);
+		return buildgeometry();
+	    }
+
+	    return false;
+	}
+
+	uint32_t getclustercount(Entry &entry, uint32_t cluster_size)
+	{
+	    // Subdirectories also hold "." and ".."
+	    uint64_t size = entry.is_dir ? ((entry.children.size() + 2) * 32) : entry.size;
+	    return uint32_t((size + cluster_size - 1) / cluster_size);
+	}
+
+	void allocateclusters(uint32_t cluster_size)
+	{
+	    uint32_t next_cluster = 2;
+	    chains.clear();
+
+	    for (size_t index = 1; index < entries.size(); index++)
+	    {
+		Entry &entry = entries[index];
+		entry.num_clusters = getclustercount(entry, cluster_size);
+		entry.first_cluster = (entry.num_clusters != 0) ? next_cluster : 0;
+
+		if (entry.num_clusters != 0)
+		{
+		    chains.push_back(make_pair(entry.first_cluster, int(index)));
+		}
+
+		next_cluster += entry.num_clusters;
+	    }
+	}
+
+	// Uses 63 sectors per track and 16 heads (or 255 heads for larger volumes),
+	// with the partition starting on the second track
+	bool buildgeometry()
+	{
+	    uint64_t total_sectors = (partition_start + volume_sectors);
+	    numsectors = 63;
+	    numheads = 16;
+
+	    if (total_sectors > (1024 * 16 * 63))
+	    {
+		numheads = 255;
+	    }
+
+	    uint64_t cylinder_sectors = (numheads * numsectors);
+	    numcylinders = int((total_sectors + cylinder_sectors - 1) / cylinder_sectors);
+
+	    if (numcylinders > 1024)
+	    {
+		return false;
+	    }
+
+	    disk_sectors = (numcylinders * cylinder_sectors);
+	    return true;
+	}
+
+	// Reads one or more sectors starting at "lba", and returns the number of sectors read
+	// (runs of file data are read from the host in one go)
+	size_t readrun(uint32_t lba, size_t count, uint8_t *data)
+	{
+	    memset(data, 0, 512);
+
+	    if (lba == 0)
+	    {
+		buildmbr(data);
+		return 1;
+	    }
+
+	    if ((lba < partition_start) || (lba >= (partition_start + volume_sectors)))
+	    {
+		return 1;
+	    }
+
+	    uint32_t sector = (lba - partition_start);
+
+	    if (sector == 0)
+	    {
+		buildbootsector(data);
+	    }
+	    else if (sector < root_start)
+	    {
+		buildfatsector(((sector - fat_start) % fat_sectors), data);
+	    }
+	    else if (sector < data_start)
+	    {
+		builddirsector(0, (sector - root_start), data);
+	    }
+	    else
+	    {
+		uint32_t cluster = (2 + ((sector - data_start) / cluster_sectors));
+		int index = getowner(cluster);
+
+		if (index < 0)
+		{
+		    return 1;
+		}
+
+		Entry &entry = entries[index];
+		uint32_t entry_sector = (((cluster - entry.first_cluster) * cluster_sectors) + ((sector - data_start) % cluster_sectors));
+
+		if (entry.is_dir)
+		{
+		    builddirsector(index, entry_sector, data);
+		    return 1;
+		}
+
+		uint32_t sectors_left = ((entry.num_clusters * cluster_sectors) - entry_sector);
+		size_t length = min<size_t>(count, sectors_left);
+		readhostfile(index, (uint64_t(entry_sector) * 512), data, (length * 512));
+		return length;
+	    }
+
+	    return 1;
+	}
+
+	int getowner(uint32_t cluster)
+	{
+	    auto it = upper_bound(chains.begin(), chains.end(), make_pair(cluster, INT32_MAX));
+
+	    if (it == chains.begin())
+	    {
+		return -1;
+	    }
+
+	    it--;
+	    Entry &entry = entries[it->second];
+	    return (cluster < (entry.first_cluster + entry.num_clusters)) ? it->second : -1;
+	}
+
+	void readhostfile(int index, uint64_t offset, uint8_t *data, size_t size)
+	{
+	    memset(data, 0, size);
+
+	    if (host_entry != index)
+	    {
+		host_file.close();
+		host_file.clear();
+		host_file.open(entries[index].host_path.c_str(), ios::in | ios::binary);
+		host_entry = index;
+	    }
+
+	    if (!host_file.is_open() || (offset >= entries[index].size))
+	    {
+		return;
+	    }
+
+	    // Anything past the end of the file (as it was when the directory was scanned) reads as zero
+	    size_t length = size_t(min<uint64_t>(size, (entries[index].size - offset)));
+	    host_file.clear();
+	    host_file.seekg(offset);
+	    host_file.read((char*)data, length);
+	}
+
+	void buildmbr(uint8_t *data)
+	{
+	    uint8_t *partition = &data[0x1BE];
+	    partition[0] = 0x00;
+	    putchs(&partition[1], partition_start);
+	    partition[4] = is_fat16 ? ((volume_sectors < 65536) ? 0x04 : 0x06) : 0x01;
+	    putchs(&partition[5], (partition_start + volume_sectors - 1));
+	    putlong(&partition[8], partition_start);
+	    putlong(&partition[12], volume_sectors);
+	    data[510] = 0x55;
+	    data[511] = 0xAA;
+	}
+
+	void putchs(uint8_t *data, uint32_t lba)
+	{
+	    uint32_t cylinder = min<uint32_t>((lba / (numheads * numsectors)), 1023);
+	    uint32_t head = ((lba / numsectors) % numheads);
+	    uint32_t sector = ((lba % numsectors) + 1);
+	    data[0] = head;
+	    data[1] = (sector | ((cylinder >> 2) & 0xC0));
+	    data[2] = (cylinder & 0xFF);
+	}
+
+	void buildbootsector(uint8_t *data)
+	{
+	    const uint8_t jump[3] = {0xEB, 0x3C, 0x90};
+	    memcpy(&data[0], jump, 3);
+	    memcpy(&data[3], "BEE8086 ", 8);
+	    putword(&data[11], 512);
+	    data[13] = cluster_sectors;
+	    putword(&data[14], fat_start);
+	    data[16] = 2;
+	    putword(&data[17], root_entries);
+	    putword(&data[19], (volume_sectors < 65536) ? volume_sectors : 0);
+	    data[21] = 0xF8;
+	    putword(&data[22], fat_sectors);
+	    putword(&data[24], numsectors);
+	    putword(&data[26], numheads);
+	    putlong(&data[28], partition_start);
+	    putlong(&data[32], (volume_sectors < 65536) ? 0 : volume_sectors);
+	    data[36] = 0x80;
+	    data[38] = 0x29;
+	    putlong(&data[39], 0x8086BEE0);
+	    memcpy(&data[43], "BEE8086    ", 11);
+	    memcpy(&data[54], (is_fat16 ? "FAT16   " : "FAT12   "), 8);
+
+	    // The volume isn't bootable, so just hand things back to the BIOS
+	    const uint8_t boot_code[2] = {0xCD, 0x18};
+	    memcpy(&data[62], boot_code, 2);
+	    data[510] = 0x55;
+	    data[511] = 0xAA;
+	}
+
+	void buildfatsector(uint32_t sector, uint8_t *data)
+	{
+	    uint32_t offset = (sector * 512);
+
+	    for (uint32_t index = 0; index < 512; index++)
+	    {
+		data[index] = getfatbyte(offset + index);
+	    }
+	}
+
+	uint8_t getfatbyte(uint32_t offset)
+	{
+	    if (is_fat16)
+	    {
+		uint16_t value = getfatentry(offset / 2);
+		return (offset & 1) ? (value >> 8) : (value & 0xFF);
+	    }
+
+	    // FAT12 packs two entries into every three bytes
+	    uint32_t pair = (offset / 3);
+	    uint16_t first = getfatentry(pair * 2);
+	    uint16_t second = getfatentry((pair * 2) + 1);
+
+	    switch (offset % 3)
+	    {
+		case 0: return (first & 0xFF); break;
+		case 1: return ((first >> 8) | ((second & 0xF) << 4)); break;
+		default: return (second >> 4); break;
+	    }
+	}
+
+	uint16_t getfatentry(uint32_t cluster)
+	{
+	    uint16_t end_of_chain = is_fat16 ? 0xFFFF : 0xFFF;
+
+	    // The first two entries hold the media descriptor
+	    if (cluster < 2)
+	    {
+		return (cluster == 0) ? (end_of_chain & 0xFFF8) : end_of_chain;
+	    }
+
+	    if (cluster >= (num_clusters + 2))
+	    {
+		return 0;
+	    }
+
+	    int index = getowner(cluster);
+
+	    if (index < 0)
+	    {
+		return 0;
+	    }
+
+	    Entry &entry = entries[index];
+	    return ((cluster + 1) == (entry.first_cluster + entry.num_clusters)) ? end_of_chain : (cluster + 1);
+	}
+
+	void builddirsector(int index, uint32_t sector, uint8_t *data)
+	{
+	    for (uint32_t slot = 0; slot < 16; slot++)
+	    {
+		builddirentry(index, ((sector * 16) + slot), &data[slot * 32]);
+	    }
+	}
+
+	void builddirentry(int index, uint32_t slot, uint8_t *data)
+	{
+	    Entry &dir = entries[index];
+
+	    // The root directory starts with the volume label, and subdirectories start with "." and ".."
+	    if (index == 0)
+	    {
+		if (slot == 0)
+		{
+		    memcpy(data, "BEE8086    ", 11);
+		    data[11] = 0x08;
+		    return;
+		}
+	    }
+	    else if (slot < 2)
+	    {
+		memcpy(data, ((slot == 0) ? ".          " : "..         "), 11);
+		data[11] = 0x10;
+		putword(&data[22], dir.time);
+		putword(&data[24], dir.date);
+		putword(&data[26], (slot == 0) ? dir.first_cluster : entries[dir.parent].first_cluster);
+		return;
+	    }
+
+	    uint32_t child = (slot - ((index == 0) ? 1 : 2));
+
+	    if (child >= dir.children.size())
+	    {
+		return;
+	    }
+
+	    Entry &entry = entries[dir.children[child]];
+	    memcpy(data, entry.name, 11);
+	    data[11] = entry.is_dir ? 0x10 : 0x20;
+	    putword(&data[22], entry.time);
+	    putword(&data[24], entry.date);
+	    putword(&data[26], entry.first_cluster);
+	    putlong(&data[28], entry.is_dir ? 0 : entry.size);
+	}
+
+	void putword(uint8_t *data, uint32_t val)
+	{
+	    data[0] = (val & 0xFF);
+	    data[1] = ((val >> 8) & 0xFF);
+	}
+
+	void putlong(uint8_t *data, uint32_t val)
+	{
+	    putword(&data[0], (val & 0xFFFF));
+	    putword(&data[2], (val >> 16));
+	}
+
+#ifdef _WIN32
+	vector<string> listdir(string path)
+	{
+	    vector<string> names;
+	    WIN32_FIND_DATAA find_data;
+	    HANDLE find_handle = FindFirstFileA((path + "\\*").c_str(), &find_data);
+
+	    if (find_handle == INVALID_HANDLE_VALUE)
+	    {
+		return names;
+	    }
+
+	    do
+	    {
+		string name = find_data.cFileName;
+
+		if ((name != ".") && (name != ".."))
+		{
+		    names.push_back(name);
+		}
+	    }
+	    while (FindNextFileA(find_handle, &find_data));
+
+	    FindClose(find_handle);
+	    return names;
+	}
+#else
+	vector<string> listdir(string path)
+	{
+	    vector<string> names;
+	    DIR *dir = opendir(path.c_str());
+
+	    if (dir == NULL)
+	    {
+		return names;
+	    }
+
+	    while (struct dirent *dir_entry = readdir(dir))
+	    {
+		string name = dir_entry->d_name;
+
+		if ((name != ".") && (name != ".."))
+		{
+		    names.push_back(name);
+		}
+	    }
+
+	    closedir(dir);
+	    return names;
+	}
+#endif
+};
+
+#endif // BEEFATDRIVE_H
\ No newline at end of file
@@ -0,0 +1,420 @@
+#ifndef BEE8086_FDC
+#define BEE8086_FDC
+
+#include <iostream>
+#include <array>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <initializer_list>
+#include <cstring>
+#include <cstdint>
+#include "beefloppy.h"
+#include "beediskio.h"
+#include "beedma.h"
+#include "beepic.h"
+using namespace bee8086;
+using namespace beedma;
+using namespace beepic;
+using namespace std;
+
+namespace beefdc
+{
+    // NEC uPD765 floppy disk controller (along with the PC/XT floppy adapter's digital output register),
+    // with just enough of it for a BIOS to seek, read and write drive A: through DMA channel 2 and IRQ 6
+    //
+    // Seeks finish at once, and each read or write is handed to the DMA controller as a single transfer
+    // (which takes as long as the drive's 250 kbps data rate would have)
+    class BeeFDC
+    {
+	public:
+	    BeeFDC(BeeFloppy &floppy, BeeDiskIO &io, BeeDMA &dma_ctrl, BeePIC &pic_ctrl, uint64_t clock) : disk(floppy), disk_io(io), dma(dma_ctrl), pic(pic_ctrl)
+	    {
+		cycles_per_byte = ((clock * 8) / 250000);
+		reset();
+	    }
+
+	    ~BeeFDC()
+	    {
+
+	    }
+
+	    void reset()
+	    {
+		dor = 0;
+		resetcontroller();
+	    }
+
+	    bool isport(uint16_t port)
+	    {
+		return ((port == 0x3F2) || (port == 0x3F4) || (port == 0x3F5));
+	    }
+
+	    uint8_t readPort(uint16_t port)
+	    {
+		switch (port)
+		{
+		    case 0x3F2: return dor; break;
+		    case 0x3F4: return readStatus(); break;
+		    case 0x3F5: return readData(); break;
+		    default: break;
+		}
+
+		return 0xFF;
+	    }
+
+	    void writePort(uint16_t port, uint8_t data)
+	    {
+		switch (port)
+		{
+		    case 0x3F2: writeDOR(data); break;
+		    case 0x3F5: writeData(data); break;
+		    default: break;
+		}
+	    }
+
+	private:
+	    BeeFloppy &disk;
+	    BeeDiskIO &disk_io;
+	    BeeDMA &dma;
+	    BeePIC &pic;
+	    uint64_t cycles_per_byte = 0;
+
+	    enum Phase : int
+	    {
+		Command = 0,
+		Execution = 1,
+		Result = 2,
+	    };
+
+	    Phase phase = Command;
+	    uint8_t dor = 0;
+
+	    array<uint8_t, 9> command;
+	    size_t command_pos = 0;
+	    size_t command_length = 0;
+
+	    array<uint8_t, 7> result;
+	    size_t result_pos = 0;
+	    size_t result_length = 0;
+
+	    // Present cylinder number of each drive
+	    array<uint8_t, 4> cylinders;
+
+	    // ST0 of each seek (or reset) that's still waiting for a Sense Interrupt Status command
+	    deque<uint8_t> pending_st0;
+
+	    // Sectors being transferred by the current read or write
+	    vector<uint8_t> buffer;
+	    uint32_t transfer_lba = 0;
+
+	    void resetcontroller()
+	    {
+		phase = Command;
+		command_pos = 0;
+		command_length = 0;
+		result_pos = 0;
+		result_length = 0;
+		cylinders.fill(0);
+		pending_st0.clear();
+	    }
+
+	    void writeDOR(uint8_t data)
+	    {
+		bool is_leaving_reset = (!testbit(dor, 2) && testbit(data, 2));
+		dor = data;
+
+		if (!testbit(dor, 2))
+		{
+		    resetcontroller();
+		    return;
+		}
+
+		// Coming out of reset interrupts once, with a Sense Interrupt Status owed to each drive
+		if (is_leaving_reset)
+		{
+		    for (int drive = 0; drive < 4; drive++)
+		    {
+			pending_st0.push_back(0xC0 | drive);
+		    }
+
+		    raiseinterrupt();
+		}
+	    }
+
+	    uint8_t readStatus()
+	    {
+		switch (phase)
+		{
+		    case Command: return (command_pos == 0) ? 0x80 : 0x90; break;
+		    case Execution: return 0x10; break;
+		    case Result: return 0xD0; break;
+		    default: break;
+		}
+
+		return 0x80;
+	    }
+
+	    uint8_t readData()
+	    {
+		if (phase != Result)
+		{
+		    return 0xFF;
+		}
+
+		uint8_t data = result[result_pos++];
+
+		if (result_pos == result_length)
+		{
+		    phase = Command;
+		}
+
+		return data;
+	    }
+
+	    void writeData(uint8_t data)
+	    {
+		if (phase != Command)
+		{
+		    return;
+		}
+
+		if (command_pos == 0)
+		{
+		    command_length = getcommandlength(data);
+		}
+
+		command[command_pos++] = data;
+
+		if (command_pos == command_length)
+		{
+		    command_pos = 0;
+		    runcommand();
+		}
+	    }
+
+	    size_t getcommandlength(uint8_t data)
+	    {
+		switch (data & 0x1F)
+		{
+		    case 0x03: return 3; break; // Specify
+		    case 0x04: return 2; break; // Sense Drive Status
+		    case 0x05: return 9; break; // Write Data
+		    case 0x06: return 9; break; // Read Data
+		    case 0x07: return 2; break; // Recalibrate
+		    case 0x08: return 1; break; // Sense Interrupt Status
+		    case 0x0F: return 3; break; // Seek
+		    default: break;
+		}
+
+		return 1;
+	    }
+
+	    void runcommand()
+	    {
+		int drive = (command[1] & 3);
+		int head = ((command[1] >> 2) & 1);
+
+		switch (command[0] & 0x1F)
+		{
+		    // The step rate and head load times don't matter, since seeks finish at once
+		    case 0x03: break;
+		    case 0x04:
+		    {
+			uint8_t st3 = ((head << 2) | drive);
+			st3 |= isready(drive) ? 0x20 : 0x00;
+			st3 |= (cylinders[drive] == 0) ? 0x10 : 0x00;
+			st3 |= (isready(drive) && (disk.numheads == 2)) ? 0x08 : 0x00;
+			st3 |= (isready(drive) && disk.isreadonly()) ? 0x40 : 0x00;
+			setresult({st3});
+		    }
+		    break;
+		    case 0x05: starttransfer(true); break;
+		    case 0x06: starttransfer(false); break;
+		    case 0x07: seek(drive, 0); break;
+		    case 0x08:
+		    {
+			// Without an interrupt to sense, this is an invalid command
+			if (pending_st0.empty())
+			{
+			    setresult({0x80});
+			    break;
+			}
+
+			uint8_t st0 = pending_st0.front();
+			pending_st0.pop_front();
+			setresult({st0, cylinders[st0 & 3]});
+		    }
+		    break;
+		    case 0x0F: seek(drive, command[2]); break;
+		    default: setresult({0x80}); break;
+		}
+	    }
+
+	    void seek(int drive, uint8_t cylinder)
+	    {
+		cylinders[drive] = cylinder;
+		pending_st0.push_back(0x20 | drive);
+		raiseinterrupt();
+	    }
+
+	    // Only drive 0 has a disk in it
+	    bool isready(int drive)
+	    {
+		return ((drive == 0) && (disk.filedata != NULL));
+	    }
+
+	    void starttransfer(bool is_write)
+	    {
+		int drive = (command[1] & 3);
+		int head = ((command[1] >> 2) & 1);
+		int cylinder = command[2];
+		int sector = command[4];
+		int end_sector = command[6];
+		uint8_t st0 = ((head << 2) | drive);
+
+		if (!isready(drive))
+		{
+		    finishcommand((st0 | 0x48), 0x00, 0x00);
+		    return;
+		}
+
+		if ((sector == 0) || (sector > end_sector) || (end_sector > disk.numsectors) || (cylinder >= disk.numcylinders) || (head >= disk.numheads))
+		{
+		    finishcommand((st0 | 0x40), 0x04, 0x00);
+		    return;
+		}
+
+		if (is_write && disk.isreadonly())
+		{
+		    finishcommand((st0 | 0x40), 0x02, 0x00);
+		    return;
+		}
+
+		// Multi-track transfers carry on from head 0 into head 1 on the same cylinder
+		size_t num_sectors = size_t((end_sector - sector) + 1);
+
+		if (testbit(command[0], 7) && (head == 0) && (disk.numheads == 2))
+		{
+		    num_sectors += size_t(end_sector);
+		}
+
+		transfer_lba = disk.toLBA(cylinder, head, sector);
+		buffer.assign((num_sectors * 512), 0);
+
+		// Sectors are only ever touched by the disk I/O worker, so the controller waits for the read to finish there
+		if (!is_write)
+		{
+		    uint32_t lba = transfer_lba;
+		    uint8_t *data = buffer.data();
+
+		    disk_io.wait(disk_io.submit([this, lba, num_sectors, data]() -> size_t
+		    {
+			BeeSectorSpan sectors = disk.readSectors(lba, num_sectors);
+			memcpy(data, sectors.data, sectors.size);
+			return ((sectors.size + 511) / 512);
+		    }));
+		}
+
+		phase = Execution;
+
+		bool is_started = dma.request(2, buffer.data(), buffer.size(), cycles_per_byte, [this, is_write](size_t length, bool is_terminal_count)
+		{
+		    finishtransfer(is_write, length, is_terminal_count);
+		});
+
+		// Without DMA, the controller would overrun as soon as the first byte came off the disk
+		if (!is_started)
+		{
+		    finishcommand((st0 | 0x40), 0x10, 0x00);
+		}
+	    }
+
+	    void finishtransfer(bool is_write, size_t length, bool is_terminal_count)
+	    {
+		size_t num_sectors = (length / 512);
+
+		if (is_write && (num_sectors != 0))
+		{
+		    // The request holds on to the data until the worker has written it out
+		    auto data = make_shared<vector<uint8_t>>(buffer.begin(), (buffer.begin() + (num_sectors * 512)));
+		    uint32_t lba = transfer_lba;
+
+		    disk_io.submit([this, lba, num_sectors, data]() -> size_t
+		    {
+			return disk.writeSectors(lba, num_sectors, data->data());
+		    });
+		}
+
+		// The result points at the sector after the last one transferred
+		// (which is the start of the next cylinder once the end of the track's been reached)
+		uint8_t cylinder = command[2];
+		uint8_t head = command[3];
+		int sector = int(command[4] + num_sectors);
+		int end_sector = command[6];
+
+		if (testbit(command[0], 7) && (head == 0) && (sector > end_sector))
+		{
+		    head = 1;
+		    sector -= end_sector;
+		}
+
+		if (sector > end_sector)
+		{
+		    cylinder += 1;
+		    head = testbit(command[0], 7) ? 0 : head;
+		    sector = 1;
+		}
+
+		uint8_t st0 = (command[1] & 7);
+
+		// The PC's DMA controller stops the transfer with its terminal count,
+		// so running off the end of the track without one is an error
+		if (is_terminal_count)
+		{
+		    finishcommand(st0, 0x00, 0x00, cylinder, head, uint8_t(sector));
+		}
+		else
+		{
+		    finishcommand((st0 | 0x40), 0x80, 0x00, cylinder, head, uint8_t(sector));
+		}
+	    }
+
+	    void finishcommand(uint8_t st0, uint8_t st1, uint8_t st2)
+	    {
+		finishcommand(st0, st1, st2, command[2], command[3], command[4]);
+	    }
+
+	    void finishcommand(uint8_t st0, uint8_t st1, uint8_t st2, uint8_t cylinder, uint8_t head, uint8_t sector)
+	    {
+		setresult({st0, st1, st2, cylinder, head, sector, command[5]});
+		raiseinterrupt();
+	    }
+
+	    void setresult(initializer_list<uint8_t> values)
+	    {
+		copy(values.begin(), values.end(), result.begin());
+		result_pos = 0;
+		result_length = values.size();
+		phase = Result;
+	    }
+
+	    void raiseinterrupt()
+	    {
+		// The adapter only passes on interrupts with DMA and interrupts enabled
+		if (testbit(dor, 3))
+		{
+		    pic.raiseirq(6);
+		}
+	    }
+
+	    template<typename T>
+	    bool testbit(T reg, int bit)
+	    {
+		return ((reg >> bit) & 1) ? true : false;
+	    }
+    };
+}
+
+#endif // BEE8086_FDC
\ No newline at end of file
@@ -4,65 +4,144 @@
 #include <iostream>
 #include <vector>
 #include <cstdint>
+#include <algorithm>
+#include <memory>
+#include <Bee8086/blobstore.h>
+#include "beemappedfile.h"
+#include "beediskwriter.h"
+#include "beediskoverlay.h"
+using namespace bee8086;
 using namespace std;
 
+// Read-only view of a run of sectors in a disk image
+struct BeeSectorSpan
+{
+    const uint8_t *data = NULL;
+    size_t size = 0;
+
+    bool empty()
+    {
+	return (size == 0);
+    }
+};
+
 struct BeeFloppy
 {
-    vector<uint8_t> filedata;
+    // Sectors are read straight from the image, which is shared by every machine in the process
+    // (sectors that the guest has written are kept in the writer's map, and patched in over it)
+    Bee8086BlobRef image;
+    const uint8_t *filedata = NULL;
+    size_t filesize = 0;
     uint32_t fileoffs = 0;
 
+    // With "use_writeback" set, writes are kept in a map of dirty sectors, and written back to the file in the background
+    BeeDiskWriter writer;
+    bool use_writeback = false;
+
+    // Otherwise the image is never written to, and writes go to the overlay instead
+    // (which is kept in memory, unless openoverlay() puts it in a file)
+    BeeDiskOverlay overlay;
+    vector<uint8_t> overlay_buffer;
+    string image_name = "";
+
     int numcylinders = 0;
     int numheads = 0;
     int numsectors = 0;
 
-    void open(vector<uint8_t> data)
+    bool open(string filename)
     {
-	filedata = vector<uint8_t>(data.begin(), data.end());
+	// The image points straight into the mapped file, which it keeps open
+	auto file = make_shared<BeeMappedFile>();
+
+	if (!file->open(filename))
+	{
+	    return false;
+	}
+
+	image = Bee8086BlobStore::get().intern(file, file->data(), file->size(), file->getid());
+	filedata = image->data();
+	filesize = image->size();
+	fileoffs = 0;
+	image_name = filename;
+
+	if (use_writeback)
+	{
+	    writer.keep_written = true;
+	    writer.open(filename);
+	}
+	else
+	{
+	    overlay.open(uint32_t(filesize / 512), gethash());
+	}
 
 	numcylinders = 80;
 	numsectors = 18;
 	numheads = 2;
 
-	if (filedata.size() <= 1228800)
+	if (filesize <= 1228800)
 	{
 	    numsectors = 15;
 	}
 
-	if (filedata.size() <= 737280)
+	if (filesize <= 737280)
 	{
 	    numsectors = 9;
 	}
 
-	if (filedata.size() <= 368640)
+	if (filesize <= 368640)
 	{
 	    numcylinders = 40;
 	    numsectors = 9;
 	}
 
-	if (filedata.size() <= 163840)
+	if (filesize <= 163840)
 	{
 	    numcylinders = 40;
 	    numsectors = 8;
 	    numheads = 1;
 	}
+
+	return true;
+    }
+
+    // Reopens the overlay for the image in "filename" (or in memory if that's empty)
+    bool openoverlay(string filename = "")
+    {
+	if (!overlay.open(uint32_t(filesize / 512), gethash(), filename))
+	{
+	    close();
+	    return false;
+	}
+
+	return true;
+    }
+
+    // Fetches the hash of the image's blob, which identifies the image's contents
+    uint64_t gethash()
+    {
+	return image ? image->hash() : 0;
     }
 
     void close()
     {
-	filedata.clear();
+	overlay.close();
+	writer.close();
+	image.reset();
+	filedata = NULL;
+	filesize = 0;
+	fileoffs = 0;
 	numcylinders = 0;
 	numsectors = 0;
 	numheads = 0;
+	image_name = "";
     }
 
     bool seek(int cylinder_num, int head_num, int sector_num)
     {
 	uint32_t lba = toLBA(cylinder_num, head_num, sector_num);
-	cout << "LBA is " << dec << lba << endl;
-
 	uint32_t offset = (lba * 512);
 
-	if (offset >= filedata.size())
+	if (offset >= filesize)
 	{
 	    return false;
 	}
@@ -71,29 +150,137 @@ struct BeeFloppy
 	return true;
     }
 
-    vector<uint8_t> readSector()
+    // Returns true if the sector at "lba" is (at least partly) inside the image
+    bool isvalid(uint32_t lba)
     {
-	vector<uint8_t> result;
-	if (fileoffs >= filedata.size())
+	return ((uint64_t(lba) * 512) < filesize);
+    }
+
+    // Fetches up to "count" sectors starting at "lba" straight from the image
+    // (the span is cut short at the end of the image, and is empty if "lba" is past it)
+    BeeSectorSpan readSectors(uint32_t lba, size_t count)
+    {
+	BeeSectorSpan span;
+
+	if (!isvalid(lba))
 	{
-	    return result;
+	    return span;
 	}
 
-	if ((fileoffs + 512) > filedata.size())
+	size_t offset = (size_t(lba) * 512);
+	span.data = (filedata + offset);
+	span.size = min<size_t>((count * 512), (filesize - offset));
+
+	// Sectors that have been written (or changed in the overlay) are patched into a copy of the run
+	if (writer.intersects(lba, count) || overlay.intersects(lba, count))
 	{
-	    size_t actualSize = (filedata.size() - fileoffs);
-	    result.resize(actualSize, 0);
+	    overlay_buffer.assign(span.data, (span.data + span.size));
+	    writer.apply(lba, overlay_buffer.data(), (span.size / 512));
+	    overlay.apply(lba, overlay_buffer.data(), (span.size / 512));
+	    span.data = overlay_buffer.data();
+	}
+
+	return span;
+    }
+
+    // Writes up to "count" whole sectors from "data" starting at "lba", and returns the number of sectors written
+    // (which is zero if the image is read-only)
+    size_t writeSectors(uint32_t lba, size_t count, const uint8_t *data)
+    {
+	if (isreadonly())
+	{
+	    return 0;
+	}
+
+	size_t num_written = 0;
+
+	while ((num_written < count) && (((uint64_t(lba) + num_written + 1) * 512) <= filesize))
+	{
+	    num_written += 1;
+	}
+
+	if (num_written == 0)
+	{
+	    return 0;
+	}
+
+	if (overlay.isopen())
+	{
+	    overlay.write(lba, data, num_written);
 	}
 	else
 	{
-	    result.resize(512, 0);
+	    writeimage(lba, data, num_written);
 	}
 
-	for (size_t index = 0; index < result.size(); index++)
+	return num_written;
+    }
+
+    bool isreadonly()
+    {
+	return (!writer.isopen() && !overlay.isopen());
+    }
+
+    // Waits until every write so far has reached the image (or the overlay file)
+    void sync()
+    {
+	writer.sync();
+	overlay.sync();
+    }
+
+    // Writes every sector in the overlay into the image, and then empties the overlay
+    bool commit()
+    {
+	if (!overlay.isopen() || (overlay.getcount() == 0))
 	{
-	    result[index] = filedata.at(fileoffs++);
+	    return true;
+	}
+
+	writer.keep_written = true;
+
+	if (!writer.open(image_name))
+	{
+	    return false;
+	}
+
+	overlay.foreach([&](uint32_t lba, const uint8_t *data)
+	{
+	    writeimage(lba, data, 1);
+	});
+
+	writer.close();
+	overlay.discard();
+	return true;
+    }
+
+    // Throws away every change in the overlay
+    void discard()
+    {
+	if (overlay.isopen())
+	{
+	    overlay.discard();
+	}
+    }
+
+    // Adds sectors to the map of dirty sectors, which the writer writes back to the file in the background
+    void writeimage(uint32_t lba, const uint8_t *data, size_t count)
+    {
+	writer.write(lba, data, count);
+    }
+
+    vector<uint8_t> readSector()
+    {
+	vector<uint8_t> result;
+	if (fileoffs >= filesize)
+	{
+	    return result;
 	}
 
+	size_t actualSize = min<size_t>(512, (filesize - fileoffs));
+	result.assign((filedata + fileoffs), (filedata + fileoffs + actualSize));
+	writer.apply((fileoffs / 512), result.data(), (actualSize / 512));
+	overlay.apply((fileoffs / 512), result.data(), (actualSize / 512));
+	fileoffs += actualSize;
 	return result;
     }
 
@@ -0,0 +1,56 @@
+#ifndef BEEGLYPH_H
+#define BEEGLYPH_H
+
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define BEEGLYPH_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// Expands a row of a 1-bpp glyph into 32-bpp pixels
+//
+// "line" holds "width" (8 or 9) pixels with the leftmost pixel in the highest bit,
+// and each set bit becomes "foreground" while each clear bit becomes "background"
+//
+// The first 8 pixels are expanded together (in one AVX2 register or two SSE2 registers)
+// by comparing a copy of the row against the bit for each pixel,
+// and then using the result to flip the background into the foreground
+inline void expandglyphrow(uint32_t line, int width, uint32_t foreground, uint32_t background, uint32_t *dst)
+{
+    uint32_t bits = (line >> (width - 8));
+
+#if defined(__AVX2__)
+    const __m256i pixel_bits = _mm256_setr_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+    __m256i select = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(bits), pixel_bits), pixel_bits);
+    __m256i flip = _mm256_set1_epi32(foreground ^ background);
+    __m256i pixels = _mm256_xor_si256(_mm256_set1_epi32(background), _mm256_and_si256(select, flip));
+    _mm256_storeu_si256((__m256i*)dst, pixels);
+#elif defined(BEEGLYPH_SSE2)
+    const __m128i left_bits = _mm_setr_epi32(0x80, 0x40, 0x20, 0x10);
+    const __m128i right_bits = _mm_setr_epi32(0x08, 0x04, 0x02, 0x01);
+    __m128i row = _mm_set1_epi32(bits);
+    __m128i flip = _mm_set1_epi32(foreground ^ background);
+    __m128i back = _mm_set1_epi32(background);
+    __m128i left_select = _mm_cmpeq_epi32(_mm_and_si128(row, left_bits), left_bits);
+    __m128i right_select = _mm_cmpeq_epi32(_mm_and_si128(row, right_bits), right_bits);
+    _mm_storeu_si128((__m128i*)dst, _mm_xor_si128(back, _mm_and_si128(left_select, flip)));
+    _mm_storeu_si128((__m128i*)(dst + 4), _mm_xor_si128(back, _mm_and_si128(right_select, flip)));
+#else
+    for (int x = 0; x < 8; x++)
+    {
+	dst[x] = ((bits >> (7 - x)) & 1) ? foreground : background;
+    }
+#endif
+
+    if (width > 8)
+    {
+	dst[8] = (line & 1) ? foreground : background;
+    }
+}
+
+#endif // BEEGLYPH_H
\ No newline at end of file
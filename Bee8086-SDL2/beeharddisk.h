@@ -0,0 +1,513 @@
+#ifndef BEEHARDDISK_H
+#define BEEHARDDISK_H
+
+#include <iostream>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include "beedisk.h"
+#include "beediskwriter.h"
+#include "beediskoverlay.h"
+#include "beemappedfile.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Fixed disk that streams sectors from an image of any size
+//
+// Sectors are read a track at a time with positional reads into an LRU track cache,
+// and sequential access reads a few tracks ahead in a single request
+//
+// The geometry comes from the footer of a fixed VHD image if there is one,
+// and is worked out from the size of the image otherwise
+//
+// With "use_writeback" set, writes go through a BeeDiskWriter (and are patched into any cached tracks),
+// so the emulation never waits for them to reach the image
+//
+// Otherwise the image is never written to, and writes go to a BeeDiskOverlay instead
+// (which is kept in memory, unless openoverlay() puts it in a file)
+class BeeHardDisk : public BeeDisk
+{
+    public:
+	BeeHardDisk()
+	{
+
+	}
+
+	~BeeHardDisk()
+	{
+	    close();
+	}
+
+	BeeHardDisk(const BeeHardDisk&) = delete;
+	BeeHardDisk &operator=(const BeeHardDisk&) = delete;
+
+	bool open(string filename)
+	{
+	    close();
+
+	    uint64_t file_size = 0;
+
+	    if (!openfile(filename, file_size))
+	    {
+		cout << "Error: could not load " << filename << endl;
+		return false;
+	    }
+
+	    disk_size = file_size;
+
+	    if (!readvhdfooter(file_size))
+	    {
+		guessgeometry();
+	    }
+
+	    if ((disk_size < 512) || (numcylinders == 0))
+	    {
+		cout << "Error: " << filename << " is too small to be a hard disk image" << endl;
+		close();
+		return false;
+	    }
+
+	    num_disk_sectors = (disk_size / 512);
+	    track_size = (numsectors * 512);
+	    max_tracks = max<size_t>((cache_size / track_size), (readahead_tracks + 1));
+	    image_name = filename;
+	    image_hash = BeeMappedFile::getfileid(filename);
+
+	    if (use_writeback)
+	    {
+		writer.open(filename);
+	    }
+	    else
+	    {
+		overlay.open(uint32_t(num_disk_sectors), image_hash);
+	    }
+
+	    cout << filename << " succesfully loaded (" << dec << numcylinders << " cylinders, ";
+	    cout << numheads << " heads, " << numsectors << " sectors per track)." << endl;
+	    return true;
+	}
+
+	// Reopens the overlay for the image in "filename" (or in memory if that's empty)
+	bool openoverlay(string filename = "")
+	{
+	    if (!overlay.open(uint32_t(num_disk_sectors), image_hash, filename))
+	    {
+		close();
+		return false;
+	    }
+
+	    return true;
+	}
+
+	// Fetches the hash of the image (of its identity, the same way as a mapped image's blob)
+	uint64_t gethash()
+	{
+	    return image_hash;
+	}
+
+	void close() override
+	{
+	    overlay.close();
+	    writer.close();
+	    closefile();
+	    tracks.clear();
+	    track_map.clear();
+	    disk_size = 0;
+	    num_disk_sectors = 0;
+	    numcylinders = 0;
+	    numheads = 0;
+	    numsectors = 0;
+	    last_track = UINT32_MAX;
+	    image_name = "";
+	    image_hash = 0;
+	}
+
+	bool isopen() override
+	{
+	    return (num_disk_sectors != 0);
+	}
+
+	uint64_t getsectorcount() override
+	{
+	    return num_disk_sectors;
+	}
+
+	// Reads up to "count" sectors starting at "lba" into "data" (cutting the read short at the end of the disk),
+	// and returns the number of sectors read
+	size_t readSectors(uint32_t lba, size_t count, uint8_t *data) override
+	{
+	    size_t num_read = 0;
+
+	    while ((num_read < count) && isvalid(lba + num_read))
+	    {
+		uint32_t sector = (lba + num_read);
+		uint32_t track_num = (sector / numsectors);
+		uint32_t track_offs = (sector % numsectors);
+
+		const vector<uint8_t> *track = gettrack(track_num);
+
+		if (track == NULL)
+		{
+		    break;
+		}
+
+		size_t num_track_sectors = (track->size() / 512);
+
+		if (track_offs >= num_track_sectors)
+		{
+		    break;
+		}
+
+		size_t length = min<size_t>((count - num_read), (num_track_sectors - track_offs));
+		memcpy((data + (num_read * 512)), (track->data() + (track_offs * 512)), (length * 512));
+		num_read += length;
+	    }
+
+	    return num_read;
+	}
+
+	// Writes up to "count" sectors from "data" starting at "lba", and returns the number of sectors written
+	// (which is zero if the image is read-only)
+	size_t writeSectors(uint32_t lba, size_t count, const uint8_t *data) override
+	{
+	    if (isreadonly())
+	    {
+		return 0;
+	    }
+
+	    size_t num_written = 0;
+
+	    while ((num_written < count) && isvalid(lba + num_written))
+	    {
+		uint32_t sector = (lba + num_written);
+		auto it = track_map.find(sector / numsectors);
+
+		if (it != track_map.end())
+		{
+		    vector<uint8_t> &track = it->second->data;
+		    size_t offs = (size_t(sector % numsectors) * 512);
+
+		    if ((offs + 512) <= track.size())
+		    {
+			memcpy(&track[offs], (data + (num_written * 512)), 512);
+		    }
+		}
+
+		num_written += 1;
+	    }
+
+	    if (overlay.isopen())
+	    {
+		overlay.write(lba, data, num_written);
+	    }
+	    else
+	    {
+		writer.write(lba, data, num_written);
+	    }
+
+	    return num_written;
+	}
+
+	bool isreadonly() override
+	{
+	    return (!writer.isopen() && !overlay.isopen());
+	}
+
+	// Waits until every write so far has reached the image (or the overlay file)
+	void sync() override
+	{
+	    writer.sync();
+	    overlay.sync();
+	}
+
+	// Writes every sector in the overlay into the image, and then empties the overlay
+	bool commit() override
+	{
+	    if (!overlay.isopen() || (overlay.getcount() == 0))
+	    {
+		return true;
+	    }
+
+	    if (!writer.open(image_name))
+	    {
+		return false;
+	    }
+
+	    overlay.foreach([&](uint32_t lba, const uint8_t *data)
+	    {
+		writer.write(lba, data, 1);
+	    });
+
+	    writer.close();
+	    overlay.discard();
+	    return true;
+	}
+
+	// Throws away every change in the overlay
+	void discard()
+	{
+	    if (!overlay.isopen())
+	    {
+		return;
+	    }
+
+	    overlay.discard();
+
+	    // The cached tracks have the overlay's sectors patched into them
+	    tracks.clear();
+	    track_map.clear();
+	    last_track = UINT32_MAX;
+	}
+
+	size_t getoverlaycount()
+	{
+	    return overlay.getcount();
+	}
+
+	// Size of the track cache (in bytes), and how many tracks to read ahead on sequential access
+	size_t cache_size = (4 * 1024 * 1024);
+	size_t readahead_tracks = 4;
+
+	bool use_writeback = false;
+
+    private:
+	struct Track
+	{
+	    uint32_t track_num = 0;
+	    vector<uint8_t> data;
+	};
+
+	BeeDiskWriter writer;
+	BeeDiskOverlay overlay;
+	string image_name = "";
+	uint64_t image_hash = 0;
+
+	uint64_t disk_size = 0;
+	uint64_t num_disk_sectors = 0;
+	size_t track_size = 0;
+	size_t max_tracks = 0;
+
+	// Most recently used tracks are at the front
+	list<Track> tracks;
+	unordered_map<uint32_t, list<Track>::iterator> track_map;
+	uint32_t last_track = UINT32_MAX;
+
+	const vector<uint8_t> *gettrack(uint32_t track_num)
+	{
+	    auto it = track_map.find(track_num);
+
+	    if (it != track_map.end())
+	    {
+		tracks.splice(tracks.begin(), tracks, it->second);
+		last_track = track_num;
+		return &tracks.front().data;
+	    }
+
+	    // Read ahead if the guest is reading through the disk in order
+	    bool is_sequential = ((last_track != UINT32_MAX) && (track_num == (last_track + 1)));
+	    size_t num_tracks = is_sequential ? (readahead_tracks + 1) : 1;
+	    uint64_t offset = (uint64_t(track_num) * track_size);
+	    size_t length = size_t(min<uint64_t>((num_tracks * track_size), (disk_size - offset)));
+
+	    vector<uint8_t> buffer(length);
+	    uint32_t first_sector = (track_num * numsectors);
+
+	    // Sectors that are still waiting to be written out are newer than what's in the image
+	    if (!writer.readthrough(first_sector, buffer.data(), (length / 512), [&]() { return readat(offset, buffer.data(), length); }))
+	    {
+		cout << "Error: could not read from hard disk image" << endl;
+		return NULL;
+	    }
+
+	    overlay.apply(first_sector, buffer.data(), (length / 512));
+
+	    // Insert the read-ahead tracks first, so that the requested one ends up most recently used
+	    for (size_t index = ((length + track_size - 1) / track_size); index-- > 0;)
+	    {
+		uint32_t num = (track_num + index);
+
+		if (track_map.count(num) != 0)
+		{
+		    continue;
+		}
+
+		size_t start = (index * track_size);
+		size_t end = min<size_t>((start + track_size), length);
+
+		Track track;
+		track.track_num = num;
+		track.data.assign((buffer.begin() + start), (buffer.begin() + end));
+		tracks.push_front(move(track));
+		track_map[num] = tracks.begin();
+	    }
+
+	    while (tracks.size() > max_tracks)
+	    {
+		track_map.erase(tracks.back().track_num);
+		tracks.pop_back();
+	    }
+
+	    last_track = track_num;
+	    return &tracks.front().data;
+	}
+
+	// Fixed VHD images end with a 512-byte footer that holds the disk's geometry
+	bool readvhdfooter(uint64_t file_size)
+	{
+	    if (file_size < 1024)
+	    {
+		return false;
+	    }
+
+	    uint8_t footer[512];
+
+	    if (!readat((file_size - 512), footer, 512) || (memcmp(footer, "conectix", 8) != 0))
+	    {
+		return false;
+	    }
+
+	    uint32_t disk_type = ((footer[0x3C] << 24) | (footer[0x3D] << 16) | (footer[0x3E] << 8) | footer[0x3F]);
+
+	    if (disk_type != 2)
+	    {
+		cout << "Warning: only fixed VHD images are supported" << endl;
+		return false;
+	    }
+
+	    disk_size = (file_size - 512);
+	    numcylinders = ((footer[0x38] << 8) | footer[0x39]);
+	    numheads = footer[0x3A];
+	    numsectors = footer[0x3B];
+	    return ((numheads != 0) && (numsectors != 0));
+	}
+
+	// Uses the usual translation for raw images (63 sectors per track, with 16 heads
+	// up to 504 MB and 255 heads beyond that), capped to what INT 13h can address
+	void guessgeometry()
+	{
+	    numsectors = 63;
+	    numheads = ((disk_size / 512) > (1024 * 16 * 63)) ? 255 : 16;
+	    numcylinders = int(min<uint64_t>(((disk_size / 512) / (numheads * numsectors)), 1024));
+
+	    // Very small images don't fill a single cylinder
+	    if (numcylinders == 0)
+	    {
+		numheads = 1;
+		numsectors = int(min<uint64_t>((disk_size / 512), 63));
+		numcylinders = (numsectors != 0) ? 1 : 0;
+	    }
+	}
+
+#ifdef _WIN32
+	HANDLE file_handle = INVALID_HANDLE_VALUE;
+
+	bool openfile(string filename, uint64_t &file_size)
+	{
+	    // The image is shared for writing, so that the BeeDiskWriter can open it as well
+	    file_handle = CreateFileA(filename.c_str(), GENERIC_READ, (FILE_SHARE_READ | FILE_SHARE_WRITE), NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+
+	    if (file_handle == INVALID_HANDLE_VALUE)
+	    {
+		return false;
+	    }
+
+	    LARGE_INTEGER size;
+
+	    if (!GetFileSizeEx(file_handle, &size))
+	    {
+		closefile();
+		return false;
+	    }
+
+	    file_size = uint64_t(size.QuadPart);
+	    return true;
+	}
+
+	void closefile()
+	{
+	    if (file_handle != INVALID_HANDLE_VALUE)
+	    {
+		CloseHandle(file_handle);
+		file_handle = INVALID_HANDLE_VALUE;
+	    }
+	}
+
+	bool readat(uint64_t offset, uint8_t *data, size_t size)
+	{
+	    OVERLAPPED overlapped = {};
+	    overlapped.Offset = DWORD(offset & 0xFFFFFFFF);
+	    overlapped.OffsetHigh = DWORD(offset >> 32);
+
+	    DWORD num_read = 0;
+	    return (ReadFile(file_handle, data, DWORD(size), &num_read, &overlapped) && (num_read == size));
+	}
+#else
+	int file_fd = -1;
+
+	bool openfile(string filename, uint64_t &file_size)
+	{
+	    file_fd = ::open(filename.c_str(), O_RDONLY);
+
+	    if (file_fd < 0)
+	    {
+		return false;
+	    }
+
+	    struct stat file_stat;
+
+	    if ((fstat(file_fd, &file_stat) < 0) || !S_ISREG(file_stat.st_mode))
+	    {
+		closefile();
+		return false;
+	    }
+
+	    file_size = uint64_t(file_stat.st_size);
+	    return true;
+	}
+
+	void closefile()
+	{
+	    if (file_fd >= 0)
+	    {
+		::close(file_fd);
+		file_fd = -1;
+	    }
+	}
+
+	bool readat(uint64_t offset, uint8_t *data, size_t size)
+	{
+	    size_t num_read = 0;
+
+	    while (num_read < size)
+	    {
+		ssize_t result = pread(file_fd, (data + num_read), (size - num_read), off_t(offset + num_read));
+
+		if (result <= 0)
+		{
+		    return false;
+		}
+
+		num_read += size_t(result);
+	    }
+
+	    return true;
+	}
+#endif
+};
+
+#endif // BEEHARDDISK_H
\ No newline at end of file
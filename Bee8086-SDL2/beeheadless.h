@@ -0,0 +1,172 @@
+#ifndef BEEHEADLESS_H
+#define BEEHEADLESS_H
+
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+
+// Video output kept in memory instead of being shown in a window (i.e. for automated test runs)
+//
+// Frames are kept as 8-bit RGBA pixels, and each frame gets a 64-bit hash that can be compared against a known screen,
+// which is built from a hash of each row so only the rows that changed have to be hashed again
+class BeeHeadless
+{
+    public:
+	BeeHeadless()
+	{
+
+	}
+
+	~BeeHeadless()
+	{
+
+	}
+
+	void resize(int w, int h)
+	{
+	    width = w;
+	    height = h;
+	    pixels.assign((width * height * 4), 0);
+	    row_hashes.assign(height, hashrow(pixels.data()));
+	    frame_hash = combinerows();
+	    last_hash = frame_hash;
+	}
+
+	// Copies "count" rows starting at "top" from "framebuffer" (in ARGB8888 format), and updates the frame hash
+	void update(const uint32_t *framebuffer, int top, int count)
+	{
+	    for (int y = top; y < (top + count); y++)
+	    {
+		const uint32_t *src = &framebuffer[(y * width)];
+		uint8_t *dst = &pixels[((y * width) * 4)];
+
+		for (int x = 0; x < width; x++)
+		{
+		    uint32_t color = src[x];
+		    dst[0] = ((color >> 16) & 0xFF);
+		    dst[1] = ((color >> 8) & 0xFF);
+		    dst[2] = (color & 0xFF);
+		    dst[3] = (color >> 24);
+		    dst += 4;
+		}
+
+		row_hashes[y] = hashrow(&pixels[((y * width) * 4)]);
+	    }
+
+	    frame_hash = combinerows();
+	}
+
+	// Marks the end of a frame (whether or not anything was drawn)
+	void endframe()
+	{
+	    is_repeat = (frame_hash == last_hash);
+	    last_hash = frame_hash;
+	    frame_count += 1;
+	}
+
+	// Pixels of the current frame, in RGBA order
+	const uint8_t *getpixels()
+	{
+	    return pixels.data();
+	}
+
+	int getwidth()
+	{
+	    return width;
+	}
+
+	int getheight()
+	{
+	    return height;
+	}
+
+	uint64_t gethash()
+	{
+	    return frame_hash;
+	}
+
+	// Returns true if the last frame was identical to the one before it
+	bool isrepeat()
+	{
+	    return is_repeat;
+	}
+
+	uint64_t getframecount()
+	{
+	    return frame_count;
+	}
+
+    private:
+	int width = 0;
+	int height = 0;
+	vector<uint8_t> pixels;
+	vector<uint64_t> row_hashes;
+	uint64_t frame_hash = 0;
+	uint64_t last_hash = 0;
+	uint64_t frame_count = 0;
+	bool is_repeat = false;
+
+	static constexpr uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+	static constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+
+	uint64_t rotl(uint64_t val, int shift)
+	{
+	    return ((val << shift) | (val >> (64 - shift)));
+	}
+
+	// Final mix from MurmurHash3, so every input bit affects every output bit
+	uint64_t avalanche(uint64_t hash)
+	{
+	    hash ^= (hash >> 33);
+	    hash *= 0xFF51AFD7ED558CCDULL;
+	    hash ^= (hash >> 33);
+	    hash *= 0xC4CEB9FE1A85EC53ULL;
+	    hash ^= (hash >> 33);
+	    return hash;
+	}
+
+	// Hashes a row 8 bytes at a time (rows are always a multiple of 2 pixels wide),
+	// with four independent lanes so the multiplies can overlap
+	uint64_t hashrow(const uint8_t *data)
+	{
+	    size_t num_words = ((width * 4) / 8);
+	    uint64_t lanes[4] = {prime1, prime2, ~prime1, ~prime2};
+	    size_t index = 0;
+
+	    for (; (index + 4) <= num_words; index += 4)
+	    {
+		for (int lane = 0; lane < 4; lane++)
+		{
+		    uint64_t word = 0;
+		    memcpy(&word, (data + ((index + lane) * 8)), 8);
+		    lanes[lane] = (rotl((lanes[lane] + (word * prime2)), 31) * prime1);
+		}
+	    }
+
+	    for (; index < num_words; index++)
+	    {
+		uint64_t word = 0;
+		memcpy(&word, (data + (index * 8)), 8);
+		lanes[0] = (rotl((lanes[0] + (word * prime2)), 31) * prime1);
+	    }
+
+	    uint64_t hash = (rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18));
+	    return avalanche(hash + (width * 4));
+	}
+
+	uint64_t combinerows()
+	{
+	    uint64_t hash = (prime1 ^ uint64_t(height));
+
+	    for (uint64_t row_hash : row_hashes)
+	    {
+		hash = (rotl((hash ^ row_hash), 27) * prime2);
+	    }
+
+	    return avalanche(hash);
+	}
+};
+
+#endif // BEEHEADLESS_H
\ No newline at end of file
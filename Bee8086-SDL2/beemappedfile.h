@@ -0,0 +1,261 @@
+#ifndef BEEMAPPEDFILE_H
+#define BEEMAPPEDFILE_H
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Read-only view of a whole file
+//
+// The file is memory-mapped where possible, so its pages are only read in when they're
+// touched and are shared with every other process that maps the same file,
+// and is read into memory otherwise
+class BeeMappedFile
+{
+    public:
+	BeeMappedFile()
+	{
+
+	}
+
+	~BeeMappedFile()
+	{
+	    close();
+	}
+
+	BeeMappedFile(const BeeMappedFile&) = delete;
+	BeeMappedFile &operator=(const BeeMappedFile&) = delete;
+
+	bool open(string filename)
+	{
+	    close();
+
+	    if (!map(filename) && !read(filename))
+	    {
+		cout << "Error: could not load " << filename << endl;
+		return false;
+	    }
+
+	    file_id = getfileid(filename);
+	    cout << filename << " succesfully loaded." << endl;
+	    return true;
+	}
+
+	void close()
+	{
+	    if (is_mapped)
+	    {
+#ifdef _WIN32
+		UnmapViewOfFile(file_data);
+		CloseHandle(mapping_handle);
+		CloseHandle(file_handle);
+		mapping_handle = NULL;
+		file_handle = INVALID_HANDLE_VALUE;
+#else
+		munmap(const_cast<uint8_t*>(file_data), file_size);
+#endif
+	    }
+
+	    file_buffer.clear();
+	    file_buffer.shrink_to_fit();
+	    file_data = NULL;
+	    file_size = 0;
+	    file_id = 0;
+	    is_mapped = false;
+	}
+
+	const uint8_t *data()
+	{
+	    return file_data;
+	}
+
+	size_t size()
+	{
+	    return file_size;
+	}
+
+	bool isopen()
+	{
+	    return (file_data != NULL);
+	}
+
+	// Returns true if the file is memory-mapped (instead of having been read into memory)
+	bool ismapped()
+	{
+	    return is_mapped;
+	}
+
+	// Fetches a hash of the file's identity (its name, location on disk, size and modification time),
+	// which changes whenever the file is replaced or modified
+	uint64_t getid()
+	{
+	    return file_id;
+	}
+
+	// Hashes the identity of "filename" (with 64-bit FNV-1a), the same way as getid()
+	static uint64_t getfileid(string filename)
+	{
+	    uint64_t fields[4] = {0, 0, 0, 0};
+	    struct stat file_stat;
+
+	    if (stat(filename.c_str(), &file_stat) == 0)
+	    {
+		fields[0] = uint64_t(file_stat.st_dev);
+		fields[1] = uint64_t(file_stat.st_ino);
+		fields[2] = uint64_t(file_stat.st_size);
+		fields[3] = uint64_t(file_stat.st_mtime);
+	    }
+
+	    uint64_t hash = 0xCBF29CE484222325ULL;
+
+	    for (char ch : filename)
+	    {
+		hash = ((hash ^ uint8_t(ch)) * 0x100000001B3ULL);
+	    }
+
+	    for (uint64_t field : fields)
+	    {
+		for (int index = 0; index < 8; index++)
+		{
+		    hash = ((hash ^ ((field >> (index * 8)) & 0xFF)) * 0x100000001B3ULL);
+		}
+	    }
+
+	    return hash;
+	}
+
+    private:
+	const uint8_t *file_data = NULL;
+	size_t file_size = 0;
+	uint64_t file_id = 0;
+	bool is_mapped = false;
+	vector<uint8_t> file_buffer;
+
+#ifdef _WIN32
+	HANDLE file_handle = INVALID_HANDLE_VALUE;
+	HANDLE mapping_handle = NULL;
+
+	bool map(string filename)
+	{
+	    // The file is shared for writing, so that disk images can be written back while they're mapped
+	    file_handle = CreateFileA(filename.c_str(), GENERIC_READ, (FILE_SHARE_READ | FILE_SHARE_WRITE), NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	    if (file_handle == INVALID_HANDLE_VALUE)
+	    {
+		return false;
+	    }
+
+	    LARGE_INTEGER size;
+
+	    if (!GetFileSizeEx(file_handle, &size) || (size.QuadPart == 0))
+	    {
+		CloseHandle(file_handle);
+		file_handle = INVALID_HANDLE_VALUE;
+		return false;
+	    }
+
+	    mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+	    if (mapping_handle == NULL)
+	    {
+		CloseHandle(file_handle);
+		file_handle = INVALID_HANDLE_VALUE;
+		return false;
+	    }
+
+	    void *view = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+
+	    if (view == NULL)
+	    {
+		CloseHandle(mapping_handle);
+		CloseHandle(file_handle);
+		mapping_handle = NULL;
+		file_handle = INVALID_HANDLE_VALUE;
+		return false;
+	    }
+
+	    file_data = (const uint8_t*)view;
+	    file_size = size_t(size.QuadPart);
+	    is_mapped = true;
+	    return true;
+	}
+#else
+	bool map(string filename)
+	{
+	    int fd = ::open(filename.c_str(), O_RDONLY);
+
+	    if (fd < 0)
+	    {
+		return false;
+	    }
+
+	    struct stat file_stat;
+
+	    if ((fstat(fd, &file_stat) < 0) || !S_ISREG(file_stat.st_mode) || (file_stat.st_size == 0))
+	    {
+		::close(fd);
+		return false;
+	    }
+
+	    void *view = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	    // The mapping stays valid after the file is closed
+	    ::close(fd);
+
+	    if (view == MAP_FAILED)
+	    {
+		return false;
+	    }
+
+	    file_data = (const uint8_t*)view;
+	    file_size = size_t(file_stat.st_size);
+	    is_mapped = true;
+	    return true;
+	}
+#endif
+
+	bool read(string filename)
+	{
+	    ifstream file(filename.c_str(), ios::in | ios::binary | ios::ate);
+
+	    if (!file.is_open())
+	    {
+		return false;
+	    }
+
+	    streampos size = file.tellg();
+
+	    if (size <= 0)
+	    {
+		return false;
+	    }
+
+	    file_buffer.resize(size, 0);
+	    file.seekg(0, ios::beg);
+	    file.read((char*)file_buffer.data(), size);
+	    file.close();
+
+	    file_data = file_buffer.data();
+	    file_size = file_buffer.size();
+	    return true;
+	}
+};
+
+#endif // BEEMAPPEDFILE_H
\ No newline at end of file
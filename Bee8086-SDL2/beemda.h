@@ -2,17 +2,35 @@
 #define BEE8086_MDA
 
 #include <iostream>
+#include <array>
+#include <vector>
+#include <algorithm>
 #include <cstdint>
+#include <Bee8086/memorymap.h>
+#include "beevideo.h"
+#include "beeglyph.h"
+#include "beecrtc.h"
+using namespace bee8086;
+using namespace beecrtc;
 using namespace std;
 
 namespace beemda
 {
-    class BeeMDA
+    // IBM Monochrome Display Adapter (80x25 text mode, with 9x14 character cells)
+    //
+    // Each character is drawn from a copy of its glyph that's been expanded ahead of time
+    // to the full 9 columns (with and without an underline), which is then colored in a row at a time,
+    // and only the cells whose character or appearance has changed since the last frame are redrawn
+    class BeeMDA : public BeeVideo
     {
 	public:
-	    BeeMDA()
-	    {
+	    static constexpr int width = 720;
+	    static constexpr int height = 350;
 
+	    BeeMDA(Bee8086MemoryMap &memory, Bee8086Scheduler &sched, const array<uint8_t, 0x2000> &font) : memory_map(memory), crtc(sched, dot_clock, cell_width, crtc_defaults), font_rom(font)
+	    {
+		expandglyphs();
+		reset();
 	    }
 
 	    ~BeeMDA()
@@ -20,14 +38,69 @@ namespace beemda
 
 	    }
 
+	    void reset()
+	    {
+		framebuffer.fill(palette[0]);
+		cells.fill(0xFFFF);
+		frame_count = 0;
+		is_blink_enabled = false;
+		is_video_enabled = false;
+		is_redraw = true;
+	    }
+
+	    void start(Callback func)
+	    {
+		crtc.start(func);
+	    }
+
 	    void writeReg(uint8_t data)
 	    {
-		crtc_reg = (data & 0x1F);
+		crtc.selectReg(data);
 	    }
 
 	    void writeData(uint8_t data)
 	    {
-		cout << "Writing value of " << hex << int(data) << " to MDA register of " << dec << int(crtc_reg) << endl; 
+		crtc.writeData(data);
+
+		// The cursor position and start address are picked up by comparing each cell,
+		// but the rest change how every cell is drawn
+		switch (crtc.getselected())
+		{
+		    case BeeCRTC::StartAddrHigh:
+		    case BeeCRTC::StartAddrLow:
+		    case BeeCRTC::CursorAddrHigh:
+		    case BeeCRTC::CursorAddrLow: is_redraw = true; break;
+		    default:
+		    {
+			cells.fill(0xFFFF);
+			is_redraw = true;
+		    }
+		    break;
+		}
+	    }
+
+	    uint8_t readData()
+	    {
+		return crtc.readData();
+	    }
+
+	    // Bit 0 is set during horizontal sync, and bit 3 is set during vertical retrace
+	    // (the unused upper bits read as 1)
+	    uint8_t readStatus()
+	    {
+		uint8_t status = 0xF0;
+
+		if (crtc.ishsync())
+		{
+		    status |= 0x01;
+		}
+
+		if (crtc.isvsync())
+		{
+		    status |= 0x08;
+		}
+
+		return status;
 	    }
 
 	    void writeControl(uint8_t data)
@@ -40,10 +113,97 @@ namespace beemda
 
 		is_blink_enabled = testbit(data, 5);
 		is_video_enabled = testbit(data, 3);
+		is_redraw = true;
+	    }
+
+	    bool renderframe()
+	    {
+		// Characters blink at 1/32 of the frame rate, and the cursor blinks at 1/16
+		int blink_phase = (frame_count & 0x18);
+		bool is_blink_phase = ((blink_phase & 0x10) == 0);
+		bool is_cursor_phase = ((blink_phase & 0x08) == 0);
+		frame_count += 1;
+
+		bool is_vram_dirty = memory_map.fetchdirty(vram_addr, vram_size);
+
+		if (!is_vram_dirty && !is_redraw && (blink_phase == last_blink_phase))
+		{
+		    return false;
+		}
+
+		is_redraw = false;
+		last_blink_phase = blink_phase;
+		memory_map.readBlock(vram_addr, text.data(), vram_size);
+
+		// The CRTC can display fewer (but not more) rows and columns than fit in the window
+		int num_cols = min(crtc.getcolumns(), int(cols));
+		int num_rows = min(crtc.getrows(), int(rows));
+		int start_addr = crtc.getstartaddr();
+		int cursor_addr = crtc.getcursoraddr();
+		int cursor_mode = crtc.getcursormode();
+		bool is_cursor_shown = (cursor_mode == 0) || ((cursor_mode != 1) && is_cursor_phase);
+
+		dirty_top = height;
+		dirty_bottom = 0;
+
+		for (int row = 0; row < rows; row++)
+		{
+		    for (int col = 0; col < cols; col++)
+		    {
+			int cell = ((row * cols) + col);
+
+			// Each row of text starts right after the last one, and the address wraps around the 4 KB of VRAM
+			int addr = (start_addr + (row * crtc.getcolumns()) + col);
+			uint8_t character = text[((addr * 2) & 0xFFF)];
+			uint8_t attribute = text[(((addr * 2) + 1) & 0xFFF)];
+
+			// A blanked screen (and the area outside of the displayed rows and columns)
+			// is drawn as spaces with the non-display attribute
+			bool is_displayed = (is_video_enabled && (row < num_rows) && (col < num_cols));
+			bool is_cursor = (is_displayed && is_cursor_shown && (addr == cursor_addr));
+			int style = is_displayed ? getstyle(attribute, is_blink_phase) : 0;
+			character = is_displayed ? character : 0;
+			uint16_t cell_key = ((is_cursor ? 0x8000 : 0) | (style << 8) | character);
+
+			if (cells[cell] == cell_key)
+			{
+			    continue;
+			}
+
+			cells[cell] = cell_key;
+			drawcell(row, col, style, character, is_cursor);
+			dirty_top = min(dirty_top, (row * cell_height));
+			dirty_bottom = max(dirty_bottom, ((row + 1) * cell_height));
+		    }
+		}
+
+		return (dirty_top < dirty_bottom);
+	    }
+
+	    void getdirtyrows(int &top, int &count)
+	    {
+		top = dirty_top;
+		count = max(0, (dirty_bottom - dirty_top));
+	    }
+
+	    const uint32_t *getframebuffer()
+	    {
+		return framebuffer.data();
+	    }
+
+	    int getwidth()
+	    {
+		return width;
+	    }
 
-		cout << "Blinking: " << ((is_blink_enabled) ? "Enabled" : "Disabled") << endl;
-		cout << "Video output: " << ((is_video_enabled) ? "Enabled" : "Disabled") << endl;
-		cout << endl;
+	    int getheight()
+	    {
+		return height;
+	    }
+
+	    uint64_t getframecycles()
+	    {
+		return crtc.getframecycles();
 	    }
 
 	private:
@@ -53,10 +213,159 @@ namespace beemda
 		return ((reg >> bit) & 1) ? true : false;
 	    }
 
+	    // Pixel clock of 16.257 MHz
+	    static constexpr uint64_t dot_clock = 16257000;
+
+	    // The IBM BIOS' CRTC settings for 80x25 text mode
+	    // (giving 370 scanlines of 882 pixels, or about 50 Hz)
+	    const array<uint8_t, 18> crtc_defaults = {
+		0x61, 0x50, 0x52, 0x0F, 0x19, 0x06, 0x19, 0x19, 0x02,
+		0x0D, 0x0B, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	    };
+
+	    Bee8086MemoryMap &memory_map;
+	    BeeCRTC crtc;
+	    const array<uint8_t, 0x2000> &font_rom;
+
+	    static constexpr uint32_t vram_addr = 0xB0000;
+	    static constexpr int vram_size = 0x1000;
+	    static constexpr int cols = 80;
+	    static constexpr int rows = 25;
+	    static constexpr int cell_width = 9;
+	    static constexpr int cell_height = 14;
+
+	    // The underline is drawn on the 13th scanline of a character
+	    static constexpr int underline_row = 12;
+
+	    // Black, normal intensity and high intensity
+	    const array<uint32_t, 3> palette = {0xFF000000, 0xFF00AA00, 0xFF55FF55};
+
+	    // A style is the foreground color, background color and underline that an attribute produces,
+	    // numbered as (foreground * 6) + (background * 2) + underline
+	    static constexpr int num_styles = 18;
+
 	    bool is_blink_enabled = false;
 	    bool is_video_enabled = false;
+	    bool is_redraw = true;
+	    int last_blink_phase = 0;
+	    uint32_t frame_count = 0;
+
+	    array<uint8_t, vram_size> text;
+
+	    // The style and character last drawn in each cell (with bit 15 set if the cursor was drawn in it)
+	    array<uint16_t, (cols * rows)> cells;
+
+	    // The rows of each glyph expanded to 9 bits (with the leftmost pixel in bit 8),
+	    // without and then with an underline
+	    vector<uint16_t> glyph_lines;
+
+	    array<uint32_t, (width * height)> framebuffer;
+	    int dirty_top = 0;
+	    int dirty_bottom = 0;
+
+	    int getstyle(uint8_t attribute, bool is_blink_phase)
+	    {
+		int foreground = testbit(attribute, 3) ? 2 : 1;
+		int background = 0;
+		bool is_underline = ((attribute & 0x07) == 0x01);
+
+		switch (attribute & 0x77)
+		{
+		    // Non-display
+		    case 0x00: foreground = 0; break;
+		    // Reverse video
+		    case 0x70:
+		    {
+			foreground = 0;
+			background = 1;
+		    }
+		    break;
+		    default: break;
+		}
+
+		if (testbit(attribute, 7))
+		{
+		    if (is_blink_enabled)
+		    {
+			// The whole character (underline included) disappears during the off phase
+			if (!is_blink_phase)
+			{
+			    foreground = background;
+			    is_underline = false;
+			}
+		    }
+		    else if (background != 0)
+		    {
+			// Without blinking, bit 7 selects a high intensity background instead
+			background = 2;
+		    }
+		}
 
-	    int crtc_reg = 0;
+		return ((foreground * 6) + (background * 2) + (is_underline ? 1 : 0));
+	    }
+
+	    void expandglyphs()
+	    {
+		glyph_lines.resize(2 * 256 * cell_height);
+
+		for (int is_underline = 0; is_underline < 2; is_underline++)
+		{
+		    for (int character = 0; character < 256; character++)
+		    {
+			uint16_t *lines = &glyph_lines[(((is_underline * 256) + character) * cell_height)];
+
+			for (int y = 0; y < cell_height; y++)
+			{
+			    // The top 8 rows of each glyph are in the first half of the ROM, and the rest are in the second half
+			    int offs = (y < 8) ? ((character * 8) + y) : (0x800 + (character * 8) + (y - 8));
+			    uint16_t line = (font_rom[offs] << 1);
+
+			    // The line drawing characters extend their last column into the 9th column
+			    if ((character >= 0xC0) && (character <= 0xDF))
+			    {
+				line |= (line >> 1) & 1;
+			    }
+
+			    if (is_underline && (y == underline_row))
+			    {
+				line = 0x1FF;
+			    }
+
+			    lines[y] = line;
+			}
+		    }
+		}
+	    }
+
+	    void drawcell(int row, int col, int style, uint8_t character, bool is_cursor)
+	    {
+		uint32_t foreground = palette[(style / 6)];
+		uint32_t background = palette[((style / 2) % 3)];
+		const uint16_t *lines = &glyph_lines[((((style & 1) * 256) + character) * cell_height)];
+		uint32_t *dst = &framebuffer[(((row * cell_height) * width) + (col * cell_width))];
+
+		for (int y = 0; y < cell_height; y++)
+		{
+		    expandglyphrow(lines[y], cell_width, foreground, background, dst);
+		    dst += width;
+		}
+
+		if (!is_cursor)
+		{
+		    return;
+		}
+
+		// The cursor covers its scanlines in the character's foreground color
+		// (or in normal intensity if the character is invisible)
+		uint32_t cursor_color = (foreground != background) ? foreground : palette[1];
+		int cursor_end = min(crtc.getcursorend(), (cell_height - 1));
+		dst = &framebuffer[(((row * cell_height) * width) + (col * cell_width))];
+
+		for (int y = crtc.getcursorstart(); y <= cursor_end; y++)
+		{
+		    fill((dst + (y * width)), (dst + (y * width) + cell_width), cursor_color);
+		}
+	    }
     };
 }
 
@@ -0,0 +1,224 @@
+#ifndef BEE8086_PIC
+#define BEE8086_PIC
+
+#include <iostream>
+#include <cstdint>
+using namespace std;
+
+namespace beepic
+{
+    // Intel 8259A programmable interrupt controller (as a single PIC, like on the PC/XT)
+    //
+    // Interrupt requests are edge-triggered, and are prioritized with IRQ 0 as the highest priority
+    class BeePIC
+    {
+	public:
+	    BeePIC()
+	    {
+		reset();
+	    }
+
+	    ~BeePIC()
+	    {
+
+	    }
+
+	    void reset()
+	    {
+		irr = 0;
+		isr = 0;
+		imr = 0xFF;
+		vector_base = 0x08;
+		init_step = 0;
+		is_init = false;
+		is_single = true;
+		is_icw4 = false;
+		is_auto_eoi = false;
+		is_read_isr = false;
+	    }
+
+	    bool isport(uint16_t port)
+	    {
+		return ((port == 0x20) || (port == 0x21));
+	    }
+
+	    uint8_t readPort(uint16_t port)
+	    {
+		if (port == 0x21)
+		{
+		    return imr;
+		}
+
+		return is_read_isr ? isr : irr;
+	    }
+
+	    void writePort(uint16_t port, uint8_t data)
+	    {
+		if (port == 0x20)
+		{
+		    if (testbit(data, 4))
+		    {
+			// ICW1 starts the initialization sequence
+			is_single = testbit(data, 1);
+			is_icw4 = testbit(data, 0);
+			irr = 0;
+			isr = 0;
+			imr = 0;
+			is_auto_eoi = false;
+			is_read_isr = false;
+			init_step = 2;
+		    }
+		    else if (testbit(data, 3))
+		    {
+			writeOCW3(data);
+		    }
+		    else
+		    {
+			writeOCW2(data);
+		    }
+
+		    return;
+		}
+
+		switch (init_step)
+		{
+		    case 2:
+		    {
+			vector_base = (data & 0xF8);
+			init_step = !is_single ? 3 : (is_icw4 ? 4 : 0);
+		    }
+		    break;
+		    case 3:
+		    {
+			// ICW3 only matters when PICs are cascaded
+			init_step = is_icw4 ? 4 : 0;
+		    }
+		    break;
+		    case 4:
+		    {
+			is_auto_eoi = testbit(data, 1);
+			init_step = 0;
+		    }
+		    break;
+		    default: imr = data; break; // OCW1
+		}
+
+		if (init_step == 0)
+		{
+		    is_init = true;
+		}
+	    }
+
+	    // Signals a rising edge on "irq"
+	    void raiseirq(int irq)
+	    {
+		irr |= (1 << (irq & 7));
+	    }
+
+	    // Returns true if an unmasked request is waiting, and nothing of higher (or equal) priority is being serviced
+	    bool ispending()
+	    {
+		return (getpending() >= 0);
+	    }
+
+	    // Acknowledges the highest priority request, and returns its interrupt number
+	    uint8_t acknowledge()
+	    {
+		int irq = getpending();
+
+		// A request that went away before being acknowledged shows up as IRQ 7
+		if (irq < 0)
+		{
+		    return (vector_base | 7);
+		}
+
+		irr &= ~(1 << irq);
+
+		if (!is_auto_eoi)
+		{
+		    isr |= (1 << irq);
+		}
+
+		return (vector_base | irq);
+	    }
+
+	private:
+	    uint8_t irr = 0;
+	    uint8_t isr = 0;
+	    uint8_t imr = 0xFF;
+	    uint8_t vector_base = 0x08;
+	    int init_step = 0;
+	    bool is_init = false;
+	    bool is_single = true;
+	    bool is_icw4 = false;
+	    bool is_auto_eoi = false;
+	    bool is_read_isr = false;
+
+	    int getpending()
+	    {
+		// Nothing is delivered until the guest has programmed the PIC
+		if (!is_init || (init_step != 0))
+		{
+		    return -1;
+		}
+
+		uint8_t requests = (irr & ~imr);
+
+		for (int irq = 0; irq < 8; irq++)
+		{
+		    if (testbit(isr, irq))
+		    {
+			return -1;
+		    }
+
+		    if (testbit(requests, irq))
+		    {
+			return irq;
+		    }
+		}
+
+		return -1;
+	    }
+
+	    void writeOCW2(uint8_t data)
+	    {
+		int command = (data >> 5);
+
+		switch (command)
+		{
+		    case 1:
+		    {
+			// Non-specific EOI clears the highest priority interrupt being serviced
+			for (int irq = 0; irq < 8; irq++)
+			{
+			    if (testbit(isr, irq))
+			    {
+				isr &= ~(1 << irq);
+				break;
+			    }
+			}
+		    }
+		    break;
+		    case 3: isr &= ~(1 << (data & 7)); break; // Specific EOI
+		    default: break; // Priority rotation isn't used by anything on the PC
+		}
+	    }
+
+	    void writeOCW3(uint8_t data)
+	    {
+		if (testbit(data, 1))
+		{
+		    is_read_isr = testbit(data, 0);
+		}
+	    }
+
+	    template<typename T>
+	    bool testbit(T reg, int bit)
+	    {
+		return ((reg >> bit) & 1) ? true : false;
+	    }
+    };
+}
+
+
+#endif // BEE8086_PIC
\ No newline at end of file
@@ -0,0 +1,142 @@
+#ifndef BEERENDERER_H
+#define BEERENDERER_H
+
+#include <iostream>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <SDL2/SDL.h>
+#include "beetriplebuffer.h"
+
+using namespace std;
+
+// Shows frames in a window using an SDL renderer and a streaming texture
+//
+// SDL's renderer has to stay on the thread that pumps its events (which macOS requires to be the main thread),
+// so frames are published from the emulation thread through a triple buffer, and shown by present() on the main thread
+// (which means presenting, and waiting for vsync, never holds up the emulation thread)
+class BeeRenderer
+{
+    public:
+	BeeRenderer()
+	{
+
+	}
+
+	~BeeRenderer()
+	{
+	    stop();
+	}
+
+	BeeRenderer(const BeeRenderer&) = delete;
+	BeeRenderer &operator=(const BeeRenderer&) = delete;
+
+	// Starts rendering frames of "w" x "h" pixels into "window", where each row of pixels is shown "line_scale" times
+	// (the output is scaled to fit the window, keeping its aspect ratio)
+	bool start(SDL_Window *window, int w, int h, int line_scale = 1)
+	{
+	    stop();
+	    width = w;
+	    height = h;
+	    frames.resize(width * height);
+
+	    renderer = SDL_CreateRenderer(window, -1, (SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC));
+
+	    if (renderer != NULL)
+	    {
+		texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+	    }
+
+	    if (texture == NULL)
+	    {
+		cout << "Renderer could not be created! SDL_Error: " << SDL_GetError() << endl;
+		stop();
+		return false;
+	    }
+
+	    SDL_RenderSetLogicalSize(renderer, width, (height * line_scale));
+	    return true;
+	}
+
+	void stop()
+	{
+	    if (texture != NULL)
+	    {
+		SDL_DestroyTexture(texture);
+		texture = NULL;
+	    }
+
+	    if (renderer != NULL)
+	    {
+		SDL_DestroyRenderer(renderer);
+		renderer = NULL;
+	    }
+	}
+
+	// Hands a frame (in ARGB8888 format) over to the main thread
+	void publish(const uint32_t *framebuffer)
+	{
+	    frames.publish(framebuffer);
+	    frame_cond.notify_one();
+	}
+
+	// Wakes up present() without a new frame (i.e. when the emulation thread has finished)
+	void wake()
+	{
+	    frame_cond.notify_one();
+	}
+
+	// Waits for up to "timeout_ms" milliseconds for a new frame, and shows it if there is one
+	// (the wait is short, so the caller can go back to pumping events even if no frames are coming)
+	void present(int timeout_ms = 10)
+	{
+	    if (!frames.fetch())
+	    {
+		{
+		    unique_lock<mutex> lock(frame_mutex);
+		    frame_cond.wait_for(lock, chrono::milliseconds(timeout_ms));
+		}
+
+		if (!frames.fetch())
+		{
+		    return;
+		}
+	    }
+
+	    void *pixels = NULL;
+	    int pitch = 0;
+
+	    if (SDL_LockTexture(texture, NULL, &pixels, &pitch) == 0)
+	    {
+		const uint32_t *frame = frames.getframe();
+
+		for (int y = 0; y < height; y++)
+		{
+		    memcpy(((uint8_t*)pixels + (y * pitch)), (frame + (y * width)), (width * 4));
+		}
+
+		SDL_UnlockTexture(texture);
+	    }
+
+	    SDL_RenderClear(renderer);
+	    SDL_RenderCopy(renderer, texture, NULL, NULL);
+	    SDL_RenderPresent(renderer);
+	}
+
+    private:
+	int width = 0;
+	int height = 0;
+
+	SDL_Renderer *renderer = NULL;
+	SDL_Texture *texture = NULL;
+	BeeTripleBuffer frames;
+
+	// Only used to wake up the main thread (which also checks for frames on its own every so often,
+	// so a wakeup that comes just before it starts waiting is never lost for long)
+	mutex frame_mutex;
+	condition_variable frame_cond;
+};
+
+#endif // BEERENDERER_H
\ No newline at end of file
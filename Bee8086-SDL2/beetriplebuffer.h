@@ -0,0 +1,82 @@
+#ifndef BEETRIPLEBUFFER_H
+#define BEETRIPLEBUFFER_H
+
+#include <vector>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+
+// Hands frames from one thread to another without either of them ever waiting on the other
+//
+// The writer always has a buffer of its own to draw into, and the reader always has the latest finished frame,
+// while the third buffer is swapped between them (along with a flag for whether it holds a frame the reader hasn't seen)
+class BeeTripleBuffer
+{
+    public:
+	BeeTripleBuffer()
+	{
+
+	}
+
+	~BeeTripleBuffer()
+	{
+
+	}
+
+	void resize(size_t size)
+	{
+	    for (auto &buffer : buffers)
+	    {
+		buffer.assign(size, 0);
+	    }
+
+	    write_index = 0;
+	    shared_state = 1;
+	    read_index = 2;
+	}
+
+	// Copies "frame" into the writer's buffer and hands it over to the reader (only called by the writer)
+	void publish(const uint32_t *frame)
+	{
+	    auto &buffer = buffers[write_index];
+	    memcpy(buffer.data(), frame, (buffer.size() * 4));
+	    int prev_state = shared_state.exchange((write_index | fresh_bit), memory_order_acq_rel);
+	    write_index = (prev_state & index_mask);
+	}
+
+	// Takes the latest frame, and returns false if there hasn't been a new one since the last call (only called by the reader)
+	bool fetch()
+	{
+	    if ((shared_state.load(memory_order_relaxed) & fresh_bit) == 0)
+	    {
+		return false;
+	    }
+
+	    int prev_state = shared_state.exchange(read_index, memory_order_acq_rel);
+	    read_index = (prev_state & index_mask);
+	    return true;
+	}
+
+	// The frame last taken by fetch()
+	const uint32_t *getframe()
+	{
+	    return buffers[read_index].data();
+	}
+
+    private:
+	static constexpr int index_mask = 0x3;
+	static constexpr int fresh_bit = 0x4;
+
+	array<vector<uint32_t>, 3> buffers;
+
+	// Index of the buffer in the middle (plus the fresh bit)
+	atomic<int> shared_state{1};
+
+	int write_index = 0;
+	int read_index = 2;
+};
+
+#endif // BEETRIPLEBUFFER_H
\ No newline at end of file
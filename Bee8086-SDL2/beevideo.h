@@ -0,0 +1,48 @@
+#ifndef BEEVIDEO_H
+#define BEEVIDEO_H
+
+#include <functional>
+#include <cstdint>
+
+using namespace std;
+
+// Display adapter that draws its output into a framebuffer
+// (i.e. the MDA or the CGA)
+class BeeVideo
+{
+    public:
+	using Callback = function<void()>;
+
+	virtual ~BeeVideo()
+	{
+
+	}
+
+	// Starts the adapter's frame timing, and calls "func" at the start of every vertical retrace
+	virtual void start(Callback func) = 0;
+
+	// Draws the current frame, and returns true if anything on the screen has changed
+	//
+	// The rows of pixels that changed can be fetched with getdirtyrows()
+	virtual bool renderframe() = 0;
+
+	// Returns the first row of pixels that changed in the last frame, and the number of rows that changed
+	virtual void getdirtyrows(int &top, int &count) = 0;
+
+	// Framebuffer of getwidth() x getheight() pixels, in ARGB8888 format
+	virtual const uint32_t *getframebuffer() = 0;
+
+	virtual int getwidth() = 0;
+	virtual int getheight() = 0;
+
+	// Number of CPU cycles in each frame (with the adapter's current settings)
+	virtual uint64_t getframecycles() = 0;
+
+	// Number of times each row of pixels is shown, to get the right aspect ratio on a modern display
+	virtual int getlinescale()
+	{
+	    return 1;
+	}
+};
+
+#endif // BEEVIDEO_H
\ No newline at end of file
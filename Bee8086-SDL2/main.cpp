@@ -2,14 +2,42 @@
 #include <fstream>
 #include <vector>
 #include <array>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <cstdlib>
 #include <cstdint>
 #include <SDL2/SDL.h>
 #include <Bee8086/bee8086.h>
+#include <Bee8086/gdbstub.h>
+#include <Bee8086/recorder.h>
+#include <Bee8086/memorymap.h>
+#include <Bee8086/blobstore.h>
+#include <Bee8086/scheduler.h>
 #include "beefloppy.h"
+#include "beeharddisk.h"
+#include "beefatdrive.h"
+#include "beediskio.h"
+#include "beedisktiming.h"
+#include "beepic.h"
 #include "beemda.h"
+#include "beecga.h"
+#include "beeheadless.h"
+#include "beecapture.h"
+#include "beerenderer.h"
+#include "beedma.h"
+#include "beefdc.h"
 #include "mda_rom.inl"
 using namespace bee8086;
 using namespace beemda;
+using namespace beecga;
+using namespace beedma;
+using namespace beepic;
+using namespace beefdc;
 using namespace std;
 
 class SDL2Frontend : public Bee8086Interface
@@ -27,7 +55,27 @@ class SDL2Frontend : public Bee8086Interface
 
 	void printusage()
 	{
-	    cout << "Usage: example [floppy image] ([BIOS])" << endl;
+	    cout << "Usage: example [options] [floppy image] ([BIOS])" << endl;
+	    cout << endl;
+	    cout << "Options:" << endl;
+	    cout << "--gdb=PORT             Wait for GDB to connect on a local TCP port (or on unix:PATH)" << endl;
+	    cout << "--timetravel           Record the CPU's history for GDB's reverse execution commands" << endl;
+	    cout << "--record=FILE          Record all port inputs and BIOS call results to FILE" << endl;
+	    cout << "--replay=FILE          Replay a recording from FILE (as fast as possible) and print timing statistics" << endl;
+	    cout << "--hdd=FILE             Attach FILE as the first hard disk (raw or fixed VHD image)" << endl;
+	    cout << "--hdd=DIR              Attach DIR as the first hard disk (as a FAT volume, with writes kept in memory)" << endl;
+	    cout << "--overlay              Keep disk writes in memory instead of writing them to the disk images (the default)" << endl;
+	    cout << "--overlay=DIR          Keep disk writes in overlay files in DIR (which persist between runs)" << endl;
+	    cout << "--instance=N           Keep separate overlay files for machines running at the same time (default 0)" << endl;
+	    cout << "--commit               Write the overlays back into the disk images on exit" << endl;
+	    cout << "--writeback            Write disk writes straight back into the disk images (in the background)" << endl;
+	    cout << "--cga                  Show the CGA's output instead of the MDA's" << endl;
+	    cout << "--headless             Draw the display into memory instead of a window" << endl;
+	    cout << "--frames=N             Stop after N frames (and print a hash of the last frame when headless)" << endl;
+	    cout << "--expect-hash=HASH     Exit with an error if the last frame's hash doesn't match HASH (in hex)" << endl;
+	    cout << "--capture=FILE         Record the display to FILE (a Y4M video, or a sequence of PPM images named after FILE)" << endl;
+	    cout << "--turbo                Run as fast as possible instead of in real time (toggled with F11, always on when headless)" << endl;
+	    cout << "--trace                Print the CPU's state before every instruction (toggled with F12)" << endl;
 	}
 
 	bool init()
@@ -44,28 +92,170 @@ class SDL2Frontend : public Bee8086Interface
 		return false;
 	    }
 
-	    memory.resize(0x100000, 0);
+	    if ((hdd_name != "") && !load_hdd())
+	    {
+		cout << "Unable to initialize frontend." << endl;
+		return false;
+	    }
+
+	    // RAM is only allocated as the guest touches it
+	    // (the MDA's 4 KB of VRAM is mirrored throughout 0xB0000-0xB7FFF, and the CGA's 16 KB throughout 0xB8000-0xBFFFF)
+	    vector<Bee8086MemoryRegion> regions = {
+		{"Conventional RAM", 0x00000, 0xA0000, Bee8086MemoryRegion::SparseRAM},
+		{"MDA VRAM", 0xB0000, 0x8000, Bee8086MemoryRegion::SparseRAM, NULL, 0x1000},
+		{"CGA VRAM", 0xB8000, 0x8000, Bee8086MemoryRegion::SparseRAM, NULL, 0x4000},
+		{"BIOS", bios_entry.addr, bios_entry.size, Bee8086MemoryRegion::ROM, const_cast<uint8_t*>(bios_blob->data())},
+	    };
+
+	    if (!memory_map.addregions(regions))
+	    {
+		cout << "Unable to initialize memory map." << endl;
+		return false;
+	    }
 
 	    core.setinterface(this);
 	    core.init(bios_entry.cs_val, bios_entry.ip_val);
+	    disk_io.start();
+
+	    if ((record_name != "") || (replay_name != ""))
+	    {
+		recorder.reset(new Bee8086Recorder(core, *this));
+
+		if (replay_name != "")
+		{
+		    if (!recorder->loadlog(replay_name))
+		    {
+			cout << "Unable to load recording." << endl;
+			return false;
+		    }
+
+		    recorder->setmode(Bee8086Recorder::Replay);
+		}
+		else
+		{
+		    recorder->setmode(Bee8086Recorder::Record);
+		}
+
+		core.setinterface(recorder.get());
+	    }
 
+	    if (gdb_address != "")
+	    {
+		gdb_stub.reset(new Bee8086GDBStub(core, *this));
+
+		gdb_stub->setscheduler(&scheduler);
+
+		if (use_time_travel)
+		{
+		    time_travel.reset(new Bee8086TimeTravel(core, *this));
+		    time_travel->setscheduler(&scheduler);
+		    time_travel->setmemorymap(&memory_map);
+		    gdb_stub->settimetravel(time_travel.get());
+		}
+
+		if (!gdb_stub->listen(gdb_address) || !gdb_stub->waitforclient())
+		{
+		    cout << "Unable to initialize GDB stub." << endl;
+		    return false;
+		}
+	    }
+
+	    // Both adapters are on the bus, but only one of them is shown
+	    if (use_cga)
+	    {
+		video = &color_display;
+	    }
+	    else
+	    {
+		video = &mono_display;
+	    }
+
+	    if (use_headless)
+	    {
+		headless.resize(video->getwidth(), video->getheight());
+	    }
+	    else if (!initwindow())
+	    {
+		return false;
+	    }
+
+	    // The frame rate is taken from the adapter's timing when the capture starts (i.e. about 50 Hz for the MDA)
+	    if ((capture_name != "") && !capture.open(capture_name, video->getwidth(), video->getheight(), cpu_clock, video->getframecycles(), video->getlinescale()))
+	    {
+		return false;
+	    }
+
+	    // Draw the display at the start of each vertical retrace
+	    video->start([this]()
+	    {
+		drawframe();
+	    });
+
+	    return true;
+	}
+
+	bool initwindow()
+	{
 	    if (SDL_Init(SDL_INIT_VIDEO) < 0)
 	    {
 		return sdlerror("SDL could not be initialized!");
 	    }
 
-	    window = SDL_CreateWindow("Bee8086-SDL2", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 200, 200, SDL_WINDOW_SHOWN);
+	    window = SDL_CreateWindow("Bee8086-SDL2", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, video->getwidth(), (video->getheight() * video->getlinescale()), (SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE));
 
 	    if (window == NULL)
 	    {
 		return sdlerror("Window could not be created!");
 	    }
 
-	    surface = SDL_GetWindowSurface(window);
+	    // Frames are shown from the main thread (while the CPU runs on a thread of its own), so presenting them never holds up the CPU
+	    if (!renderer.start(window, video->getwidth(), video->getheight(), video->getlinescale()))
+	    {
+		cout << "Unable to start the renderer." << endl;
+		return false;
+	    }
 
 	    return true;
 	}
 
+	void drawframe()
+	{
+	    frame_count += 1;
+
+	    if ((max_frames != 0) && (frame_count >= max_frames))
+	    {
+		is_frames_finished = true;
+	    }
+
+	    bool is_changed = video->renderframe();
+
+	    if (capture.isopen())
+	    {
+		capture.pushframe(video->getframebuffer(), is_changed);
+	    }
+
+	    // Only copy the rows of the screen that changed (when headless)
+	    int top = 0;
+	    int count = 0;
+
+	    if (is_changed)
+	    {
+		video->getdirtyrows(top, count);
+	    }
+
+	    if (use_headless)
+	    {
+		headless.update(video->getframebuffer(), top, count);
+		headless.endframe();
+		return;
+	    }
+
+	    if (is_changed)
+	    {
+		renderer.publish(video->getframebuffer());
+	    }
+	}
+
 	bool sdlerror(string message)
 	{
 	    cout << message << " SDL_Error: " << SDL_GetError() << endl;
@@ -74,15 +264,129 @@ class SDL2Frontend : public Bee8086Interface
 
 	void shutdown()
 	{
-	    memory.clear();
-	    bios.clear();
+	    if (gdb_stub)
+	    {
+		gdb_stub->close();
+	    }
+
+	    if (recorder && (record_name != ""))
+	    {
+		recorder->savelog(record_name);
+	    }
+
+	    capture.close();
+	    cout << "Guest memory: " << dec << memory_map.gettouchedpages() << " pages touched" << endl;
+	    scheduler.clear();
+	    memory_map.clear();
+	    bios_blob.reset();
+
+	    // Let any disk request that's still running finish before touching the disks
+	    disk_io.stop();
+	    disk_request.reset();
+
+	    if (use_commit)
+	    {
+		if (!disk_a.commit() || !disk_c.commit())
+		{
+		    cout << "Error: could not commit overlays to the disk images" << endl;
+		}
+	    }
+
+	    // Make sure every guest write has reached the disk images before closing them
+	    disk_a.sync();
+	    disk_c.sync();
 	    disk_a.close();
+	    disk_c.close();
+	    fat_drive.close();
 	    core.shutdown();
+
+	    if (use_headless)
+	    {
+		checkframehash();
+		return;
+	    }
+
+	    renderer.stop();
 	    SDL_DestroyWindow(window);
 	    SDL_Quit();
 	}
 
-	bool run()
+	void checkframehash()
+	{
+	    if (max_frames == 0)
+	    {
+		return;
+	    }
+
+	    stringstream hash_str;
+	    hash_str << hex << setw(16) << setfill('0') << headless.gethash();
+	    cout << "Frame " << dec << headless.getframecount() << " hash: " << hash_str.str() << endl;
+
+	    if ((expected_hash != "") && (strtoull(expected_hash.c_str(), NULL, 16) != headless.gethash()))
+	    {
+		cout << "Error: frame hash doesn't match (expected " << expected_hash << ")" << endl;
+		exit_code = 1;
+	    }
+	}
+
+	int getexitcode()
+	{
+	    return exit_code;
+	}
+
+	// Runs the emulation until it's finished (or the window is closed)
+	//
+	// With a window, the CPU runs on a thread of its own, while this thread pumps SDL's events and presents frames
+	// (SDL expects both of those to happen on the same thread, which has to be the main thread on some platforms)
+	void run()
+	{
+	    if (use_headless)
+	    {
+		while (runslice());
+		return;
+	    }
+
+	    thread emu_thread([this]()
+	    {
+		while (!is_quitting && runslice());
+		is_quitting = true;
+		renderer.wake();
+	    });
+
+	    while (!is_quitting)
+	    {
+		if (!pollevents())
+		{
+		    is_quitting = true;
+		    break;
+		}
+
+		renderer.present();
+	    }
+
+	    emu_thread.join();
+	}
+
+	// Runs a frame's worth of cycles (or a slice when GDB is attached, or while replaying),
+	// and then waits until it's time for the next one
+	bool runslice()
+	{
+	    runcore();
+
+	    // Pacing starts over once turbo mode is switched off
+	    if (is_turbo)
+	    {
+		is_pacing_started = false;
+	    }
+	    else if (!use_headless && (replay_name == "") && !gdb_stub)
+	    {
+		throttle();
+	    }
+
+	    return (!is_replay_finished && !is_frames_finished);
+	}
+
+	bool pollevents()
 	{
 	    SDL_Event ev;
 
@@ -91,26 +395,176 @@ class SDL2Frontend : public Bee8086Interface
 		switch (ev.type)
 		{
 		    case SDL_QUIT: return false; break;
+		    case SDL_KEYDOWN:
+		    {
+			if (ev.key.repeat == 0)
+			{
+			    handlekey(ev.key.keysym.sym);
+			}
+		    }
+		    break;
 		}
 	    }
 
-	    runcore();
 	    return true;
 	}
 
+	void handlekey(SDL_Keycode key)
+	{
+	    switch (key)
+	    {
+		case SDLK_F11:
+		{
+		    is_turbo = !is_turbo;
+		    cout << "Turbo: " << (is_turbo ? "On" : "Off") << endl;
+		}
+		break;
+		case SDLK_F12:
+		{
+		    is_tracing = !is_tracing;
+		    cout << "Tracing: " << (is_tracing ? "On" : "Off") << endl;
+		}
+		break;
+		default: break;
+	    }
+	}
+
+	// Sleeps until the frame that just ran is due, so the guest runs at 4.77 MHz
+	void throttle()
+	{
+	    auto now = chrono::steady_clock::now();
+
+	    if (!is_pacing_started)
+	    {
+		next_frame_time = now;
+		is_pacing_started = true;
+	    }
+
+	    next_frame_time += chrono::nanoseconds((video->getframecycles() * 1000000000ULL) / cpu_clock);
+
+	    if (next_frame_time > now)
+	    {
+		this_thread::sleep_until(next_frame_time);
+	    }
+	    else if ((now - next_frame_time) > chrono::milliseconds(100))
+	    {
+		// Don't try to catch up after falling far behind (i.e. after the window was dragged)
+		next_frame_time = now;
+	    }
+	}
+
 	bool getargs(int argc, char *argv[])
 	{
-	    if (argc < 2)
+	    vector<string> args;
+
+	    for (int index = 1; index < argc; index++)
+	    {
+		string arg = argv[index];
+
+		if (arg.compare(0, 6, "--gdb=") == 0)
+		{
+		    gdb_address = arg.substr(6);
+		}
+		else if (arg == "--timetravel")
+		{
+		    use_time_travel = true;
+		}
+		else if (arg.compare(0, 9, "--record=") == 0)
+		{
+		    record_name = arg.substr(9);
+		}
+		else if (arg.compare(0, 9, "--replay=") == 0)
+		{
+		    replay_name = arg.substr(9);
+		}
+		else if (arg.compare(0, 6, "--hdd=") == 0)
+		{
+		    hdd_name = arg.substr(6);
+		}
+		else if (arg == "--overlay")
+		{
+		    use_overlay = true;
+		}
+		else if (arg.compare(0, 10, "--overlay=") == 0)
+		{
+		    use_overlay = true;
+		    overlay_dir = arg.substr(10);
+		}
+		else if (arg.compare(0, 11, "--instance=") == 0)
+		{
+		    instance_id = strtoul(arg.substr(11).c_str(), NULL, 10);
+		}
+		else if (arg == "--commit")
+		{
+		    use_commit = true;
+		}
+		else if (arg == "--writeback")
+		{
+		    use_writeback = true;
+		}
+		else if (arg == "--cga")
+		{
+		    use_cga = true;
+		}
+		else if (arg == "--headless")
+		{
+		    use_headless = true;
+		}
+		else if (arg.compare(0, 9, "--frames=") == 0)
+		{
+		    max_frames = strtoull(arg.substr(9).c_str(), NULL, 10);
+		}
+		else if (arg.compare(0, 14, "--expect-hash=") == 0)
+		{
+		    expected_hash = arg.substr(14);
+		}
+		else if (arg.compare(0, 10, "--capture=") == 0)
+		{
+		    capture_name = arg.substr(10);
+		}
+		else if (arg == "--turbo")
+		{
+		    is_turbo = true;
+		}
+		else if (arg == "--trace")
+		{
+		    is_tracing = true;
+		}
+		else
+		{
+		    args.push_back(arg);
+		}
+	    }
+
+	    if (args.empty())
 	    {
 		printusage();
 		return false;
 	    }
 
-	    floppy_name = argv[1];
+	    if ((record_name != "") && (replay_name != ""))
+	    {
+		cout << "Error: --record and --replay can't be used together" << endl;
+		return false;
+	    }
 
-	    if (argc > 2)
+	    if (use_time_travel && ((record_name != "") || (replay_name != "")))
 	    {
-		bios_name = argv[2];
+		cout << "Error: --timetravel can't be used with --record or --replay" << endl;
+		return false;
+	    }
+
+	    if ((expected_hash != "") && (!use_headless || (max_frames == 0)))
+	    {
+		cout << "Error: --expect-hash needs --headless and --frames" << endl;
+		return false;
+	    }
+
+	    floppy_name = args[0];
+
+	    if (args.size() > 1)
+	    {
+		bios_name = args[1];
 		bios_entry = pcxt;
 	    }
 	    else
@@ -125,83 +579,178 @@ class SDL2Frontend : public Bee8086Interface
 
 	bool load_bios()
 	{
-	    vector<uint8_t> biostemp = loadfile(bios_name);
+	    auto bios_file = make_shared<BeeMappedFile>();
 
-	    if (biostemp.empty())
+	    if (!bios_file->open(bios_name))
 	    {
 		return false;
 	    }
 
-	    if (biostemp.size() > bios_entry.size)
+	    if ((bios_entry.offs + bios_file->size()) > bios_entry.size)
 	    {
 		cout << "Error: BIOS size mismatch" << endl;
 		return false;
 	    }
 
-	    bios.resize(bios_entry.size, 0);
-
-	    for (size_t index = 0; index < biostemp.size(); index++)
+	    // Every machine in the process shares a single copy of the ROM image
+	    // (ROM regions are never written to, so the mapped file can be used as-is)
+	    if ((bios_entry.offs == 0) && (bios_file->size() == bios_entry.size))
+	    {
+		bios_blob = Bee8086BlobStore::get().intern(bios_file, bios_file->data(), bios_file->size(), bios_file->getid());
+	    }
+	    else
 	    {
-		bios[(bios_entry.offs + index)] = biostemp[index];
+		// Pad the image out to the size of its region (i.e. KujoBIOS starts 0x100 bytes into it)
+		vector<uint8_t> bios(bios_entry.size, 0);
+		memcpy(&bios[bios_entry.offs], bios_file->data(), bios_file->size());
+		bios_blob = Bee8086BlobStore::get().intern(bios);
 	    }
 
-	    biostemp.clear();
 	    return true;
 	}
 
 	bool load_floppy()
 	{
-	    vector<uint8_t> floppy_temp = loadfile(floppy_name);
+	    disk_a.use_writeback = (use_writeback && !use_overlay);
 
-	    if (floppy_temp.empty())
+	    if (!disk_a.open(floppy_name))
 	    {
 		return false;
 	    }
 
-	    disk_a.open(floppy_temp);
-	    return true;
+	    return ((overlay_dir == "") || disk_a.openoverlay(getoverlayname(floppy_name, disk_a.gethash())));
 	}
 
-	void runcore()
+	bool load_hdd()
 	{
-	    core.debugoutput();
-	    core.runinstruction();
+	    // Directories are presented to the guest as a FAT volume
+	    if (BeeFatDrive::isdirectory(hdd_name))
+	    {
+		hard_disk = &fat_drive;
+		return fat_drive.open(hdd_name);
+	    }
+
+	    hard_disk = &disk_c;
+	    disk_c.use_writeback = (use_writeback && !use_overlay);
+
+	    if (!disk_c.open(hdd_name))
+	    {
+		return false;
+	    }
+
+	    return ((overlay_dir == "") || disk_c.openoverlay(getoverlayname(hdd_name, disk_c.gethash())));
 	}
 
-	uint8_t readByte(uint32_t addr)
+	// Overlays are named after their disk image, the instance and the image's hash
+	// (i.e. DIR/disk.img.0.0123456789abcdef.overlay), so images with the same name,
+	// and machines running at the same time, never share one
+	//
+	// They're only kept in memory if no directory was given
+	string getoverlayname(string image_name, uint64_t image_hash)
 	{
-	    uint8_t data = 0;
+	    if (overlay_dir == "")
+	    {
+		return "";
+	    }
+
+	    size_t slash_pos = image_name.find_last_of("/\\");
+	    string base_name = (slash_pos == string::npos) ? image_name : image_name.substr(slash_pos + 1);
+	    stringstream name;
+	    name << overlay_dir << "/" << base_name << "." << dec << instance_id << ".";
+	    name << hex << setw(16) << setfill('0') << image_hash << ".overlay";
+	    return name.str();
+	}
 
-	    if (inRangeAddr(addr, bios_entry.addr, bios_entry.size))
+	void runcore()
+	{
+	    if (replay_name != "")
+	    {
+		runreplay();
+	    }
+	    else if (gdb_stub)
 	    {
-		data = bios.at((addr - bios_entry.addr));
+		// When GDB is attached, it takes care of inspecting the CPU,
+		// so run a whole slice at full speed instead of tracing each instruction
+		// (through the scheduler, so device events still run on the cycle they're due)
+		gdb_stub->run(cycles_per_slice);
 	    }
 	    else
 	    {
-		data = memory.at(addr);
+		runframe();
 	    }
-
-	    return data;
 	}
 
-	void writeByte(uint32_t addr, uint8_t data)
+	// Runs the CPU for one frame of the display (about 95,800 cycles for the MDA's 50 Hz)
+	void runframe()
 	{
-	    if (inRangeAddr(addr, bios_entry.addr, bios_entry.size))
+	    uint64_t frame_cycles = video->getframecycles();
+
+	    if (!is_tracing)
 	    {
+		scheduler.runcycles(int(frame_cycles));
 		return;
 	    }
-	    else
+
+	    uint64_t end_cycles = (core.getcycles() + frame_cycles);
+
+	    while (core.getcycles() < end_cycles)
 	    {
-		memory.at(addr) = data;
+		// An instruction that's being repeated (i.e. INT 13h waiting on the disk) is only printed the first time
+		if (!core.isrepeating())
+		{
+		    core.debugoutput();
+		}
+
+		core.runinstruction();
+		scheduler.runevents();
 	    }
 	}
 
+	uint8_t readByte(uint32_t addr)
+	{
+	    return memory_map.readByte(addr);
+	}
+
+	void writeByte(uint32_t addr, uint8_t data)
+	{
+	    memory_map.writeByte(addr, data);
+	}
+
+	void readBlock(uint32_t addr, uint8_t *data, size_t size)
+	{
+	    memory_map.readBlock(addr, data, size);
+	}
+
+	void writeBlock(uint32_t addr, const uint8_t *data, size_t size)
+	{
+	    memory_map.writeBlock(addr, data, size);
+	}
+
 	uint8_t portIn(uint16_t port)
 	{
 	    uint8_t data = 0;
 
+	    if (dma.isport(port))
+	    {
+		return dma.readPort(port);
+	    }
+
+	    if (fdc.isport(port))
+	    {
+		return fdc.readPort(port);
+	    }
+
+	    if (pic.isport(port))
+	    {
+		return pic.readPort(port);
+	    }
+
 	    switch (port)
 	    {
+		case 0x3B5: data = mono_display.readData(); break;
+		case 0x3BA: data = mono_display.readStatus(); break;
+		case 0x3D5: data = color_display.readData(); break;
+		case 0x3DA: data = color_display.readStatus(); break;
 		default:
 		{
 		    cout << "Reading from port of " << hex << (int)(port) << endl;
@@ -216,12 +765,35 @@ class SDL2Frontend : public Bee8086Interface
 
 	void portOut(uint16_t port, uint8_t data)
 	{
+	    if (dma.isport(port))
+	    {
+		dma.writePort(port, data);
+		return;
+	    }
+
+	    if (fdc.isport(port))
+	    {
+		fdc.writePort(port, data);
+		return;
+	    }
+
+	    if (pic.isport(port))
+	    {
+		pic.writePort(port, data);
+		return;
+	    }
+
 	    switch (port)
 	    {
 		case 0x063: break;
 		case 0x0A0: break;
+		case 0x3B4: mono_display.writeReg(data); break;
+		case 0x3B5: mono_display.writeData(data); break;
 		case 0x3B8: mono_display.writeControl(data); break;
-		case 0x3D8: break;
+		case 0x3D4: color_display.writeReg(data); break;
+		case 0x3D5: color_display.writeData(data); break;
+		case 0x3D8: color_display.writeMode(data); break;
+		case 0x3D9: color_display.writeColor(data); break;
 		case 0x4F8:
 		{
 		    is_unimp_int = true;
@@ -246,6 +818,16 @@ class SDL2Frontend : public Bee8086Interface
 	    }
 	}
 
+	bool isInterruptPending()
+	{
+	    return pic.ispending();
+	}
+
+	uint8_t acknowledgeInterrupt()
+	{
+	    return pic.acknowledge();
+	}
+
 	bool isInterruptOverride(uint8_t int_num)
 	{
 	    return ((int_num == 0x13) | use_custom_bios);
@@ -272,6 +854,29 @@ class SDL2Frontend : public Bee8086Interface
 		break;
 		case 0x13:
 		{
+		    // The guest is waiting on a disk request
+		    if (disk_request)
+		    {
+			// Any other call (i.e. from an interrupt handler) can't wait on the drive
+			// until the request's finished, so it gets told the drive isn't ready
+			if ((service_num != disk_request->service_num) || (state.get_dl() != disk_request->drive_num))
+			{
+			    state.set_ah(0xAA);
+			    state.set_cf(true);
+			    break;
+			}
+
+			finishDiskRequest(state);
+			break;
+		    }
+
+		    // Drives 0x80 and up are hard disks
+		    if (state.get_dl() & 0x80)
+		    {
+			hardDiskService(state, service_num);
+			break;
+		    }
+
 		    switch (service_num)
 		    {
 			case 0:
@@ -296,7 +901,9 @@ class SDL2Frontend : public Bee8086Interface
 				exit(1);
 			    }
 
-			    if (!disk_a.seek(cylinder_num, head_num, sector_num))
+			    uint32_t lba = disk_a.toLBA(cylinder_num, head_num, sector_num);
+
+			    if ((sector_num == 0) || !disk_a.isvalid(lba))
 			    {
 				cout << "Invalid seek" << endl;
 				exit(1);
@@ -308,31 +915,49 @@ class SDL2Frontend : public Bee8086Interface
 				exit(1);
 			    }
 
-			    uint32_t sector_addr = convertSeg(state.get_es(), state.get_bx());
+			    startDiskRequest(state, false, false, lba, num_sectors);
+			}
+			break;
+			case 3:
+			{
+			    size_t num_sectors = state.get_al();
+			    uint16_t cylinder_temp = state.get_cx();
+			    size_t cylinder_num = ((cylinder_temp >> 8) | ((cylinder_temp & 0xC0) << 2));
+			    size_t sector_num = (cylinder_temp & 0x3F);
 
-			    size_t num_sectors_read = 0;
+			    size_t head_num = state.get_dh();
+			    size_t drive_num = state.get_dl();
 
-			    for (size_t i = 0; i < num_sectors; i++)
+			    if (drive_num != 0)
 			    {
-				vector<uint8_t> sector_vec = disk_a.readSector();
+				cout << "Invalid drive number of " << hex << int(drive_num) << endl;
+				exit(1);
+			    }
 
-				if (sector_vec.empty())
-				{
-				    break;
-				}
+			    uint32_t lba = disk_a.toLBA(cylinder_num, head_num, sector_num);
 
-				for (size_t j = 0; j < sector_vec.size(); j++)
-				{
-				    size_t sector_offs = ((num_sectors_read * 512) + j);
-				    writeByte((sector_addr + sector_offs), sector_vec.at(j));
-				}
+			    if ((sector_num == 0) || !disk_a.isvalid(lba))
+			    {
+				cout << "Invalid seek" << endl;
+				exit(1);
+			    }
 
-				num_sectors_read += 1;
+			    if (num_sectors == 0)
+			    {
+				cout << "Invalid sector number" << endl;
+				exit(1);
 			    }
 
-			    state.set_ah(0);
-			    state.set_al(num_sectors_read);
-			    state.set_cf(false);
+			    if (disk_a.isreadonly())
+			    {
+				// Write protected
+				state.set_ah(0x03);
+				state.set_al(0);
+				state.set_cf(true);
+				break;
+			    }
+
+			    startDiskRequest(state, false, true, lba, num_sectors);
 			}
 			break;
 			default:
@@ -353,24 +978,197 @@ class SDL2Frontend : public Bee8086Interface
 	    }
 	}
 
-	vector<uint8_t> loadfile(string filename)
+	// Starts a transfer of "num_sectors" sectors at "lba" between ES:BX and the floppy (or the hard disk),
+	// which runs on the disk I/O worker
+	//
+	// The drive's IRQ is raised once the drive would have finished the transfer (going by its mechanical timing),
+	// and until then, INT 13h is set up to run again, so the guest keeps running (and taking interrupts) while it waits
+	void startDiskRequest(Bee8086 &state, bool is_hard_disk, bool is_write, uint32_t lba, size_t num_sectors)
 	{
-	    vector<uint8_t> temp;
-	    ifstream file(filename.c_str(), ios::in | ios::binary | ios::ate);
-	    
-	    if (!file.is_open())
+	    auto request = make_shared<DiskRequest>();
+	    request->service_num = state.get_ah();
+	    request->drive_num = state.get_dl();
+	    request->addr = convertSeg(state.get_es(), state.get_bx());
+	    request->num_sectors = num_sectors;
+	    request->is_write = is_write;
+	    request->buffer.resize(num_sectors * 512);
+
+	    if (is_write)
 	    {
-		cout << "Error: could not load " << filename << endl;
-		return temp;
+		state.readmemory(request->addr, request->buffer.data(), request->buffer.size());
 	    }
 
-	    streampos size = file.tellg();
-	    temp.resize(size, 0);
-	    file.seekg(0, ios::beg);
-	    file.read((char*)temp.data(), size);
-	    cout << filename << " succesfully loaded." << endl;
-	    file.close();
-	    return temp;
+	    // The request outlives its job (it isn't dropped until the job's finished)
+	    uint8_t *buffer = request->buffer.data();
+
+	    request->io = disk_io.submit([this, is_hard_disk, is_write, lba, num_sectors, buffer]() -> size_t
+	    {
+		if (is_hard_disk)
+		{
+		    return is_write ? hard_disk->writeSectors(lba, num_sectors, buffer) : hard_disk->readSectors(lba, num_sectors, buffer);
+		}
+
+		if (is_write)
+		{
+		    return disk_a.writeSectors(lba, num_sectors, buffer);
+		}
+
+		BeeSectorSpan sectors = disk_a.readSectors(lba, num_sectors);
+		memcpy(buffer, sectors.data, sectors.size);
+		return ((sectors.size + 511) / 512);
+	    });
+
+	    // The PC/XT's fixed disk controller uses IRQ 5, and the floppy controller uses IRQ 6
+	    int irq = is_hard_disk ? 5 : 6;
+	    uint64_t delay = 0;
+
+	    if (is_hard_disk)
+	    {
+		delay = hard_disk_timing.getdelay(state.getcycles(), lba, num_sectors, hard_disk->numheads, hard_disk->numsectors);
+	    }
+	    else
+	    {
+		delay = floppy_timing.getdelay(state.getcycles(), lba, num_sectors, disk_a.numheads, disk_a.numsectors);
+	    }
+
+	    // The deadline only depends on emulated time, so if the host hasn't finished the transfer by then,
+	    // the emulation waits for it (instead of the IRQ landing on a different cycle from run to run)
+	    scheduler.schedule(delay, [this, request, irq]()
+	    {
+		disk_io.wait(request->io);
+		request->is_deadline = true;
+		pic.raiseirq(irq);
+	    });
+
+	    disk_request = request;
+	    state.repeatinstruction();
+	}
+
+	void finishDiskRequest(Bee8086 &state)
+	{
+	    if (!disk_request->is_deadline)
+	    {
+		state.repeatinstruction();
+		return;
+	    }
+
+	    size_t num_sectors = disk_request->io->result;
+
+	    if (!disk_request->is_write)
+	    {
+		// Copy the whole run of sectors into memory in one go
+		state.writememory(disk_request->addr, disk_request->buffer.data(), min((num_sectors * 512), disk_request->buffer.size()));
+	    }
+
+	    bool is_complete = (num_sectors == disk_request->num_sectors);
+	    state.set_ah(is_complete ? 0x00 : 0x04);
+	    state.set_al(num_sectors);
+	    state.set_cf(!is_complete);
+	    disk_request.reset();
+	}
+
+	void hardDiskService(Bee8086 &state, uint8_t service_num)
+	{
+	    size_t drive_num = state.get_dl();
+
+	    // Only a single hard disk is supported
+	    if ((drive_num != 0x80) || (hard_disk == NULL) || !hard_disk->isopen())
+	    {
+		state.set_ah(0x01);
+		state.set_cf(true);
+		return;
+	    }
+
+	    switch (service_num)
+	    {
+		case 0x00:
+		{
+		    state.set_ah(0);
+		    state.set_cf(false);
+		}
+		break;
+		case 0x02:
+		{
+		    size_t num_sectors = state.get_al();
+		    uint16_t cylinder_temp = state.get_cx();
+		    size_t cylinder_num = ((cylinder_temp >> 8) | ((cylinder_temp & 0xC0) << 2));
+		    size_t sector_num = (cylinder_temp & 0x3F);
+		    size_t head_num = state.get_dh();
+
+		    uint32_t lba = hard_disk->toLBA(cylinder_num, head_num, sector_num);
+
+		    if ((sector_num == 0) || (num_sectors == 0) || !hard_disk->isvalid(lba))
+		    {
+			// Sector not found
+			state.set_ah(0x04);
+			state.set_al(0);
+			state.set_cf(true);
+			break;
+		    }
+
+		    startDiskRequest(state, true, false, lba, num_sectors);
+		}
+		break;
+		case 0x03:
+		{
+		    size_t num_sectors = state.get_al();
+		    uint16_t cylinder_temp = state.get_cx();
+		    size_t cylinder_num = ((cylinder_temp >> 8) | ((cylinder_temp & 0xC0) << 2));
+		    size_t sector_num = (cylinder_temp & 0x3F);
+		    size_t head_num = state.get_dh();
+
+		    uint32_t lba = hard_disk->toLBA(cylinder_num, head_num, sector_num);
+
+		    if ((sector_num == 0) || (num_sectors == 0) || !hard_disk->isvalid(lba))
+		    {
+			// Sector not found
+			state.set_ah(0x04);
+			state.set_al(0);
+			state.set_cf(true);
+			break;
+		    }
+
+		    if (hard_disk->isreadonly())
+		    {
+			// Write protected
+			state.set_ah(0x03);
+			state.set_al(0);
+			state.set_cf(true);
+			break;
+		    }
+
+		    startDiskRequest(state, true, true, lba, num_sectors);
+		}
+		break;
+		case 0x08:
+		{
+		    // Fetch drive parameters
+		    int max_cylinder = (min(hard_disk->numcylinders, 1024) - 1);
+		    state.set_ah(0);
+		    state.set_ch(max_cylinder & 0xFF);
+		    state.set_cl((hard_disk->numsectors & 0x3F) | ((max_cylinder >> 2) & 0xC0));
+		    state.set_dh(hard_disk->numheads - 1);
+		    state.set_dl(1);
+		    state.set_cf(false);
+		}
+		break;
+		case 0x15:
+		{
+		    // Fetch disk type (fixed disk, along with its number of sectors)
+		    uint32_t num_disk_sectors = uint32_t(min<uint64_t>(hard_disk->getsectorcount(), 0xFFFFFFFF));
+		    state.set_ah(0x03);
+		    state.set_cx(num_disk_sectors >> 16);
+		    state.set_dx(num_disk_sectors & 0xFFFF);
+		    state.set_cf(false);
+		}
+		break;
+		default:
+		{
+		    cout << "Unrecognized int 13h hard disk service number of " << hex << int(service_num) << endl;
+		    exit(1);
+		}
+		break;
+	    }
 	}
 
 	uint32_t convertSeg(uint16_t seg, uint16_t offs)
@@ -392,26 +1190,142 @@ class SDL2Frontend : public Bee8086Interface
 	    return ((addr >= low) && (addr < high));
 	}
 
+	// Replays the recording in whole slices (without any debug output),
+	// and prints how long it took once the end of the recording is reached
+	void runreplay()
+	{
+	    if (replay_cycles == 0)
+	    {
+		replay_start = chrono::steady_clock::now();
+	    }
+
+	    uint64_t end_cycles = recorder->getendcycles();
+
+	    if (core.getcycles() < end_cycles)
+	    {
+		replay_cycles += scheduler.runcycles(int(min<uint64_t>(cycles_per_slice, (end_cycles - core.getcycles()))));
+		return;
+	    }
+
+	    double seconds = chrono::duration<double>(chrono::steady_clock::now() - replay_start).count();
+	    cout << "Replay finished: " << dec << core.getinstrcount() << " instructions, " << core.getcycles() << " cycles in " << seconds << " seconds";
+
+	    if (seconds > 0)
+	    {
+		cout << " (" << ((core.getinstrcount() / seconds) / 1000000.0) << " MIPS)";
+	    }
+
+	    cout << endl;
+
+	    if (recorder->isdesynced() || (core.getinstrcount() != recorder->getendinstrs()))
+	    {
+		cout << "Warning: replay did not match the recording" << endl;
+	    }
+
+	    is_replay_finished = true;
+	}
+
 	template<typename T>
 	bool inRangeAddr(T addr, int start, int size)
 	{
 	    return inRange(addr, start, (start + size));
 	}
 
-	vector<uint8_t> memory;
-	vector<uint8_t> bios;
+	Bee8086BlobRef bios_blob;
+	Bee8086MemoryMap memory_map;
 	array<uint8_t, 0x10> biosdata;
 
 	string bios_name = "";
 	string floppy_name = "";
+	string hdd_name = "";
+	string overlay_dir = "";
+	bool use_overlay = false;
+	unsigned long instance_id = 0;
+	bool use_commit = false;
+	bool use_writeback = false;
 
 	Bee8086 core;
+	Bee8086Scheduler scheduler{core};
+
+	unique_ptr<Bee8086GDBStub> gdb_stub;
+	string gdb_address = "";
+
+	unique_ptr<Bee8086TimeTravel> time_travel;
+	bool use_time_travel = false;
+
+	unique_ptr<Bee8086Recorder> recorder;
+	string record_name = "";
+	string replay_name = "";
+	uint64_t replay_cycles = 0;
+	chrono::steady_clock::time_point replay_start;
+	bool is_replay_finished = false;
+
+	// Number of cycles to run for between GDB checks (one 60 Hz frame at 4.77 MHz)
+	const int cycles_per_slice = (4772727 / 60);
+
+	// The CPU runs at 4.77 MHz (i.e. 14.318 MHz / 3)
+	const uint64_t cpu_clock = 4772727;
+
+	// The hotkeys are handled on the main thread, while the CPU runs on its own thread
+	atomic<bool> is_turbo{false};
+	atomic<bool> is_tracing{false};
+	atomic<bool> is_quitting{false};
+	bool is_pacing_started = false;
+	chrono::steady_clock::time_point next_frame_time;
 
 	BeeFloppy disk_a;
-	BeeMDA mono_display;
+	BeeHardDisk disk_c;
+	BeeFatDrive fat_drive;
+
+	// Whichever of the above is attached as the first hard disk
+	BeeDisk *hard_disk = NULL;
+
+	struct DiskRequest
+	{
+	    BeeDiskIO::RequestRef io;
+	    uint8_t service_num = 0; // AH and DL of the INT 13h call that started the request
+	    uint8_t drive_num = 0;
+	    vector<uint8_t> buffer;
+	    uint32_t addr = 0;
+	    size_t num_sectors = 0;
+	    bool is_write = false;
+	    bool is_deadline = false;
+	};
+
+	BeeDiskIO disk_io;
+	shared_ptr<DiskRequest> disk_request;
+
+	// Mechanical timing of the drives, which decides when each request completes:
+	// a 300 RPM floppy drive stepping at 6 ms per track (with 15 ms to settle),
+	// and a 3600 RPM hard disk averaging about 85 ms per seek (like the XT's ST-412)
+	BeeDiskTiming floppy_timing{cpu_clock, 300, 6000, 15000, 500000};
+	BeeDiskTiming hard_disk_timing{cpu_clock, 3600, 800, 3000, 150000};
+
+	BeePIC pic;
+	BeeMDA mono_display{memory_map, scheduler, mda_rom};
+	BeeCGA color_display{memory_map, scheduler, mda_rom};
+
+	// Whichever of the above is shown in the window
+	BeeVideo *video = NULL;
+	bool use_cga = false;
+
+	BeeHeadless headless;
+	bool use_headless = false;
+	string expected_hash = "";
+	uint64_t max_frames = 0;
+	uint64_t frame_count = 0;
+	bool is_frames_finished = false;
+	int exit_code = 0;
+
+	BeeCapture capture;
+	string capture_name = "";
+	BeeDMA dma{memory_map, scheduler};
+
+	// Floppy controller for drive A:, for BIOSes that drive it themselves instead of going through INT 13h
+	BeeFDC fdc{disk_a, disk_io, dma, pic, cpu_clock};
 
 	SDL_Window *window = NULL;
-	SDL_Surface *surface = NULL;
+	BeeRenderer renderer;
 
 	struct biosentry
 	{
@@ -449,7 +1363,7 @@ int main(int argc, char *argv[])
 	return 1;
     }
 
-    while (core.run());
+    core.run();
     core.shutdown();
-    return 0; 
+    return core.getexitcode();
 }
\ No newline at end of file
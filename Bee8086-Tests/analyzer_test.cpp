@@ -0,0 +1,141 @@
+#include <vector>
+#include <sstream>
+#include <cstdint>
+#include <Bee8086/analyzer.h>
+#include "beetest.h"
+using namespace bee8086;
+using namespace std;
+
+// Maps a boot sector at 0000:7C00 into an otherwise empty address space
+class BootInterface : public Bee8086Interface
+{
+    public:
+	BootInterface(vector<uint8_t> code) : image(code)
+	{
+	    image.resize(512, 0x00);
+	}
+
+	uint8_t readByte(uint32_t addr)
+	{
+	    uint32_t offs = ((addr & 0xFFFFF) - 0x7C00);
+	    return (offs < image.size()) ? image[offs] : 0x00;
+	}
+
+	void writeByte(uint32_t addr, uint8_t val)
+	{
+	    return;
+	}
+
+	uint8_t portIn(uint16_t port)
+	{
+	    return 0xFF;
+	}
+
+	void portOut(uint16_t port, uint8_t val)
+	{
+	    return;
+	}
+
+	bool isInterruptOverride(uint8_t int_num)
+	{
+	    return false;
+	}
+
+	void interruptOverride(Bee8086 &state, uint8_t int_num)
+	{
+	    return;
+	}
+
+	uint32_t convertSeg(uint16_t seg, uint16_t offs)
+	{
+	    return (((seg << 4) + offs) & 0xFFFFF);
+	}
+
+    private:
+	vector<uint8_t> image;
+};
+
+// Every successor (and every call target that was decoded) has to be the start of a block
+void checkgraph(Bee8086Analyzer &analyzer)
+{
+    auto &blocks = analyzer.getblocks();
+
+    for (auto &it : blocks)
+    {
+	for (auto succ : it.second.successors)
+	{
+	    BEE_CHECK(blocks.count(succ) != 0);
+	}
+    }
+
+    for (auto &it : analyzer.getfunctions())
+    {
+	for (auto addr : it.second.blocks)
+	{
+	    BEE_CHECK(blocks.count(addr) != 0);
+	}
+    }
+
+    stringstream dot;
+    stringstream json;
+    analyzer.exportdot(dot);
+    analyzer.exportjson(json);
+    BEE_CHECK(!dot.str().empty());
+    BEE_CHECK(!json.str().empty());
+}
+
+// A branch into the middle of an instruction, with both paths converging on the same code
+//
+// 7C00: jz 7C03 / 7C02: mov al, 40h / 7C03: inc ax (the second byte of the mov) / 7C04: hlt / 7C05: ret
+void testoverlapping()
+{
+    BootInterface inter({0x74, 0x01, 0xB0, 0x40, 0xF4, 0xC3});
+    Bee8086Analyzer analyzer;
+    analyzer.setinterface(&inter);
+    analyzer.addentry(0x0000, 0x7C00);
+    analyzer.analyze();
+
+    auto &blocks = analyzer.getblocks();
+    BEE_CHECK(blocks.count(0x7C02) != 0);
+    BEE_CHECK(blocks.count(0x7C03) != 0);
+    BEE_CHECK(blocks.count(0x7C04) != 0);
+
+    if (blocks.count(0x7C02) != 0)
+    {
+	BEE_CHECK(blocks.at(0x7C02).num_instrs == 1);
+    }
+
+    checkgraph(analyzer);
+}
+
+// A backward jump into the middle of a block that was already built
+//
+// 7C00: mov al, 1 / 7C02: inc ax / 7C03: inc ax / 7C04: jmp 7C03
+void testconverging()
+{
+    BootInterface inter({0xB0, 0x01, 0x40, 0x40, 0xEB, 0xFD});
+    Bee8086Analyzer analyzer;
+    analyzer.setinterface(&inter);
+    analyzer.addentry(0x0000, 0x7C00);
+    analyzer.analyze();
+
+    auto &blocks = analyzer.getblocks();
+    BEE_CHECK(blocks.count(0x7C00) != 0);
+    BEE_CHECK(blocks.count(0x7C03) != 0);
+
+    if (blocks.count(0x7C00) != 0)
+    {
+	const Bee8086Block &block = blocks.at(0x7C00);
+	BEE_CHECK(block.num_instrs == 2);
+	BEE_CHECK((block.successors.size() == 1) && (block.successors[0] == 0x7C03));
+    }
+
+    checkgraph(analyzer);
+}
+
+int main(int argc, char *argv[])
+{
+    testoverlapping();
+    testconverging();
+    return beeresult("analyzer_test");
+}
\ No newline at end of file
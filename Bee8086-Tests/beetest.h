@@ -0,0 +1,34 @@
+#ifndef BEETEST_H
+#define BEETEST_H
+
+#include <iostream>
+#include <string>
+using namespace std;
+
+// Minimal test harness: each test counts its failed checks, and main() returns non-zero if there were any
+static int num_failures = 0;
+
+#define BEE_CHECK(cond) beecheck((cond), #cond, __FILE__, __LINE__)
+
+inline void beecheck(bool cond, const char *text, const char *file, int line)
+{
+    if (!cond)
+    {
+	cout << file << ":" << line << ": check failed: " << text << endl;
+	num_failures += 1;
+    }
+}
+
+inline int beeresult(string name)
+{
+    if (num_failures != 0)
+    {
+	cout << name << ": " << num_failures << " check(s) failed" << endl;
+	return 1;
+    }
+
+    cout << name << ": all checks passed" << endl;
+    return 0;
+}
+
+#endif // BEETEST_H
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <Bee8086/bee8086.h>
+#include <Bee8086/memorymap.h>
+#include <Bee8086/scheduler.h>
+#include <Bee8086-SDL2/beedma.h>
+#include "beetest.h"
+using namespace bee8086;
+using namespace beedma;
+using namespace std;
+
+// CPU running a long run of INC AX (3 cycles each) at 1000:0000, with the first 64 KB as RAM for transfers
+//
+// Every instruction takes the same number of cycles, so an event lands exactly on its cycle
+// as long as that's a multiple of 3
+class DMAMachine : public Bee8086Interface
+{
+    public:
+	DMAMachine() : ram(0x10000, 0x00), code(0x10000, 0x40)
+	{
+	    memory_map.addregions({
+		{"RAM", 0x00000, 0x10000, Bee8086MemoryRegion::RAM, ram.data()},
+		{"Code", 0x10000, 0x10000, Bee8086MemoryRegion::ROM, code.data()},
+	    });
+
+	    core.setinterface(this);
+	    core.init(0x1000, 0x0000);
+	}
+
+	uint8_t readByte(uint32_t addr)
+	{
+	    return memory_map.readByte(addr);
+	}
+
+	void writeByte(uint32_t addr, uint8_t val)
+	{
+	    memory_map.writeByte(addr, val);
+	}
+
+	uint8_t portIn(uint16_t port)
+	{
+	    return dma.readPort(port);
+	}
+
+	void portOut(uint16_t port, uint8_t val)
+	{
+	    dma.writePort(port, val);
+	}
+
+	bool isInterruptOverride(uint8_t int_num)
+	{
+	    return false;
+	}
+
+	void interruptOverride(Bee8086 &state, uint8_t int_num)
+	{
+	    return;
+	}
+
+	uint32_t convertSeg(uint16_t seg, uint16_t offs)
+	{
+	    return (((seg << 4) + offs) & 0xFFFFF);
+	}
+
+	// Programs channel 2 to write "count" bytes to memory at "addr" (in the first 64 KB) and unmasks it
+	void programchannel(uint16_t addr, uint16_t count, uint8_t mode = 0x46)
+	{
+	    dma.writePort(0x0A, 0x06);
+	    dma.writePort(0x0C, 0x00);
+	    dma.writePort(0x0B, mode);
+	    dma.writePort(0x04, (addr & 0xFF));
+	    dma.writePort(0x04, (addr >> 8));
+	    dma.writePort(0x81, 0x00);
+	    dma.writePort(0x05, ((count - 1) & 0xFF));
+	    dma.writePort(0x05, ((count - 1) >> 8));
+	    dma.writePort(0x0A, 0x02);
+	}
+
+	vector<uint8_t> ram;
+	vector<uint8_t> code;
+	Bee8086 core;
+	Bee8086MemoryMap memory_map;
+	Bee8086Scheduler scheduler{core};
+	BeeDMA dma{memory_map, scheduler};
+};
+
+// A programmed channel moves the whole block at the cycle its transfer would have finished, and not before
+void testcompletion()
+{
+    DMAMachine machine;
+    machine.programchannel(0x2000, 512);
+    machine.scheduler.runcycles(30);
+
+    vector<uint8_t> buffer(512);
+
+    for (size_t index = 0; index < buffer.size(); index++)
+    {
+	buffer[index] = uint8_t(index * 7);
+    }
+
+    uint64_t start = machine.core.getcycles();
+    uint64_t due = (start + (buffer.size() * 9));
+    uint64_t done_cycle = 0;
+    size_t done_length = 0;
+    bool done_tc = false;
+
+    bool is_started = machine.dma.request(2, buffer.data(), buffer.size(), 9, [&](size_t length, bool is_terminal_count)
+    {
+	done_cycle = machine.core.getcycles();
+	done_length = length;
+	done_tc = is_terminal_count;
+    });
+
+    BEE_CHECK(is_started);
+    BEE_CHECK((due % 3) == 0);
+    BEE_CHECK(machine.scheduler.getnextevent() == due);
+
+    // The channel's busy until then (with its request bit set), and memory is untouched
+    BEE_CHECK(!machine.dma.request(2, buffer.data(), buffer.size(), 9, nullptr));
+    machine.scheduler.runcycles(int((due - start) - 3));
+    BEE_CHECK(done_cycle == 0);
+    BEE_CHECK(machine.ram[0x2000] == 0x00);
+    BEE_CHECK((machine.dma.readPort(0x08) & 0x40) != 0);
+
+    machine.scheduler.runcycles(3);
+    BEE_CHECK(done_cycle == due);
+    BEE_CHECK(done_length == 512);
+    BEE_CHECK(done_tc);
+    BEE_CHECK(equal(buffer.begin(), buffer.end(), (machine.ram.begin() + 0x2000)));
+
+    // Reaching terminal count sets the channel's status bit, and (without autoinitialize) masks the channel
+    BEE_CHECK((machine.dma.readPort(0x08) & 0x44) == 0x04);
+    BEE_CHECK(machine.dma.ismasked(2));
+}
+
+// A transfer is cut short at the channel's terminal count, and nothing is moved on a masked channel
+void testterminalcount()
+{
+    DMAMachine machine;
+    vector<uint8_t> buffer(512, 0xAA);
+    BEE_CHECK(!machine.dma.request(2, buffer.data(), buffer.size(), 3, nullptr));
+
+    machine.programchannel(0x4000, 256);
+    size_t done_length = 0;
+
+    BEE_CHECK(machine.dma.request(2, buffer.data(), buffer.size(), 3, [&](size_t length, bool is_terminal_count)
+    {
+	done_length = length;
+    }));
+
+    machine.scheduler.runcycles(1000);
+    BEE_CHECK(done_length == 256);
+    BEE_CHECK(machine.ram[0x40FF] == 0xAA);
+    BEE_CHECK(machine.ram[0x4100] == 0x00);
+}
+
+int main(int argc, char *argv[])
+{
+    testcompletion();
+    testterminalcount();
+    return beeresult("dma_test");
+}
\ No newline at end of file
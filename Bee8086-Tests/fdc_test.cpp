@@ -0,0 +1,216 @@
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <Bee8086/bee8086.h>
+#include <Bee8086/memorymap.h>
+#include <Bee8086/scheduler.h>
+#include <Bee8086-SDL2/beefdc.h>
+#include "beetest.h"
+using namespace bee8086;
+using namespace beedma;
+using namespace beepic;
+using namespace beefdc;
+using namespace std;
+
+// CPU running a long run of INC AX at 1000:0000, with the first 64 KB as RAM for transfers,
+// and a 360 KB floppy in drive A: (where every byte of a sector holds its LBA)
+class FDCMachine : public Bee8086Interface
+{
+    public:
+	FDCMachine() : ram(0x10000, 0x00), code(0x10000, 0x40)
+	{
+	    memory_map.addregions({
+		{"RAM", 0x00000, 0x10000, Bee8086MemoryRegion::RAM, ram.data()},
+		{"Code", 0x10000, 0x10000, Bee8086MemoryRegion::ROM, code.data()},
+	    });
+
+	    core.setinterface(this);
+	    core.init(0x1000, 0x0000);
+
+	    ofstream file(image_name.c_str(), ios::binary);
+
+	    for (int lba = 0; lba < 720; lba++)
+	    {
+		vector<char> sector(512, char(lba));
+		file.write(sector.data(), sector.size());
+	    }
+
+	    file.close();
+	    floppy.open(image_name);
+	    disk_io.start();
+
+	    // Single PIC with its vectors at 08h, and nothing masked
+	    pic.writePort(0x20, 0x13);
+	    pic.writePort(0x21, 0x08);
+	    pic.writePort(0x21, 0x09);
+	}
+
+	~FDCMachine()
+	{
+	    disk_io.stop();
+	    floppy.close();
+	    remove(image_name.c_str());
+	}
+
+	uint8_t readByte(uint32_t addr)
+	{
+	    return memory_map.readByte(addr);
+	}
+
+	void writeByte(uint32_t addr, uint8_t val)
+	{
+	    memory_map.writeByte(addr, val);
+	}
+
+	uint8_t portIn(uint16_t port)
+	{
+	    return fdc.isport(port) ? fdc.readPort(port) : dma.readPort(port);
+	}
+
+	void portOut(uint16_t port, uint8_t val)
+	{
+	    if (fdc.isport(port))
+	    {
+		fdc.writePort(port, val);
+		return;
+	    }
+
+	    dma.writePort(port, val);
+	}
+
+	bool isInterruptOverride(uint8_t int_num)
+	{
+	    return false;
+	}
+
+	void interruptOverride(Bee8086 &state, uint8_t int_num)
+	{
+	    return;
+	}
+
+	uint32_t convertSeg(uint16_t seg, uint16_t offs)
+	{
+	    return (((seg << 4) + offs) & 0xFFFFF);
+	}
+
+	void sendcommand(vector<uint8_t> bytes)
+	{
+	    for (auto data : bytes)
+	    {
+		BEE_CHECK((portIn(0x3F4) & 0xC0) == 0x80);
+		portOut(0x3F5, data);
+	    }
+	}
+
+	vector<uint8_t> readresult()
+	{
+	    vector<uint8_t> bytes;
+
+	    while ((portIn(0x3F4) & 0xC0) == 0xC0)
+	    {
+		bytes.push_back(portIn(0x3F5));
+	    }
+
+	    return bytes;
+	}
+
+	// Returns true if IRQ 6 is waiting (and acknowledges it)
+	bool takeirq()
+	{
+	    if (!pic.ispending() || (pic.acknowledge() != 0x0E))
+	    {
+		return false;
+	    }
+
+	    pic.writePort(0x20, 0x20);
+	    return true;
+	}
+
+	string image_name = "fdc_test.img";
+	vector<uint8_t> ram;
+	vector<uint8_t> code;
+	Bee8086 core;
+	Bee8086MemoryMap memory_map;
+	Bee8086Scheduler scheduler{core};
+	BeeFloppy floppy;
+	BeeDiskIO disk_io;
+	BeePIC pic;
+	BeeDMA dma{memory_map, scheduler};
+	BeeFDC fdc{floppy, disk_io, dma, pic, 4772727};
+};
+
+// Resets the controller, and then reads a sector through DMA channel 2 the way the PC/XT BIOS does
+void testread()
+{
+    FDCMachine machine;
+
+    // Leaving reset interrupts, with a Sense Interrupt Status owed to each drive
+    machine.portOut(0x3F2, 0x00);
+    machine.portOut(0x3F2, 0x1C);
+    BEE_CHECK(machine.takeirq());
+
+    for (int drive = 0; drive < 4; drive++)
+    {
+	machine.sendcommand({0x08});
+	vector<uint8_t> result = machine.readresult();
+	BEE_CHECK((result.size() == 2) && (result[0] == (0xC0 | drive)));
+    }
+
+    // Seek to cylinder 1
+    machine.sendcommand({0x0F, 0x00, 0x01});
+    BEE_CHECK(machine.takeirq());
+    machine.sendcommand({0x08});
+    BEE_CHECK(machine.readresult() == vector<uint8_t>({0x20, 0x01}));
+
+    // Read C/H/S 1/1/3 (LBA 29) into 0000:3000
+    machine.dma.writePort(0x0A, 0x06);
+    machine.dma.writePort(0x0C, 0x00);
+    machine.dma.writePort(0x0B, 0x46);
+    machine.dma.writePort(0x04, 0x00);
+    machine.dma.writePort(0x04, 0x30);
+    machine.dma.writePort(0x81, 0x00);
+    machine.dma.writePort(0x05, 0xFF);
+    machine.dma.writePort(0x05, 0x01);
+    machine.dma.writePort(0x0A, 0x02);
+    machine.sendcommand({0x46, 0x04, 0x01, 0x01, 0x03, 0x02, 0x03, 0x2A, 0xFF});
+
+    // The controller stays busy until the transfer has taken as long as the drive would have
+    BEE_CHECK(machine.portIn(0x3F4) == 0x10);
+    uint64_t due = machine.scheduler.getnextevent();
+    BEE_CHECK(due == (machine.core.getcycles() + (512 * ((4772727 * 8) / 250000))));
+
+    machine.scheduler.runcycles(int(due - machine.core.getcycles()) - 3);
+    BEE_CHECK(machine.ram[0x3000] == 0x00);
+    BEE_CHECK(!machine.takeirq());
+
+    machine.scheduler.runcycles(10);
+    BEE_CHECK(machine.takeirq());
+    BEE_CHECK(machine.ram[0x3000] == 29);
+    BEE_CHECK(machine.ram[0x31FF] == 29);
+    BEE_CHECK(machine.ram[0x3200] == 0x00);
+
+    // The result points at the sector after the end of the track
+    BEE_CHECK(machine.readresult() == vector<uint8_t>({0x04, 0x00, 0x00, 0x02, 0x01, 0x01, 0x02}));
+    BEE_CHECK(machine.portIn(0x3F4) == 0x80);
+}
+
+// A transfer without a programmed DMA channel fails, instead of hanging the controller
+void testnodma()
+{
+    FDCMachine machine;
+    machine.portOut(0x3F2, 0x1C);
+    BEE_CHECK(machine.takeirq());
+
+    machine.sendcommand({0x46, 0x00, 0x00, 0x00, 0x01, 0x02, 0x01, 0x2A, 0xFF});
+    vector<uint8_t> result = machine.readresult();
+    BEE_CHECK((result.size() == 7) && (result[0] == 0x40) && (result[1] == 0x10));
+    BEE_CHECK(machine.takeirq());
+}
+
+int main(int argc, char *argv[])
+{
+    testread();
+    testnodma();
+    return beeresult("fdc_test");
+}
\ No newline at end of file
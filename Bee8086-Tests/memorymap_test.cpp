@@ -0,0 +1,47 @@
+#include <vector>
+#include <cstdint>
+#include <Bee8086/memorymap.h>
+#include "beetest.h"
+using namespace bee8086;
+using namespace std;
+
+// Fetching dirty ranges (like the video adapters do) and dirty pages (like time-travel checkpoints do)
+// each see every write, whichever of them fetches first
+void testdirtyviews()
+{
+    Bee8086MemoryMap memory_map;
+    memory_map.addregions({
+	{"RAM", 0x00000, 0xA0000, Bee8086MemoryRegion::SparseRAM},
+	{"VRAM", 0xB0000, 0x8000, Bee8086MemoryRegion::SparseRAM, NULL, 0x1000},
+    });
+
+    memory_map.writeByte(0xB1010, 0x41);
+    memory_map.writeByte(0x12345, 0x42);
+
+    // Pages first, and then the range
+    vector<uint32_t> pages = memory_map.fetchdirtypages();
+    BEE_CHECK(pages == vector<uint32_t>({0x12000, 0xB0000}));
+    BEE_CHECK(memory_map.fetchdirtypages().empty());
+    BEE_CHECK(memory_map.isdirty(0xB0000, 0x1000));
+    BEE_CHECK(memory_map.fetchdirty(0xB0000, 0x1000));
+    BEE_CHECK(!memory_map.fetchdirty(0xB0000, 0x1000));
+    BEE_CHECK(memory_map.fetchdirty(0x12300, 0x100));
+
+    // The range first, and then pages
+    memory_map.writeByte(0xB0020, 0x43);
+    BEE_CHECK(memory_map.fetchdirty(0xB0000, 0x1000));
+    BEE_CHECK(!memory_map.isdirty(0xB0000, 0x1000));
+    BEE_CHECK(memory_map.fetchdirtypages() == vector<uint32_t>({0xB0000}));
+
+    // Clearing drops both views
+    memory_map.writeByte(0x00010, 0x44);
+    memory_map.cleardirty();
+    BEE_CHECK(memory_map.fetchdirtypages().empty());
+    BEE_CHECK(!memory_map.fetchdirty(0x00000, 0x1000));
+}
+
+int main(int argc, char *argv[])
+{
+    testdirtyviews();
+    return beeresult("memorymap_test");
+}
\ No newline at end of file
@@ -0,0 +1,553 @@
+/*
+    This file is part of the Bee8086 engine.
+    Copyright (C) 2022 BueniaDev.
+
+    Bee8086 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bee8086 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bee8086.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "analyzer.h"
+#include <iomanip>
+using namespace bee8086;
+using namespace std;
+
+Bee8086Analyzer::Bee8086Analyzer()
+{
+
+}
+
+Bee8086Analyzer::~Bee8086Analyzer()
+{
+
+}
+
+// Set the interface guest code is read from
+void Bee8086Analyzer::setinterface(Bee8086Interface *cb)
+{
+    if (cb == NULL)
+    {
+	cout << "Error: new interface is NULL" << endl;
+	return;
+    }
+
+    inter = cb;
+    decoder.setinterface(cb);
+}
+
+void Bee8086Analyzer::addentry(uint16_t seg, uint16_t offs)
+{
+    Location loc;
+    loc.cs = seg;
+    loc.ip = offs;
+    entries.push_back(loc);
+}
+
+void Bee8086Analyzer::addivtentries()
+{
+    if (inter == NULL)
+    {
+	return;
+    }
+
+    set<uint32_t> vectors;
+
+    for (uint32_t int_num = 0; int_num < 256; int_num++)
+    {
+	uint16_t offs = readWord(int_num * 4);
+	uint16_t seg = readWord((int_num * 4) + 2);
+
+	// Skip unused vectors (and vectors we've already added)
+	if (((seg == 0) && (offs == 0)) || !vectors.insert(convertSeg(seg, offs)).second)
+	{
+	    continue;
+	}
+
+	addentry(seg, offs);
+    }
+}
+
+void Bee8086Analyzer::clear()
+{
+    entries.clear();
+    instrs.clear();
+    leaders.clear();
+    function_entries.clear();
+    call_sites.clear();
+    blocks.clear();
+    functions.clear();
+}
+
+void Bee8086Analyzer::analyze()
+{
+    if (inter == NULL)
+    {
+	cout << "Error: interface is NULL" << endl;
+	return;
+    }
+
+    traverse();
+    buildblocks();
+    buildfunctions();
+}
+
+const map<uint32_t, Bee8086Block> &Bee8086Analyzer::getblocks()
+{
+    return blocks;
+}
+
+const map<uint32_t, Bee8086Function> &Bee8086Analyzer::getfunctions()
+{
+    return functions;
+}
+
+uint32_t Bee8086Analyzer::convertSeg(uint16_t seg, uint16_t offs)
+{
+    return inter->convertSeg(seg, offs);
+}
+
+uint16_t Bee8086Analyzer::readWord(uint32_t addr)
+{
+    uint8_t lo_byte = inter->readByte(addr);
+    uint8_t hi_byte = inter->readByte(addr + 1);
+    return ((hi_byte << 8) | lo_byte);
+}
+
+// Decodes all code reachable from the entry points, marking the start of every basic block
+void Bee8086Analyzer::traverse()
+{
+    vector<Location> worklist;
+
+    auto add_target = [&](uint16_t seg, uint16_t offs) -> uint32_t
+    {
+	Location loc;
+	loc.cs = seg;
+	loc.ip = offs;
+
+	uint32_t addr = convertSeg(seg, offs);
+	leaders.insert(addr);
+	worklist.push_back(loc);
+	return addr;
+    };
+
+    auto add_call = [&](uint16_t seg, uint16_t offs) -> uint32_t
+    {
+	Location loc;
+	loc.cs = seg;
+	loc.ip = offs;
+
+	uint32_t addr = add_target(seg, offs);
+	function_entries[addr] = loc;
+	return addr;
+    };
+
+    for (auto &entry : entries)
+    {
+	uint32_t addr = add_target(entry.cs, entry.ip);
+	function_entries[addr] = entry;
+    }
+
+    while (!worklist.empty() && (instrs.size() < max_instrs))
+    {
+	Location loc = worklist.back();
+	worklist.pop_back();
+
+	// Decode the straight-line run of instructions starting at "loc",
+	// until we hit code we've already seen or the control flow stops falling through
+	bool is_fallthrough = true;
+
+	while (is_fallthrough && (instrs.size() < max_instrs))
+	{
+	    uint32_t addr = convertSeg(loc.cs, loc.ip);
+
+	    // Converging on already-decoded code starts a new block there
+	    // (buildblocks() splits whichever block it's in)
+	    if (instrs.count(addr) != 0)
+	    {
+		leaders.insert(addr);
+		break;
+	    }
+
+	    Instr instr;
+	    instr.cs = loc.cs;
+	    instr.ip = loc.ip;
+
+	    stringstream dasm_str;
+	    instr.length = decoder.disassembleinstr(dasm_str, addr, instr.flow);
+	    instr.text = dasm_str.str();
+	    instrs[addr] = instr;
+
+	    uint16_t next_ip = (loc.ip + instr.length);
+	    uint16_t target_ip = (next_ip + instr.flow.rel);
+	    uint32_t callee = 0;
+	    bool is_call = false;
+
+	    switch (instr.flow.type)
+	    {
+		case Bee8086FlowInfo::Next: break;
+		case Bee8086FlowInfo::Jump:
+		{
+		    add_target(loc.cs, target_ip);
+		    is_fallthrough = false;
+		}
+		break;
+		case Bee8086FlowInfo::JumpFar:
+		{
+		    add_target(instr.flow.target_cs, instr.flow.target_ip);
+		    is_fallthrough = false;
+		}
+		break;
+		case Bee8086FlowInfo::Branch: add_target(loc.cs, target_ip); break;
+		case Bee8086FlowInfo::Call:
+		{
+		    callee = add_call(loc.cs, target_ip);
+		    is_call = true;
+		}
+		break;
+		case Bee8086FlowInfo::CallFar:
+		{
+		    callee = add_call(instr.flow.target_cs, instr.flow.target_ip);
+		    is_call = true;
+		}
+		break;
+		case Bee8086FlowInfo::Interrupt:
+		{
+		    // Software interrupts call whatever handler is currently in the IVT
+		    uint32_t vector_addr = (instr.flow.int_num * 4);
+		    uint16_t int_ip = readWord(vector_addr);
+		    uint16_t int_cs = readWord(vector_addr + 2);
+
+		    if ((int_cs != 0) || (int_ip != 0))
+		    {
+			callee = add_call(int_cs, int_ip);
+			is_call = true;
+		    }
+		}
+		break;
+		case Bee8086FlowInfo::CallIndirect:
+		case Bee8086FlowInfo::Halt: break;
+		default: is_fallthrough = false; break;
+	    }
+
+	    if (is_call)
+	    {
+		call_sites[addr].push_back(callee);
+	    }
+
+	    // Any instruction that transfers control ends its block
+	    if (is_fallthrough && (instr.flow.type != Bee8086FlowInfo::Next))
+	    {
+		leaders.insert(convertSeg(loc.cs, next_ip));
+	    }
+
+	    loc.ip = next_ip;
+	}
+    }
+
+    if (instrs.size() >= max_instrs)
+    {
+	cout << "Warning: instruction limit reached, control-flow graph is incomplete" << endl;
+    }
+}
+
+vector<uint32_t> Bee8086Analyzer::gettargets(const Instr &instr)
+{
+    uint16_t next_ip = (instr.ip + instr.length);
+    uint16_t target_ip = (next_ip + instr.flow.rel);
+    vector<uint32_t> targets;
+
+    switch (instr.flow.type)
+    {
+	case Bee8086FlowInfo::Jump: targets.push_back(convertSeg(instr.cs, target_ip)); break;
+	case Bee8086FlowInfo::JumpFar: targets.push_back(convertSeg(instr.flow.target_cs, instr.flow.target_ip)); break;
+	case Bee8086FlowInfo::Branch:
+	{
+	    targets.push_back(convertSeg(instr.cs, target_ip));
+	    targets.push_back(convertSeg(instr.cs, next_ip));
+	}
+	break;
+	case Bee8086FlowInfo::Next:
+	case Bee8086FlowInfo::Call:
+	case Bee8086FlowInfo::CallFar:
+	case Bee8086FlowInfo::CallIndirect:
+	case Bee8086FlowInfo::Interrupt:
+	case Bee8086FlowInfo::Halt: targets.push_back(convertSeg(instr.cs, next_ip)); break;
+	default: break;
+    }
+
+    return targets;
+}
+
+// Groups the decoded instructions into basic blocks
+void Bee8086Analyzer::buildblocks()
+{
+    Bee8086Block *current = NULL;
+    const Instr *last = NULL;
+    uint32_t next_addr = 0;
+
+    // Every branch target (and the instruction after every transfer of control) has to start a block,
+    // including ones that land in the middle of a run of code that was decoded first,
+    // as does anything an instruction falls through to past an overlapping one
+    for (auto it = instrs.begin(); it != instrs.end(); it++)
+    {
+	auto next = it;
+	next++;
+
+	bool is_contiguous = ((next != instrs.end()) && (next->first == (it->first + it->second.length)));
+
+	if ((it->second.flow.type == Bee8086FlowInfo::Next) && is_contiguous)
+	{
+	    continue;
+	}
+
+	for (auto target : gettargets(it->second))
+	{
+	    if (instrs.count(target) != 0)
+	    {
+		leaders.insert(target);
+	    }
+	}
+    }
+
+    auto finish_block = [&]()
+    {
+	if (current == NULL)
+	{
+	    return;
+	}
+
+	for (auto target : gettargets(*last))
+	{
+	    if (instrs.count(target) != 0)
+	    {
+		current->successors.push_back(target);
+	    }
+	}
+
+	current = NULL;
+    };
+
+    for (auto &it : instrs)
+    {
+	uint32_t addr = it.first;
+	const Instr &instr = it.second;
+
+	if ((current != NULL) && ((addr != next_addr) || (leaders.count(addr) != 0)))
+	{
+	    finish_block();
+	}
+
+	if (current == NULL)
+	{
+	    current = &blocks[addr];
+	    current->cs = instr.cs;
+	    current->ip = instr.ip;
+	    current->addr = addr;
+	}
+
+	current->length += instr.length;
+	current->num_instrs += 1;
+	current->exit = instr.flow.type;
+
+	auto sites = call_sites.find(addr);
+
+	if (sites != call_sites.end())
+	{
+	    current->calls.insert(current->calls.end(), sites->second.begin(), sites->second.end());
+	}
+
+	last = &instr;
+	next_addr = (addr + instr.length);
+
+	if (instr.flow.type != Bee8086FlowInfo::Next)
+	{
+	    finish_block();
+	}
+    }
+
+    finish_block();
+}
+
+// Collects the blocks reachable from each function entry (without following calls)
+void Bee8086Analyzer::buildfunctions()
+{
+    for (auto &entry : function_entries)
+    {
+	if (blocks.count(entry.first) == 0)
+	{
+	    continue;
+	}
+
+	Bee8086Function &func = functions[entry.first];
+	func.cs = entry.second.cs;
+	func.ip = entry.second.ip;
+	func.addr = entry.first;
+
+	set<uint32_t> visited;
+	set<uint32_t> callees;
+	vector<uint32_t> worklist(1, entry.first);
+
+	while (!worklist.empty())
+	{
+	    uint32_t addr = worklist.back();
+	    worklist.pop_back();
+
+	    if (!visited.insert(addr).second)
+	    {
+		continue;
+	    }
+
+	    const Bee8086Block &block = blocks.at(addr);
+	    func.blocks.push_back(addr);
+	    callees.insert(block.calls.begin(), block.calls.end());
+
+	    for (auto succ : block.successors)
+	    {
+		worklist.push_back(succ);
+	    }
+	}
+
+	func.callees.assign(callees.begin(), callees.end());
+    }
+}
+
+void Bee8086Analyzer::exportdot(ostream &stream)
+{
+    stream << "digraph bee8086 {" << endl;
+    stream << "    node [shape=box, fontname=\"Courier\"];" << endl;
+
+    for (auto &it : blocks)
+    {
+	const Bee8086Block &block = it.second;
+	stream << "    \"" << locname(block.cs, block.ip) << "\" [label=\"";
+
+	auto instr = instrs.find(block.addr);
+
+	for (size_t index = 0; index < block.num_instrs; index++, instr++)
+	{
+	    stream << locname(instr->second.cs, instr->second.ip) << "  " << instr->second.text << "\\l";
+	}
+
+	stream << "\"";
+
+	if (functions.count(block.addr) != 0)
+	{
+	    stream << ", penwidth=2";
+	}
+
+	stream << "];" << endl;
+    }
+
+    for (auto &it : blocks)
+    {
+	const Bee8086Block &block = it.second;
+
+	for (auto succ : block.successors)
+	{
+	    const Bee8086Block &target = blocks.at(succ);
+	    stream << "    \"" << locname(block.cs, block.ip) << "\" -> \"" << locname(target.cs, target.ip) << "\";" << endl;
+	}
+
+	for (auto callee : block.calls)
+	{
+	    if (blocks.count(callee) == 0)
+	    {
+		continue;
+	    }
+
+	    const Bee8086Block &target = blocks.at(callee);
+	    stream << "    \"" << locname(block.cs, block.ip) << "\" -> \"" << locname(target.cs, target.ip) << "\" [style=dashed];" << endl;
+	}
+    }
+
+    stream << "}" << endl;
+}
+
+void Bee8086Analyzer::exportjson(ostream &stream)
+{
+    auto print_list = [&](const vector<uint32_t> &list)
+    {
+	stream << "[";
+
+	for (size_t index = 0; index < list.size(); index++)
+	{
+	    stream << ((index == 0) ? "" : ", ") << dec << list[index];
+	}
+
+	stream << "]";
+    };
+
+    stream << "{" << endl;
+    stream << "  \"blocks\": [";
+
+    bool is_first = true;
+
+    for (auto &it : blocks)
+    {
+	const Bee8086Block &block = it.second;
+	stream << (is_first ? "" : ",") << endl;
+	stream << "    {\"loc\": \"" << locname(block.cs, block.ip) << "\", \"addr\": " << dec << block.addr;
+	stream << ", \"length\": " << dec << block.length << ", \"instructions\": " << dec << block.num_instrs;
+	stream << ", \"exit\": \"" << flowname(block.exit) << "\", \"successors\": ";
+	print_list(block.successors);
+	stream << ", \"calls\": ";
+	print_list(block.calls);
+	stream << "}";
+	is_first = false;
+    }
+
+    stream << endl << "  ]," << endl;
+    stream << "  \"functions\": [";
+
+    is_first = true;
+
+    for (auto &it : functions)
+    {
+	const Bee8086Function &func = it.second;
+	stream << (is_first ? "" : ",") << endl;
+	stream << "    {\"loc\": \"" << locname(func.cs, func.ip) << "\", \"addr\": " << dec << func.addr << ", \"blocks\": ";
+	print_list(func.blocks);
+	stream << ", \"callees\": ";
+	print_list(func.callees);
+	stream << "}";
+	is_first = false;
+    }
+
+    stream << endl << "  ]" << endl;
+    stream << "}" << endl;
+}
+
+string Bee8086Analyzer::locname(uint16_t seg, uint16_t offs)
+{
+    stringstream ss;
+    ss << hex << setw(4) << setfill('0') << int(seg) << ":" << setw(4) << setfill('0') << int(offs);
+    return ss.str();
+}
+
+string Bee8086Analyzer::flowname(Bee8086FlowInfo::Type type)
+{
+    switch (type)
+    {
+	case Bee8086FlowInfo::Next: return "next";
+	case Bee8086FlowInfo::Jump: return "jump";
+	case Bee8086FlowInfo::Branch: return "branch";
+	case Bee8086FlowInfo::Call: return "call";
+	case Bee8086FlowInfo::JumpFar: return "jump_far";
+	case Bee8086FlowInfo::CallFar: return "call_far";
+	case Bee8086FlowInfo::JumpIndirect: return "jump_indirect";
+	case Bee8086FlowInfo::CallIndirect: return "call_indirect";
+	case Bee8086FlowInfo::Interrupt: return "interrupt";
+	case Bee8086FlowInfo::Return: return "return";
+	case Bee8086FlowInfo::Halt: return "halt";
+	default: return "invalid";
+    }
+}
\ No newline at end of file
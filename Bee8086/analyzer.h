@@ -0,0 +1,131 @@
+/*
+    This file is part of the Bee8086 engine.
+    Copyright (C) 2022 BueniaDev.
+
+    Bee8086 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bee8086 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bee8086.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BEE8086_ANALYZER_H
+#define BEE8086_ANALYZER_H
+
+#include <map>
+#include <set>
+#include "bee8086.h"
+using namespace std;
+
+namespace bee8086
+{
+    // Basic block of guest code
+    struct Bee8086Block
+    {
+	uint16_t cs = 0; // Code segment of the block
+	uint16_t ip = 0; // Offset of the block's first instruction
+	uint32_t addr = 0; // Linear address of the block's first instruction
+	size_t length = 0; // Length of the block (in bytes)
+	size_t num_instrs = 0; // Number of instructions in the block
+	Bee8086FlowInfo::Type exit = Bee8086FlowInfo::Next; // Control flow of the block's last instruction
+	vector<uint32_t> successors; // Linear addresses of the block's successors
+	vector<uint32_t> calls; // Linear addresses of functions called by the block
+    };
+
+    // Function (i.e. an entry point or a call target) in the call graph
+    struct Bee8086Function
+    {
+	uint16_t cs = 0;
+	uint16_t ip = 0;
+	uint32_t addr = 0;
+	vector<uint32_t> blocks; // Linear addresses of the blocks reachable from the function's entry
+	vector<uint32_t> callees; // Linear addresses of the functions called by this function
+    };
+
+    // Recovers the control-flow graph of guest code by recursive traversal
+    class Bee8086Analyzer
+    {
+	public:
+	    Bee8086Analyzer();
+	    ~Bee8086Analyzer();
+
+	    // Sets the interface guest code is read from
+	    void setinterface(Bee8086Interface *cb);
+
+	    // Adds an entry point at "seg:offs"
+	    void addentry(uint16_t seg, uint16_t offs);
+
+	    // Adds every (non-null) vector in the interrupt vector table as an entry point
+	    void addivtentries();
+
+	    // Follows jumps, calls and loops from all of the entry points,
+	    // and then builds the basic blocks and the call graph
+	    void analyze();
+
+	    // Clears all entry points and analysis results
+	    void clear();
+
+	    // Fetches the basic blocks and functions (keyed by linear address)
+	    const map<uint32_t, Bee8086Block> &getblocks();
+	    const map<uint32_t, Bee8086Function> &getfunctions();
+
+	    // Exports the control-flow graph and call graph in DOT format
+	    void exportdot(ostream &stream);
+
+	    // Exports the control-flow graph and call graph in JSON format
+	    void exportjson(ostream &stream);
+
+	    // Maximum number of instructions to decode before giving up
+	    size_t max_instrs = 0x100000;
+
+	private:
+	    struct Instr
+	    {
+		uint16_t cs = 0;
+		uint16_t ip = 0;
+		size_t length = 0;
+		Bee8086FlowInfo flow;
+		string text;
+	    };
+
+	    struct Location
+	    {
+		uint16_t cs = 0;
+		uint16_t ip = 0;
+	    };
+
+	    Bee8086Interface *inter = NULL;
+	    Bee8086 decoder;
+
+	    vector<Location> entries;
+	    map<uint32_t, Instr> instrs;
+	    set<uint32_t> leaders;
+	    map<uint32_t, Location> function_entries;
+	    map<uint32_t, vector<uint32_t>> call_sites;
+
+	    map<uint32_t, Bee8086Block> blocks;
+	    map<uint32_t, Bee8086Function> functions;
+
+	    uint32_t convertSeg(uint16_t seg, uint16_t offs);
+	    uint16_t readWord(uint32_t addr);
+
+	    void traverse();
+	    void buildblocks();
+
+	    // Fetches the linear addresses control can pass to after "instr" (not counting calls)
+	    vector<uint32_t> gettargets(const Instr &instr);
+	    void buildfunctions();
+
+	    string locname(uint16_t seg, uint16_t offs);
+	    string flowname(Bee8086FlowInfo::Type type);
+    };
+};
+
+#endif // BEE8086_ANALYZER_H
\ No newline at end of file
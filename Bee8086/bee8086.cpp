@@ -17,6 +17,9 @@
 */
 
 #include "bee8086.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
 using namespace bee8086;
 using namespace std;
 
@@ -31,6 +34,32 @@ Bee8086Interface::~Bee8086Interface()
 
 }
 
+void Bee8086Interface::readBlock(uint32_t addr, uint8_t *data, size_t size)
+{
+    for (size_t index = 0; index < size; index++)
+    {
+	data[index] = readByte(addr + index);
+    }
+}
+
+void Bee8086Interface::writeBlock(uint32_t addr, const uint8_t *data, size_t size)
+{
+    for (size_t index = 0; index < size; index++)
+    {
+	writeByte((addr + index), data[index]);
+    }
+}
+
+bool Bee8086Interface::isInterruptPending()
+{
+    return false;
+}
+
+uint8_t Bee8086Interface::acknowledgeInterrupt()
+{
+    return 0xFF;
+}
+
 // Function declarations for Bee8086Register
 Bee8086Register::Bee8086Register()
 {
@@ -116,6 +145,10 @@ void Bee8086::init(uint16_t init_cs, uint16_t init_pc)
 
     status_reg = 0;
 
+    total_cycles = 0;
+    total_instrs = 0;
+    is_repeating = false;
+
     // Notify the user that the emulated 8080 has been initialized
     cout << "Bee8086::Initialized" << endl;
 }
@@ -228,34 +261,70 @@ uint8_t Bee8086::get_ch()
     return cx.gethi();
 }
 
+// Sets CH register
+void Bee8086::set_ch(uint8_t val)
+{
+    cx.sethi(val);
+}
+
 // Fetches CL register
 uint8_t Bee8086::get_cl()
 {
     return cx.getlo();
 }
 
+// Sets CL register
+void Bee8086::set_cl(uint8_t val)
+{
+    cx.setlo(val);
+}
+
 // Fetches CX register
 uint16_t Bee8086::get_cx()
 {
     return cx.getreg();
 }
 
+// Sets CX register
+void Bee8086::set_cx(uint16_t val)
+{
+    cx.setreg(val);
+}
+
 // Fetches DH register
 uint8_t Bee8086::get_dh()
 {
     return dx.gethi();
 }
 
+// Sets DH register
+void Bee8086::set_dh(uint8_t val)
+{
+    dx.sethi(val);
+}
+
 // Fetches DL register
 uint8_t Bee8086::get_dl()
 {
     return dx.getlo();
 }
 
+// Sets DL register
+void Bee8086::set_dl(uint8_t val)
+{
+    dx.setlo(val);
+}
+
 // Fetches DX register
 uint16_t Bee8086::get_dx()
 {
-    return bx.getreg();
+    return dx.getreg();
+}
+
+// Sets DX register
+void Bee8086::set_dx(uint16_t val)
+{
+    dx.setreg(val);
 }
 
 // Fetches BH register
@@ -297,7 +366,190 @@ uint16_t Bee8086::get_ip()
 // Executes a single instruction and returns its cycle count
 int Bee8086::runinstruction()
 {
-    return executenextopcode(getimmByte());
+    int cycles = 0;
+
+    // A repeat only lasts for the instruction that asked for it
+    is_repeating = false;
+    uint16_t instr_cs = cs;
+    uint16_t instr_ip = ip;
+
+    // Hardware interrupts are only taken between whole instructions
+    // (prefixes are executed as separate instructions, so they have to wait until after the prefixed instruction)
+    if (is_irq() && !is_rep && !is_segment_override && isInterruptPending())
+    {
+	cycles = hardwareInterrupt(acknowledgeInterrupt());
+    }
+    else
+    {
+	cycles = executenextopcode(getimmByte());
+    }
+
+    if (is_repeating)
+    {
+	cs = instr_cs;
+	ip = instr_ip;
+    }
+
+    // The instruction we resumed from has run, so its breakpoint applies again
+    is_resuming = false;
+
+    total_cycles += cycles;
+    total_instrs += 1;
+    return cycles;
+}
+
+// Executes instructions until "num_cycles" cycles have passed or a breakpoint is reached,
+// and returns the number of cycles executed
+int Bee8086::runcycles(int num_cycles)
+{
+    int cycles = 0;
+    is_breakpoint_hit = false;
+
+    while (cycles < num_cycles)
+    {
+	// Stop before executing an instruction at a breakpoint
+	// (unless we've just been resumed from it)
+	if (stopatbreakpoint())
+	{
+	    is_breakpoint_hit = true;
+	    break;
+	}
+
+	cycles += runinstruction();
+    }
+
+    return cycles;
+}
+
+void Bee8086::addbreakpoint(uint32_t addr)
+{
+    breakpoints.insert(addr);
+}
+
+void Bee8086::removebreakpoint(uint32_t addr)
+{
+    breakpoints.erase(addr);
+}
+
+void Bee8086::clearbreakpoints()
+{
+    breakpoints.clear();
+}
+
+bool Bee8086::hitbreakpoint()
+{
+    return is_breakpoint_hit;
+}
+
+bool Bee8086::atbreakpoint()
+{
+    return (!breakpoints.empty() && (breakpoints.count(convertSeg(cs, ip)) != 0));
+}
+
+void Bee8086::resume()
+{
+    is_resuming = true;
+}
+
+bool Bee8086::stopatbreakpoint()
+{
+    return (!is_resuming && !is_repeating && atbreakpoint());
+}
+
+void Bee8086::repeatinstruction()
+{
+    is_repeating = true;
+}
+
+bool Bee8086::isrepeating()
+{
+    return is_repeating;
+}
+
+uint64_t Bee8086::getcycles()
+{
+    return total_cycles;
+}
+
+uint64_t Bee8086::getinstrcount()
+{
+    return total_instrs;
+}
+
+uint8_t Bee8086::readmemory(uint32_t addr)
+{
+    return readByte(addr);
+}
+
+void Bee8086::readmemory(uint32_t addr, uint8_t *data, size_t size)
+{
+    if (inter != NULL)
+    {
+	inter->readBlock(addr, data, size);
+    }
+}
+
+void Bee8086::writememory(uint32_t addr, uint8_t val)
+{
+    writeByte(addr, val);
+}
+
+void Bee8086::writememory(uint32_t addr, const uint8_t *data, size_t size)
+{
+    if (inter != NULL)
+    {
+	inter->writeBlock(addr, data, size);
+    }
+}
+
+// Fetches the values of all registers
+Bee8086State Bee8086::getstate()
+{
+    Bee8086State state;
+    state.ax = ax.getreg();
+    state.bx = bx.getreg();
+    state.cx = cx.getreg();
+    state.dx = dx.getreg();
+    state.ip = ip;
+    state.sp = sp;
+    state.bp = bp;
+    state.si = si;
+    state.di = di;
+    state.cs = cs;
+    state.ds = ds;
+    state.ss = ss;
+    state.es = es;
+    state.flags = status_reg;
+    state.cycles = total_cycles;
+    state.instrs = total_instrs;
+    state.mem_segment = mem_segment;
+    state.is_segment_override = is_segment_override;
+    state.is_rep = is_rep;
+    return state;
+}
+
+// Sets the values of all registers
+void Bee8086::setstate(const Bee8086State &state)
+{
+    ax.setreg(state.ax);
+    bx.setreg(state.bx);
+    cx.setreg(state.cx);
+    dx.setreg(state.dx);
+    ip = state.ip;
+    sp = state.sp;
+    bp = state.bp;
+    si = state.si;
+    di = state.di;
+    cs = state.cs;
+    ds = state.ds;
+    ss = state.ss;
+    es = state.es;
+    status_reg = state.flags;
+    total_cycles = state.cycles;
+    total_instrs = state.instrs;
+    mem_segment = Segment(state.mem_segment);
+    is_segment_override = state.is_segment_override;
+    is_rep = state.is_rep;
 }
 
 // Converts a segment and an offset to a physical address
@@ -501,19 +753,54 @@ void Bee8086::interruptOverride(uint8_t int_num)
     }
 }
 
-// TODO: Improve accuracy of dissasembly output and opcode size
-size_t Bee8086::disassembleinstr(ostream &stream, size_t pc)
+bool Bee8086::isInterruptPending()
+{
+    if (inter == NULL)
+    {
+	return false;
+    }
+
+    return inter->isInterruptPending();
+}
+
+uint8_t Bee8086::acknowledgeInterrupt()
 {
-    static uint32_t suppress = 0xFFFFFFFF;
+    if (inter == NULL)
+    {
+	return 0xFF;
+    }
+
+    return inter->acknowledgeInterrupt();
+}
 
-    if (pc == suppress)
+// Disassembles the instruction at "pc" through the interface
+size_t Bee8086::disassembleinstr(ostream &stream, size_t pc)
+{
+    // Don't disassemble the opcode of a prefixed instruction twice
+    if (pc == dasm_suppress)
     {
 	return 0;
     }
 
+    DasmSource src;
+    return dasminstr(stream, pc, src);
+}
+
+// Disassembles the instruction at "pc" through the interface,
+// and fetches its control flow information into "info"
+size_t Bee8086::disassembleinstr(ostream &stream, size_t pc, Bee8086FlowInfo &info)
+{
+    DasmSource src;
+    return dasminstr(stream, pc, src, &info);
+}
+
+// TODO: Improve accuracy of dissasembly output and opcode size
+size_t Bee8086::dasminstr(ostream &stream, size_t pc, const DasmSource &src, Bee8086FlowInfo *info)
+{
     size_t prev_pc = pc;
+    Bee8086FlowInfo flow;
 
-    uint8_t opcode = readByte(pc++);
+    uint8_t opcode = dasmByte(src, pc++);
 
     string repeat = "";
     string prefix = "";
@@ -523,51 +810,57 @@ size_t Bee8086::disassembleinstr(ostream &stream, size_t pc)
 	if (opcode == 0x26)
 	{
 	    prefix = "es";
-	    opcode = readByte(pc);
-	    suppress = pc;
-	    continue;
 	}
-
-	if (opcode == 0x2E)
+	else if (opcode == 0x2E)
 	{
 	    prefix = "cs";
-	    opcode = readByte(pc);
-	    suppress = pc;
-	    continue;
 	}
-
-	if (opcode == 0x36)
+	else if (opcode == 0x36)
 	{
 	    prefix = "ss";
-	    opcode = readByte(pc);
-	    suppress = pc;
-	    continue;
 	}
-
-	if (opcode == 0x3E)
+	else if (opcode == 0x3E)
 	{
 	    prefix = "ds";
-	    opcode = readByte(pc);
-	    suppress = pc;
-	    continue;
 	}
-
-	if (opcode == 0xF3)
+	else if (opcode == 0xF3)
 	{
 	    repeat = "rep";
-	    opcode = readByte(pc);
-	    suppress = pc;
-	    continue;
+	}
+	else
+	{
+	    break;
 	}
 
-	break;
+	// Prefixes are executed as separate instructions, so the disassembly
+	// for the opcode that follows is suppressed when disassembling through the interface
+	if (src.data == NULL)
+	{
+	    dasm_suppress = pc;
+	}
+
+	opcode = dasmByte(src, pc++);
+    }
+
+    if (prefix != "")
+    {
+	stream << prefix << ": ";
     }
-    
 
     switch (opcode)
     {
-	case 0x00: stream << "add reg8/mem8, reg8"; break;
-	case 0x01: stream << "add reg16/mem16, reg16"; break;
+	case 0x00:
+	{
+	    dasmModRM(src, pc);
+	    stream << "add reg8/mem8, reg8";
+	}
+	break;
+	case 0x01:
+	{
+	    dasmModRM(src, pc);
+	    stream << "add reg16/mem16, reg16";
+	}
+	break;
 	case 0x06: stream << "push es"; break;
 	case 0x07: stream << "pop es"; break;
 	case 0x0E: stream << "push cs"; break;
@@ -578,7 +871,7 @@ size_t Bee8086::disassembleinstr(ostream &stream, size_t pc)
 	case 0x1F: stream << "pop ds"; break;
 	case 0x24:
 	{
-	    uint16_t imm_val = readByte(pc++);
+	    uint16_t imm_val = dasmByte(src, pc++);
 	    stream << "and al, #$" << hex << int(imm_val);
 	}
 	break;
@@ -590,10 +883,18 @@ size_t Bee8086::disassembleinstr(ostream &stream, size_t pc)
 	case 0x41: stream << "inc cx"; break;
 	case 0x42: stream << "inc dx"; break;
 	case 0x43: stream << "inc bx"; break;
+	case 0x44: stream << "inc sp"; break;
+	case 0x45: stream << "inc bp"; break;
+	case 0x46: stream << "inc si"; break;
+	case 0x47: stream << "inc di"; break;
 	case 0x48: stream << "dec ax"; break;
 	case 0x49: stream << "dec cx"; break;
 	case 0x4A: stream << "dec dx"; break;
 	case 0x4B: stream << "dec bx"; break;
+	case 0x4C: stream << "dec sp"; break;
+	case 0x4D: stream << "dec bp"; break;
+	case 0x4E: stream << "dec si"; break;
+	case 0x4F: stream << "dec di"; break;
 	case 0x50: stream << "push ax"; break;
 	case 0x51: stream << "push cx"; break;
 	case 0x52: stream << "push dx"; break;
@@ -607,172 +908,239 @@ size_t Bee8086::disassembleinstr(ostream &stream, size_t pc)
 	case 0x5E: stream << "pop si"; break;
 	case 0x70:
 	{
-	    int8_t imm = readByte(pc++);
+	    int8_t imm = dasmByte(src, pc++);
 	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
 	    stream << "jo $" << hex << int(addr);
 	}
 	break;
 	case 0x71:
 	{
-	    int8_t imm = readByte(pc++);
+	    int8_t imm = dasmByte(src, pc++);
 	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
 	    stream << "jno $" << hex << int(addr);
 	}
 	break;
 	case 0x72:
 	{
-	    int8_t imm = readByte(pc++);
+	    int8_t imm = dasmByte(src, pc++);
 	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
 	    stream << "jb $" << hex << int(addr);
 	}
 	break;
 	case 0x73:
 	{
-	    int8_t imm = readByte(pc++);
+	    int8_t imm = dasmByte(src, pc++);
 	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
 	    stream << "jnb $" << hex << int(addr);
 	}
 	break;
 	case 0x74:
 	{
-	    int8_t imm = readByte(pc++);
+	    int8_t imm = dasmByte(src, pc++);
 	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
 	    stream << "jz $" << hex << int(addr);
 	}
 	break;
 	case 0x75:
 	{
-	    int8_t imm = readByte(pc++);
+	    int8_t imm = dasmByte(src, pc++);
 	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
 	    stream << "jnz $" << hex << int(addr);
 	}
 	break;
 	case 0x76:
 	{
-	    int8_t imm = readByte(pc++);
+	    int8_t imm = dasmByte(src, pc++);
 	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
 	    stream << "jbe $" << hex << int(addr);
 	}
 	break;
 	case 0x77:
 	{
-	    int8_t imm = readByte(pc++);
+	    int8_t imm = dasmByte(src, pc++);
 	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
 	    stream << "ja $" << hex << int(addr);
 	}
 	break;
 	case 0x78:
 	{
-	    int8_t imm = readByte(pc++);
+	    int8_t imm = dasmByte(src, pc++);
 	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
 	    stream << "js $" << hex << int(addr);
 	}
 	break;
 	case 0x79:
 	{
-	    int8_t imm = readByte(pc++);
+	    int8_t imm = dasmByte(src, pc++);
 	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
 	    stream << "jns $" << hex << int(addr);
 	}
 	break;
 	case 0x7A:
 	{
-	    int8_t imm = readByte(pc++);
+	    int8_t imm = dasmByte(src, pc++);
 	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
 	    stream << "jpe $" << hex << int(addr);
 	}
 	break;
 	case 0x7B:
 	{
-	    int8_t imm = readByte(pc++);
+	    int8_t imm = dasmByte(src, pc++);
 	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
 	    stream << "jpo $" << hex << int(addr);
 	}
 	break;
 	case 0x7C:
 	{
-	    int8_t imm = readByte(pc++);
+	    int8_t imm = dasmByte(src, pc++);
 	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
 	    stream << "jl $" << hex << int(addr);
 	}
 	break;
 	case 0x7D:
 	{
-	    int8_t imm = readByte(pc++);
+	    int8_t imm = dasmByte(src, pc++);
 	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
 	    stream << "jge $" << hex << int(addr);
 	}
 	break;
 	case 0x7E:
 	{
-	    int8_t imm = readByte(pc++);
+	    int8_t imm = dasmByte(src, pc++);
 	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
 	    stream << "jle $" << hex << int(addr);
 	}
 	break;
 	case 0x7F:
 	{
-	    int8_t imm = readByte(pc++);
+	    int8_t imm = dasmByte(src, pc++);
 	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
 	    stream << "jg $" << hex << int(addr);
 	}
 	break;
 	case 0x80:
 	{
+	    dasmModRM(src, pc);
 	    stream << "grp1 mem8, imm8";
+	    pc += 1;
 	}
 	break;
 	case 0x84:
 	{
-	    dasmModRM(pc);
+	    dasmModRM(src, pc);
 	    stream << "test reg8/mem8, reg8";
-	    pc += 1;
 	}
 	break;
 	case 0x88:
 	{
+	    dasmModRM(src, pc);
 	    stream << "mov reg8/mem8, reg8";
-	    pc += 1;
 	}
 	break;
 	case 0x89:
 	{
+	    dasmModRM(src, pc);
 	    stream << "mov reg16/mem16, reg16";
-	    pc += 1;
 	}
 	break;
 	case 0x8A:
 	{
+	    dasmModRM(src, pc);
 	    stream << "mov reg8, reg8/mem8";
-	    pc += 1;
 	}
 	break;
 	case 0x8B:
 	{
+	    dasmModRM(src, pc);
 	    stream << "mov reg16, reg16/mem16";
-	    pc += 1;
 	}
 	break;
 	case 0x8C:
 	{
-	    dasmModRM(pc);
-	    stream << "mov " << dasm_mod_rm.dasm_str << ", " << dasmSeg(dasm_mod_rm.reg);
-	    pc += 1;
+	    ModRMDasm mod_rm = dasmModRM(src, pc);
+	    stream << "mov " << mod_rm.dasm_str << ", " << dasmSeg(mod_rm.reg);
 	}
 	break;
 	case 0x8E:
 	{
-	    dasmModRM(pc);
-	    stream << "mov " << dasmSeg(dasm_mod_rm.reg) << ", " << dasm_mod_rm.dasm_str;
-	    pc += 1;
+	    ModRMDasm mod_rm = dasmModRM(src, pc);
+	    stream << "mov " << dasmSeg(mod_rm.reg) << ", " << mod_rm.dasm_str;
+	}
+	break;
+	case 0x9A:
+	{
+	    uint16_t ip_val = dasmWord(src, pc);
+	    pc += 2;
+	    uint16_t cs_val = dasmWord(src, pc);
+	    pc += 2;
+	    flow.type = Bee8086FlowInfo::CallFar;
+	    flow.target_cs = cs_val;
+	    flow.target_ip = ip_val;
+
+	    stream << "call " << hex << int(cs_val) << ":" << hex << int(ip_val);
 	}
 	break;
 	case 0x9D: stream << "popf"; break;
 	case 0x9E: stream << "sahf"; break;
 	case 0x9F: stream << "lahf"; break;
+	case 0xA0:
+	{
+	    uint16_t addr = dasmWord(src, pc);
+	    stream << "mov al, [$" << hex << int(addr) << "]";
+	    pc += 2;
+	}
+	break;
+	case 0xA1:
+	{
+	    uint16_t addr = dasmWord(src, pc);
+	    stream << "mov ax, [$" << hex << int(addr) << "]";
+	    pc += 2;
+	}
+	break;
 	case 0xA2:
 	{
-	    stream << "mov mem8, al";
+	    uint16_t addr = dasmWord(src, pc);
+	    stream << "mov [$" << hex << int(addr) << "], al";
+	    pc += 2;
+	}
+	break;
+	case 0xA3:
+	{
+	    uint16_t addr = dasmWord(src, pc);
+	    stream << "mov [$" << hex << int(addr) << "], ax";
+	    pc += 2;
 	}
 	break;
 	case 0xA4:
@@ -797,182 +1165,413 @@ size_t Bee8086::disassembleinstr(ostream &stream, size_t pc)
 	break;
 	case 0xB0:
 	{
-	    uint16_t imm_val = readByte(pc);
+	    uint16_t imm_val = dasmByte(src, pc);
 	    stream << "mov al, #$" << hex << int(imm_val);
 	    pc += 1;
 	}
 	break;
 	case 0xB1:
 	{
-	    uint16_t imm_val = readByte(pc);
+	    uint16_t imm_val = dasmByte(src, pc);
 	    stream << "mov cl, #$" << hex << int(imm_val);
 	    pc += 1;
 	}
 	break;
 	case 0xB2:
 	{
-	    uint16_t imm_val = readByte(pc);
+	    uint16_t imm_val = dasmByte(src, pc);
 	    stream << "mov dl, #$" << hex << int(imm_val);
 	    pc += 1;
 	}
 	break;
 	case 0xB3:
 	{
-	    uint16_t imm_val = readByte(pc);
+	    uint16_t imm_val = dasmByte(src, pc);
 	    stream << "mov bl, #$" << hex << int(imm_val);
 	    pc += 1;
 	}
 	break;
 	case 0xB4:
 	{
-	    uint16_t imm_val = readByte(pc);
+	    uint16_t imm_val = dasmByte(src, pc);
 	    stream << "mov ah, #$" << hex << int(imm_val);
 	    pc += 1;
 	}
 	break;
 	case 0xB5:
 	{
-	    uint16_t imm_val = readByte(pc);
+	    uint16_t imm_val = dasmByte(src, pc);
 	    stream << "mov ch, #$" << hex << int(imm_val);
 	    pc += 1;
 	}
 	break;
 	case 0xB6:
 	{
-	    uint16_t imm_val = readByte(pc);
+	    uint16_t imm_val = dasmByte(src, pc);
 	    stream << "mov dh, #$" << hex << int(imm_val);
 	    pc += 1;
 	}
 	break;
 	case 0xB7:
 	{
-	    uint16_t imm_val = readByte(pc);
+	    uint16_t imm_val = dasmByte(src, pc);
 	    stream << "mov bh, #$" << hex << int(imm_val);
 	    pc += 1;
 	}
 	break;
 	case 0xB8:
 	{
-	    uint16_t imm_val = readWord(pc);
+	    uint16_t imm_val = dasmWord(src, pc);
 	    stream << "mov ax, #$" << hex << int(imm_val);
 	    pc += 2;
 	}
 	break;
 	case 0xB9:
 	{
-	    uint16_t imm_val = readWord(pc);
+	    uint16_t imm_val = dasmWord(src, pc);
 	    stream << "mov cx, #$" << hex << int(imm_val);
 	    pc += 2;
 	}
 	break;
 	case 0xBA:
 	{
-	    uint16_t imm_val = readWord(pc);
+	    uint16_t imm_val = dasmWord(src, pc);
 	    stream << "mov dx, #$" << hex << int(imm_val);
 	    pc += 2;
 	}
 	break;
 	case 0xBB:
 	{
-	    uint16_t imm_val = readWord(pc);
+	    uint16_t imm_val = dasmWord(src, pc);
 	    stream << "mov bx, #$" << hex << int(imm_val);
 	    pc += 2;
 	}
 	break;
 	case 0xBC:
 	{
-	    uint16_t imm_val = readWord(pc);
+	    uint16_t imm_val = dasmWord(src, pc);
 	    stream << "mov sp, #$" << hex << int(imm_val);
 	    pc += 2;
 	}
 	break;
 	case 0xBE:
 	{
-	    uint16_t imm_val = readWord(pc);
+	    uint16_t imm_val = dasmWord(src, pc);
 	    stream << "mov si, #$" << hex << int(imm_val);
 	    pc += 2;
 	}
 	break;
 	case 0xBF:
 	{
-	    uint16_t imm_val = readWord(pc);
+	    uint16_t imm_val = dasmWord(src, pc);
 	    stream << "mov di, #$" << hex << int(imm_val);
 	    pc += 2;
 	}
 	break;
-	case 0xC3: stream << "ret"; break;
+	case 0xC2:
+	{
+	    uint16_t imm_val = dasmWord(src, pc);
+	    flow.type = Bee8086FlowInfo::Return;
+	    stream << "ret #$" << hex << int(imm_val);
+	    pc += 2;
+	}
+	break;
+	case 0xC3: flow.type = Bee8086FlowInfo::Return; stream << "ret"; break;
+	case 0xCA:
+	{
+	    uint16_t imm_val = dasmWord(src, pc);
+	    flow.type = Bee8086FlowInfo::Return;
+	    stream << "retf #$" << hex << int(imm_val);
+	    pc += 2;
+	}
+	break;
+	case 0xCB: flow.type = Bee8086FlowInfo::Return; stream << "retf"; break;
+	case 0xCC: flow.type = Bee8086FlowInfo::Interrupt; flow.int_num = 3; stream << "int 3"; break;
 	case 0xCD:
 	{
-	    uint8_t int_num = readByte(pc++);
+	    uint8_t int_num = dasmByte(src, pc++);
+	    flow.type = Bee8086FlowInfo::Interrupt;
+	    flow.int_num = int_num;
 	    stream << "int " << hex << int(int_num);
 	}
 	break;
-	case 0xCF: stream << "iret"; break;
+	case 0xCF: flow.type = Bee8086FlowInfo::Return; stream << "iret"; break;
 	case 0xD0:
 	{
+	    dasmModRM(src, pc);
 	    stream << "grp2 mem8, 1";
 	}
 	break;
 	case 0xD2:
 	{
+	    dasmModRM(src, pc);
 	    stream << "grp2 mem8, CL";
 	}
 	break;
-	case 0xE2: stream << "loop"; break;
+	case 0xE0:
+	{
+	    int8_t imm = dasmByte(src, pc++);
+	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
+	    stream << "loopnz $" << hex << int(addr);
+	}
+	break;
+	case 0xE1:
+	{
+	    int8_t imm = dasmByte(src, pc++);
+	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
+	    stream << "loopz $" << hex << int(addr);
+	}
+	break;
+	case 0xE2:
+	{
+	    int8_t imm = dasmByte(src, pc++);
+	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
+	    stream << "loop $" << hex << int(addr);
+	}
+	break;
+	case 0xE3:
+	{
+	    int8_t imm = dasmByte(src, pc++);
+	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Branch;
+	    flow.rel = imm;
+	    stream << "jcxz $" << hex << int(addr);
+	}
+	break;
 	case 0xE4:
 	{
-	    uint8_t imm = readByte(pc++);
+	    uint8_t imm = dasmByte(src, pc++);
 	    stream << "in al, $" << hex << int(imm);
 	}
 	break;
 	case 0xE6:
 	{
-	    uint8_t imm = readByte(pc++);
+	    uint8_t imm = dasmByte(src, pc++);
 	    stream << "out $" << hex << int(imm) << ", al";
 	}
 	break;
 	case 0xE8:
 	{
-	    int16_t offs = readWord(pc);
+	    int16_t offs = dasmWord(src, pc);
 	    pc += 2;
 	    uint32_t addr = (pc + offs);
+	    flow.type = Bee8086FlowInfo::Call;
+	    flow.rel = offs;
 
 	    stream << "call $" << hex << int(addr);
 	}
 	break;
+	case 0xE9:
+	{
+	    int16_t offs = dasmWord(src, pc);
+	    pc += 2;
+	    uint32_t addr = (pc + offs);
+	    flow.type = Bee8086FlowInfo::Jump;
+	    flow.rel = offs;
+
+	    stream << "jmp $" << hex << int(addr);
+	}
+	break;
 	case 0xEA:
 	{
-	    uint16_t ip_val = readWord(pc);
+	    uint16_t ip_val = dasmWord(src, pc);
 	    pc += 2;
-	    uint16_t cs_val = readWord(pc);
+	    uint16_t cs_val = dasmWord(src, pc);
 	    pc += 2;
+	    flow.type = Bee8086FlowInfo::JumpFar;
+	    flow.target_cs = cs_val;
+	    flow.target_ip = ip_val;
 
 	    stream << "jmp " << hex << int(cs_val) << ":" << hex << int(ip_val);
 	}
 	break;
 	case 0xEB:
 	{
-	    int8_t imm = readByte(pc++);
+	    int8_t imm = dasmByte(src, pc++);
 	    uint32_t addr = (pc + imm);
+	    flow.type = Bee8086FlowInfo::Jump;
+	    flow.rel = imm;
 	    stream << "jmp $" << hex << int(addr);
 	}
 	break;
+	case 0xEE: stream << "out dx, al"; break;
 	case 0xEF: stream << "out dx, ax"; break;
 	case 0xF3: stream << "rep"; break;
+	case 0xF4: flow.type = Bee8086FlowInfo::Halt; stream << "hlt"; break;
 	case 0xFA: stream << "cli"; break;
 	case 0xFB: stream << "sti"; break;
 	case 0xFC: stream << "cld"; break;
+	case 0xFE:
+	{
+	    dasmModRM(src, pc);
+	    stream << "grp4 mem8";
+	}
+	break;
 	case 0xFF:
 	{
+	    ModRMDasm mod_rm = dasmModRM(src, pc);
+
+	    // CALL and JMP through a register or memory operand
+	    if ((mod_rm.reg == 2) || (mod_rm.reg == 3))
+	    {
+		flow.type = Bee8086FlowInfo::CallIndirect;
+	    }
+	    else if ((mod_rm.reg == 4) || (mod_rm.reg == 5))
+	    {
+		flow.type = Bee8086FlowInfo::JumpIndirect;
+	    }
+
 	    stream << "grp5 mem";
 	}
 	break;
-	default: stream << "unk " << hex << int(opcode); break;
+	default: flow.type = Bee8086FlowInfo::Invalid; stream << "unk " << hex << int(opcode); break;
+    }
+
+    if (info != NULL)
+    {
+	*info = flow;
     }
 
     return (pc - prev_pc);
 }
 
+// Disassembles instructions from "src" in the range of [start, end) into "listing"
+// (the last instruction may extend past "end")
+void Bee8086::dasmsweep(const DasmSource &src, size_t start, size_t end, vector<Bee8086DasmLine> &listing)
+{
+    stringstream dasm_str;
+    size_t pc = start;
+
+    while (pc < end)
+    {
+	dasm_str.str("");
+	size_t length = dasminstr(dasm_str, (src.base + pc), src);
+
+	Bee8086DasmLine line;
+	line.addr = (src.base + pc);
+	line.length = length;
+	line.text = dasm_str.str();
+	listing.push_back(line);
+
+	pc += length;
+    }
+}
+
+// Disassembles a range of memory into a listing
+vector<Bee8086DasmLine> Bee8086::disassemblerange(uint32_t addr, size_t size, int num_threads)
+{
+    // Copy the range out of memory once, so that the (parallel) sweep
+    // doesn't have to go through the interface for every byte it decodes
+    vector<uint8_t> image(size, 0);
+
+    for (size_t index = 0; index < size; index++)
+    {
+	image[index] = readByte(uint32_t(addr + index));
+    }
+
+    return disassembleimage(image.data(), image.size(), addr, num_threads);
+}
+
+// Disassembles a raw image into a listing
+//
+// The image is split into fixed-size chunks, which are swept in parallel.
+// Since a chunk's first instruction usually doesn't start exactly on the chunk's
+// boundary, each chunk's listing is only used from the point where it lines up with
+// the end of the previous chunk's listing (or it's swept again from that point if it never does).
+vector<Bee8086DasmLine> Bee8086::disassembleimage(const uint8_t *data, size_t size, uint32_t base_addr, int num_threads)
+{
+    vector<Bee8086DasmLine> listing;
+
+    if ((data == NULL) || (size == 0))
+    {
+	return listing;
+    }
+
+    DasmSource src;
+    src.data = data;
+    src.size = size;
+    src.base = base_addr;
+
+    const size_t chunk_size = 0x1000;
+    size_t num_chunks = ((size + chunk_size - 1) / chunk_size);
+    vector<vector<Bee8086DasmLine>> chunks(num_chunks);
+
+    size_t num_workers = (num_threads > 0) ? num_threads : thread::hardware_concurrency();
+    num_workers = max<size_t>(1, min(num_workers, num_chunks));
+
+    atomic<size_t> next_chunk(0);
+
+    auto worker = [&]()
+    {
+	size_t index = 0;
+
+	while ((index = next_chunk.fetch_add(1)) < num_chunks)
+	{
+	    size_t start = (index * chunk_size);
+	    size_t end = min((start + chunk_size), size);
+	    dasmsweep(src, start, end, chunks[index]);
+	}
+    };
+
+    vector<thread> workers;
+
+    for (size_t index = 1; index < num_workers; index++)
+    {
+	workers.push_back(thread(worker));
+    }
+
+    worker();
+
+    for (auto &work : workers)
+    {
+	work.join();
+    }
+
+    // Stitch the chunks together, resynchronizing at each chunk boundary
+    size_t offs = 0;
+
+    for (size_t index = 0; index < num_chunks; index++)
+    {
+	size_t end = min(((index + 1) * chunk_size), size);
+
+	// The previous instruction runs over this entire chunk
+	if (offs >= end)
+	{
+	    continue;
+	}
+
+	vector<Bee8086DasmLine> &chunk = chunks[index];
+	uint32_t sync_addr = (base_addr + offs);
+
+	auto line = lower_bound(chunk.begin(), chunk.end(), sync_addr, [](const Bee8086DasmLine &lhs, uint32_t rhs)
+	{
+	    return (lhs.addr < rhs);
+	});
+
+	if ((line == chunk.end()) || (line->addr != sync_addr))
+	{
+	    chunk.clear();
+	    dasmsweep(src, offs, end, chunk);
+	    line = chunk.begin();
+	}
+
+	for (; line != chunk.end(); line++)
+	{
+	    listing.push_back(*line);
+	}
+
+	offs = ((listing.back().addr - base_addr) + listing.back().length);
+    }
+
+    return listing;
+}
+
 // Emulates the individual Intel 8086 instructions
 int Bee8086::executenextopcode(uint8_t opcode)
 {
@@ -21,6 +21,9 @@
 
 #include <iostream>
 #include <sstream>
+#include <string>
+#include <vector>
+#include <set>
 #include <cstdint>
 using namespace std;
 namespace bee8086
@@ -50,6 +53,80 @@ namespace bee8086
 	    virtual void interruptOverride(Bee8086 &state, uint8_t int_num) = 0;
 	    // Function for converting segment and offset to physical address
 	    virtual uint32_t convertSeg(uint16_t seg, uint16_t offs) = 0;
+
+	    // Reads a block of memory (defaults to reading one byte at a time)
+	    virtual void readBlock(uint32_t addr, uint8_t *data, size_t size);
+	    // Writes a block of memory (defaults to writing one byte at a time)
+	    virtual void writeBlock(uint32_t addr, const uint8_t *data, size_t size);
+
+	    // Returns true if a device is requesting a hardware interrupt (the 8086's INTR pin)
+	    // (defaults to never requesting one)
+	    virtual bool isInterruptPending();
+	    // Acknowledges the pending hardware interrupt, and returns its interrupt number
+	    // (the 8086's INTA cycles, usually answered by an 8259 PIC)
+	    virtual uint8_t acknowledgeInterrupt();
+    };
+
+    // Single line of a disassembly listing
+    struct Bee8086DasmLine
+    {
+	uint32_t addr = 0; // Address of the instruction
+	size_t length = 0; // Length of the instruction (in bytes)
+	string text; // Disassembled instruction
+    };
+
+    // Control flow information for a disassembled instruction
+    struct Bee8086FlowInfo
+    {
+	enum Type : int
+	{
+	    Next = 0, // Falls through to the next instruction
+	    Jump = 1, // Near/short jump
+	    Branch = 2, // Conditional jump (including LOOP and JCXZ)
+	    Call = 3, // Near call
+	    JumpFar = 4, // Far jump
+	    CallFar = 5, // Far call
+	    JumpIndirect = 6, // Jump through a register or memory operand
+	    CallIndirect = 7, // Call through a register or memory operand
+	    Interrupt = 8, // Software interrupt
+	    Return = 9, // RET, RETF or IRET
+	    Halt = 10, // HLT
+	    Invalid = 11, // Unrecognized opcode
+	};
+
+	Type type = Next;
+	int32_t rel = 0; // Displacement of near/short targets (relative to the next instruction)
+	uint16_t target_cs = 0; // Code segment of far targets
+	uint16_t target_ip = 0; // Instruction pointer of far targets
+	uint8_t int_num = 0; // Interrupt number of software interrupts
+    };
+
+    // Snapshot of the 8086's registers (and internal state)
+    struct Bee8086State
+    {
+	uint16_t ax = 0;
+	uint16_t bx = 0;
+	uint16_t cx = 0;
+	uint16_t dx = 0;
+	uint16_t ip = 0;
+	uint16_t sp = 0;
+	uint16_t bp = 0;
+	uint16_t si = 0;
+	uint16_t di = 0;
+	uint16_t cs = 0;
+	uint16_t ds = 0;
+	uint16_t ss = 0;
+	uint16_t es = 0;
+	uint16_t flags = 0;
+
+	// Number of cycles and instructions executed so far
+	uint64_t cycles = 0;
+	uint64_t instrs = 0;
+
+	// Pending prefix state
+	int mem_segment = 0;
+	bool is_segment_override = false;
+	bool is_rep = false;
     };
 
     // Class for 8086's internal registers
@@ -104,11 +181,69 @@ namespace bee8086
 	    // Runs the CPU for one instruction
 	    int runinstruction();
 
+	    // Runs the CPU for (at least) "num_cycles" cycles, stopping early
+	    // before an instruction at a breakpoint, and returns the number of cycles executed
+	    int runcycles(int num_cycles);
+
+	    // Adds/removes a breakpoint at linear address of "addr"
+	    void addbreakpoint(uint32_t addr);
+	    void removebreakpoint(uint32_t addr);
+	    void clearbreakpoints();
+
+	    // Returns true if the last call to runcycles() stopped at a breakpoint
+	    bool hitbreakpoint();
+
+	    // Returns true if there's a breakpoint at the current instruction
+	    bool atbreakpoint();
+
+	    // Lets the next instruction run even if there's a breakpoint on it,
+	    // so a debugger can resume from the breakpoint it stopped at
+	    void resume();
+
+	    // Returns true if the CPU has to stop before the current instruction
+	    // (i.e. it's at a breakpoint, and hasn't just been resumed from it or repeated it)
+	    bool stopatbreakpoint();
+
+	    // Makes the instruction that's currently running start over once it's finished
+	    // (i.e. so an interrupt override function can wait on a device while the guest keeps taking interrupts)
+	    void repeatinstruction();
+
+	    // Returns true if the last instruction asked to be repeated
+	    // (so it's about to run again without having changed anything)
+	    bool isrepeating();
+
+	    // Fetches the number of cycles and instructions executed since the CPU was initialized
+	    uint64_t getcycles();
+	    uint64_t getinstrcount();
+
+	    // Reads/writes memory through the interface
+	    // (interrupt override functions should use these, so that their side effects
+	    // can be seen by any layers wrapped around the interface, i.e. Bee8086Recorder)
+	    uint8_t readmemory(uint32_t addr);
+	    void readmemory(uint32_t addr, uint8_t *data, size_t size);
+	    void writememory(uint32_t addr, uint8_t val);
+	    void writememory(uint32_t addr, const uint8_t *data, size_t size);
+
+	    // Fetches/sets the values of all registers
+	    Bee8086State getstate();
+	    void setstate(const Bee8086State &state);
+
 	    // Prints debug output to stdout
 	    void debugoutput(bool print_disassembly = true);
 
+	    // Disassembles the instruction at "addr" and returns its length
 	    size_t disassembleinstr(ostream &stream, size_t addr);
 
+	    // Same as above, but also fetches the instruction's control flow information
+	    size_t disassembleinstr(ostream &stream, size_t addr, Bee8086FlowInfo &info);
+
+	    // Disassembles "size" bytes of memory starting at "addr" into a listing
+	    // The work is split across "num_threads" threads (0 uses all available host cores)
+	    vector<Bee8086DasmLine> disassemblerange(uint32_t addr, size_t size, int num_threads = 0);
+
+	    // Disassembles a raw image (i.e. a BIOS or a boot sector) loaded at "base_addr" into a listing
+	    vector<Bee8086DasmLine> disassembleimage(const uint8_t *data, size_t size, uint32_t base_addr, int num_threads = 0);
+
 	    // Fetches contents of registers
 	    uint8_t get_ah(); // AH
 	    uint8_t get_al(); // AL
@@ -125,6 +260,12 @@ namespace bee8086
 
 	    void set_ah(uint8_t val);
 	    void set_al(uint8_t val);
+	    void set_ch(uint8_t val);
+	    void set_cl(uint8_t val);
+	    void set_cx(uint16_t val);
+	    void set_dh(uint8_t val);
+	    void set_dl(uint8_t val);
+	    void set_dx(uint16_t val);
 	    void set_cf(bool val);
 
 	    // Fetches contents of segment registers and IP
@@ -191,6 +332,18 @@ namespace bee8086
 	    // Status register
 	    uint16_t status_reg;
 
+	    // Cycle and instruction counters
+	    uint64_t total_cycles = 0;
+	    uint64_t total_instrs = 0;
+
+	    // Breakpoints (as linear addresses)
+	    set<uint32_t> breakpoints;
+	    bool is_breakpoint_hit = false;
+	    bool is_resuming = false;
+
+	    // Set while the instruction that's running has asked to be repeated
+	    bool is_repeating = false;
+
 	    // Contains the main logic for the 8086 instruction set
 	    int executenextopcode(uint8_t opcode);
 
@@ -236,6 +389,9 @@ namespace bee8086
 	    bool isInterruptOverride(uint8_t int_num);
 	    void interruptOverride(uint8_t int_num);
 
+	    bool isInterruptPending();
+	    uint8_t acknowledgeInterrupt();
+
 	    struct ModRM
 	    {
 		int mod = 0;
@@ -256,7 +412,25 @@ namespace bee8086
 	    };
 
 	    ModRM current_mod_rm;
-	    ModRMDasm dasm_mod_rm;
+
+	    // Source of instruction bytes for the disassembler
+	    // (if "data" is NULL, bytes are read through the interface instead)
+	    struct DasmSource
+	    {
+		const uint8_t *data = NULL;
+		size_t size = 0;
+		uint32_t base = 0;
+	    };
+
+	    // Address of the opcode following the last disassembled prefix
+	    uint32_t dasm_suppress = 0xFFFFFFFF;
+
+	    // Disassembles a single instruction from "src"
+	    // (this doesn't touch any CPU state, so it's safe to call from multiple threads)
+	    size_t dasminstr(ostream &stream, size_t pc, const DasmSource &src, Bee8086FlowInfo *info = NULL);
+
+	    // Disassembles instructions from "src" in the range of [start, end) into "listing"
+	    void dasmsweep(const DasmSource &src, size_t start, size_t end, vector<Bee8086DasmLine> &listing);
 
 	    bool is_overflow()
 	    {
@@ -0,0 +1,177 @@
+/*
+    This file is part of the Bee8086 engine.
+    Copyright (C) 2022 BueniaDev.
+
+    Bee8086 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bee8086 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bee8086.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "blobstore.h"
+#include <cstring>
+using namespace bee8086;
+using namespace std;
+
+Bee8086Blob::Bee8086Blob(const uint8_t *data, size_t size, uint64_t hash) : blob_copy(data, (data + size)), blob_hash(hash)
+{
+    blob_data = blob_copy.data();
+    blob_size = blob_copy.size();
+}
+
+Bee8086Blob::Bee8086Blob(shared_ptr<const void> backing, const uint8_t *data, size_t size, uint64_t hash) : blob_backing(backing), blob_data(data), blob_size(size), blob_hash(hash)
+{
+
+}
+
+const uint8_t *Bee8086Blob::data() const
+{
+    return blob_data;
+}
+
+size_t Bee8086Blob::size() const
+{
+    return blob_size;
+}
+
+uint64_t Bee8086Blob::hash() const
+{
+    return blob_hash;
+}
+
+bool Bee8086Blob::isbacked() const
+{
+    return (blob_backing != NULL);
+}
+
+Bee8086BlobStore::Bee8086BlobStore()
+{
+
+}
+
+Bee8086BlobStore::~Bee8086BlobStore()
+{
+
+}
+
+Bee8086BlobStore &Bee8086BlobStore::get()
+{
+    static Bee8086BlobStore store;
+    return store;
+}
+
+// 64-bit FNV-1a hash
+uint64_t Bee8086BlobStore::gethash(const uint8_t *data, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    for (size_t index = 0; index < size; index++)
+    {
+	hash = ((hash ^ data[index]) * 0x100000001B3ULL);
+    }
+
+    return hash;
+}
+
+Bee8086BlobRef Bee8086BlobStore::intern(const uint8_t *data, size_t size)
+{
+    uint64_t hash = gethash(data, size);
+
+    lock_guard<mutex> lock(store_mutex);
+
+    auto range = blobs.equal_range(hash);
+
+    // Compare the contents as well, in case of a hash collision
+    for (auto it = range.first; it != range.second; it++)
+    {
+	Bee8086BlobRef blob = it->second.lock();
+
+	if (blob && !blob->isbacked() && (blob->size() == size) && (memcmp(blob->data(), data, size) == 0))
+	{
+	    return blob;
+	}
+    }
+
+    prune();
+
+    Bee8086BlobRef blob = make_shared<const Bee8086Blob>(data, size, hash);
+    blobs.emplace(hash, blob);
+    return blob;
+}
+
+Bee8086BlobRef Bee8086BlobStore::intern(const vector<uint8_t> &data)
+{
+    return intern(data.data(), data.size());
+}
+
+Bee8086BlobRef Bee8086BlobStore::intern(shared_ptr<const void> backing, const uint8_t *data, size_t size, uint64_t key)
+{
+    lock_guard<mutex> lock(store_mutex);
+
+    auto range = blobs.equal_range(key);
+
+    for (auto it = range.first; it != range.second; it++)
+    {
+	Bee8086BlobRef blob = it->second.lock();
+
+	if (blob && blob->isbacked() && (blob->size() == size))
+	{
+	    return blob;
+	}
+    }
+
+    prune();
+
+    Bee8086BlobRef blob = make_shared<const Bee8086Blob>(backing, data, size, key);
+    blobs.emplace(key, blob);
+    return blob;
+}
+
+void Bee8086BlobStore::prune()
+{
+    for (auto it = blobs.begin(); it != blobs.end();)
+    {
+	if (it->second.expired())
+	{
+	    it = blobs.erase(it);
+	}
+	else
+	{
+	    it++;
+	}
+    }
+}
+
+size_t Bee8086BlobStore::getcount()
+{
+    lock_guard<mutex> lock(store_mutex);
+    prune();
+    return blobs.size();
+}
+
+size_t Bee8086BlobStore::getsize()
+{
+    lock_guard<mutex> lock(store_mutex);
+
+    size_t total_size = 0;
+
+    for (auto &entry : blobs)
+    {
+	Bee8086BlobRef blob = entry.second.lock();
+
+	if (blob)
+	{
+	    total_size += blob->size();
+	}
+    }
+
+    return total_size;
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+/*
+    This file is part of the Bee8086 engine.
+    Copyright (C) 2022 BueniaDev.
+
+    Bee8086 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bee8086 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bee8086.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BEE8086_BLOBSTORE_H
+#define BEE8086_BLOBSTORE_H
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+using namespace std;
+
+namespace bee8086
+{
+    // Read-only blob of data (i.e. a ROM or a disk image)
+    //
+    // The blob either holds its own copy of the data,
+    // or points into storage that it keeps alive (i.e. a memory-mapped file)
+    class Bee8086Blob
+    {
+	public:
+	    Bee8086Blob(const uint8_t *data, size_t size, uint64_t hash);
+	    Bee8086Blob(shared_ptr<const void> backing, const uint8_t *data, size_t size, uint64_t hash);
+
+	    const uint8_t *data() const;
+	    size_t size() const;
+
+	    // Fetches the hash of the blob's contents,
+	    // or the key it was interned with if it points into other storage
+	    uint64_t hash() const;
+
+	    // Returns true if the blob points into other storage (instead of holding its own copy)
+	    bool isbacked() const;
+
+	private:
+	    vector<uint8_t> blob_copy;
+	    shared_ptr<const void> blob_backing;
+	    const uint8_t *blob_data = NULL;
+	    size_t blob_size = 0;
+	    uint64_t blob_hash = 0;
+    };
+
+    using Bee8086BlobRef = shared_ptr<const Bee8086Blob>;
+
+    // Process-wide, content-addressed store of read-only blobs
+    //
+    // Interning the same contents twice returns a reference to the same blob,
+    // so every machine in the process shares a single copy of each ROM and base image,
+    // and a blob is freed once the last reference to it is dropped
+    class Bee8086BlobStore
+    {
+	public:
+	    // Fetches the process-wide store
+	    static Bee8086BlobStore &get();
+
+	    // Returns a reference to a blob with the given contents (copying them into the store if needed)
+	    Bee8086BlobRef intern(const uint8_t *data, size_t size);
+	    Bee8086BlobRef intern(const vector<uint8_t> &data);
+
+	    // Returns a reference to a blob that points into "backing" (and keeps it alive) without copying it,
+	    // identified by "key" instead of its contents (i.e. a hash of the file it was mapped from),
+	    // so the data is never read here
+	    Bee8086BlobRef intern(shared_ptr<const void> backing, const uint8_t *data, size_t size, uint64_t key);
+
+	    // Fetches the number of blobs in the store, and their total size (in bytes)
+	    size_t getcount();
+	    size_t getsize();
+
+	private:
+	    Bee8086BlobStore();
+	    ~Bee8086BlobStore();
+
+	    mutex store_mutex;
+	    unordered_multimap<uint64_t, weak_ptr<const Bee8086Blob>> blobs;
+
+	    // Drops entries for blobs that have been freed
+	    void prune();
+
+	    static uint64_t gethash(const uint8_t *data, size_t size);
+    };
+};
+
+#endif // BEE8086_BLOBSTORE_H
\ No newline at end of file
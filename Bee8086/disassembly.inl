@@ -1,13 +1,34 @@
-auto dasmModRM(size_t &pc) -> void
+auto dasmByte(const DasmSource &src, size_t addr) -> uint8_t
 {
-    uint8_t byte = readByte(pc);
-    dasm_mod_rm.mod = ((byte >> 6) & 0x3);
-    dasm_mod_rm.reg = ((byte >> 3) & 0x7);
-    dasm_mod_rm.mem = (byte & 0x7);
+    if (src.data == NULL)
+    {
+	return readByte(uint32_t(addr));
+    }
+
+    size_t offs = (addr - src.base);
+    return (offs < src.size) ? src.data[offs] : 0x00;
+};
+
+auto dasmWord(const DasmSource &src, size_t addr) -> uint16_t
+{
+    uint8_t lo_byte = dasmByte(src, addr);
+    uint8_t hi_byte = dasmByte(src, (addr + 1));
+    return ((hi_byte << 8) | lo_byte);
+};
+
+// Decodes the ModR/M byte at "pc", and advances "pc" past it
+// (and any displacement bytes that follow it)
+auto dasmModRM(const DasmSource &src, size_t &pc) -> ModRMDasm
+{
+    ModRMDasm mod_rm;
+    uint8_t byte = dasmByte(src, pc++);
+    mod_rm.mod = ((byte >> 6) & 0x3);
+    mod_rm.reg = ((byte >> 3) & 0x7);
+    mod_rm.mem = (byte & 0x7);
 
     stringstream dasm_str;
 
-    if (dasm_mod_rm.mod == 3)
+    if (mod_rm.mod == 3)
     {
 	dasm_str << "reg16";
     }
@@ -16,7 +37,21 @@ auto dasmModRM(size_t &pc) -> void
 	dasm_str << "mem16";
     }
 
-    dasm_mod_rm.dasm_str = dasm_str.str();
+    if ((mod_rm.mod == 0) && (mod_rm.mem == 6))
+    {
+	pc += 2;
+    }
+    else if (mod_rm.mod == 1)
+    {
+	pc += 1;
+    }
+    else if (mod_rm.mod == 2)
+    {
+	pc += 2;
+    }
+
+    mod_rm.dasm_str = dasm_str.str();
+    return mod_rm;
 };
 
 auto dasmSeg(int reg) -> string
@@ -0,0 +1,743 @@
+/*
+    This file is part of the Bee8086 engine.
+    Copyright (C) 2022 BueniaDev.
+
+    Bee8086 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bee8086 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bee8086.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "gdbstub.h"
+#include <cstring>
+#include <iomanip>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define poll WSAPoll
+#define closesocket_bee closesocket
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#define closesocket_bee ::close
+#endif
+
+using namespace bee8086;
+using namespace std;
+
+Bee8086GDBStub::Bee8086GDBStub(Bee8086 &cpu, Bee8086Interface &cb) : core(cpu), inter(cb)
+{
+
+}
+
+Bee8086GDBStub::~Bee8086GDBStub()
+{
+    close();
+}
+
+bool Bee8086GDBStub::listen(string address)
+{
+#ifdef _WIN32
+    WSADATA wsa_data;
+
+    if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0)
+    {
+	cout << "Error: could not initialize Winsock" << endl;
+	return false;
+    }
+#endif
+
+    if (address.compare(0, 5, "unix:") == 0)
+    {
+#ifdef _WIN32
+	cout << "Error: Unix sockets are not supported on this platform" << endl;
+	return false;
+#else
+	unix_path = address.substr(5);
+
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+
+	if (unix_path.empty() || (unix_path.size() >= sizeof(addr.sun_path)))
+	{
+	    cout << "Error: invalid socket path of " << unix_path << endl;
+	    return false;
+	}
+
+	strncpy(addr.sun_path, unix_path.c_str(), (sizeof(addr.sun_path) - 1));
+	unlink(unix_path.c_str());
+
+	server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if ((server_fd < 0) || (bind(server_fd, (sockaddr*)&addr, sizeof(addr)) < 0))
+	{
+	    cout << "Error: could not bind to " << unix_path << endl;
+	    close();
+	    return false;
+	}
+#endif
+    }
+    else
+    {
+	int port = atoi(address.c_str());
+
+	if ((port <= 0) || (port > 0xFFFF))
+	{
+	    cout << "Error: invalid port of " << address << endl;
+	    return false;
+	}
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	server_fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	int reuse = 1;
+	setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+	if ((server_fd < 0) || (bind(server_fd, (sockaddr*)&addr, sizeof(addr)) < 0))
+	{
+	    cout << "Error: could not bind to port " << dec << port << endl;
+	    close();
+	    return false;
+	}
+    }
+
+    if (::listen(server_fd, 1) < 0)
+    {
+	cout << "Error: could not listen for GDB connections" << endl;
+	close();
+	return false;
+    }
+
+    return true;
+}
+
+bool Bee8086GDBStub::waitforclient()
+{
+    if (server_fd < 0)
+    {
+	return false;
+    }
+
+    cout << "Waiting for GDB to connect..." << endl;
+    client_fd = accept(server_fd, NULL, NULL);
+
+    if (client_fd < 0)
+    {
+	cout << "Error: could not accept GDB connection" << endl;
+	return false;
+    }
+
+    if (unix_path.empty())
+    {
+	int nodelay = 1;
+	setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&nodelay, sizeof(nodelay));
+    }
+
+    cout << "GDB connected." << endl;
+    is_running = false;
+    rx_pos = 0;
+    rx_size = 0;
+    return true;
+}
+
+void Bee8086GDBStub::close()
+{
+    if (client_fd >= 0)
+    {
+	closesocket_bee(client_fd);
+	client_fd = -1;
+    }
+
+    if (server_fd >= 0)
+    {
+	closesocket_bee(server_fd);
+	server_fd = -1;
+
+#ifndef _WIN32
+	if (!unix_path.empty())
+	{
+	    unlink(unix_path.c_str());
+	}
+#endif
+    }
+}
+
+bool Bee8086GDBStub::isconnected()
+{
+    return (client_fd >= 0);
+}
+
+void Bee8086GDBStub::settimetravel(Bee8086TimeTravel *tt)
+{
+    time_travel = tt;
+}
+
+void Bee8086GDBStub::setscheduler(Bee8086Scheduler *sched)
+{
+    scheduler = sched;
+}
+
+int Bee8086GDBStub::runcpu(int num_cycles)
+{
+    if (time_travel != NULL)
+    {
+	return time_travel->runcycles(num_cycles);
+    }
+
+    if (scheduler != NULL)
+    {
+	return scheduler->runcycles(num_cycles);
+    }
+
+    return core.runcycles(num_cycles);
+}
+
+int Bee8086GDBStub::stepcpu()
+{
+    if (time_travel != NULL)
+    {
+	return time_travel->step();
+    }
+
+    int cycles = core.runinstruction();
+
+    if (scheduler != NULL)
+    {
+	scheduler->runevents();
+    }
+
+    return cycles;
+}
+
+bool Bee8086GDBStub::hitbreakpoint()
+{
+    if (time_travel != NULL)
+    {
+	return time_travel->hitbreakpoint();
+    }
+
+    return core.hitbreakpoint();
+}
+
+int Bee8086GDBStub::run(int num_cycles)
+{
+    // Once GDB has detached, the machine just runs freely
+    if (!isconnected())
+    {
+	return runcpu(num_cycles);
+    }
+
+    int cycles = 0;
+
+    // Serve GDB's requests until it resumes the CPU
+    while (isconnected() && !is_running)
+    {
+	string packet = "";
+	bool is_interrupt = false;
+
+	if (!readpacket(packet, is_interrupt))
+	{
+	    break;
+	}
+
+	if (is_interrupt)
+	{
+	    sendpacket("S02");
+	    continue;
+	}
+
+	handlepacket(packet);
+    }
+
+    cycles += step_cycles;
+    step_cycles = 0;
+
+    if (!isconnected() || !is_running)
+    {
+	return cycles;
+    }
+
+    cycles += runcpu(num_cycles);
+
+    if (hitbreakpoint())
+    {
+	is_running = false;
+	sendpacket("S05");
+    }
+    else if (checkinterrupt())
+    {
+	is_running = false;
+	sendpacket("S02");
+    }
+
+    return cycles;
+}
+
+int Bee8086GDBStub::readbyte(bool blocking)
+{
+    if (rx_pos < rx_size)
+    {
+	return uint8_t(rx_buffer[rx_pos++]);
+    }
+
+    if (!blocking)
+    {
+	pollfd pfd;
+	pfd.fd = client_fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	if (poll(&pfd, 1, 0) <= 0)
+	{
+	    return -1;
+	}
+    }
+
+    int size = recv(client_fd, rx_buffer, sizeof(rx_buffer), 0);
+
+    if (size <= 0)
+    {
+	cout << "GDB disconnected." << endl;
+	closesocket_bee(client_fd);
+	client_fd = -1;
+	return -2;
+    }
+
+    rx_pos = 0;
+    rx_size = size;
+    return uint8_t(rx_buffer[rx_pos++]);
+}
+
+bool Bee8086GDBStub::writedata(const string &data)
+{
+    size_t offs = 0;
+
+    while (offs < data.size())
+    {
+	int size = send(client_fd, (data.c_str() + offs), (data.size() - offs), 0);
+
+	if (size <= 0)
+	{
+	    return false;
+	}
+
+	offs += size;
+    }
+
+    return true;
+}
+
+bool Bee8086GDBStub::readpacket(string &packet, bool &is_interrupt)
+{
+    while (true)
+    {
+	int data = readbyte(true);
+
+	if (data < 0)
+	{
+	    return false;
+	}
+
+	switch (data)
+	{
+	    case 0x03: is_interrupt = true; return true; break;
+	    case '-': writedata(last_packet); break;
+	    case '$':
+	    {
+		packet.clear();
+		uint8_t checksum = 0;
+
+		while (((data = readbyte(true)) >= 0) && (data != '#'))
+		{
+		    packet.push_back(char(data));
+		    checksum += uint8_t(data);
+		}
+
+		int hi_nibble = readbyte(true);
+		int lo_nibble = readbyte(true);
+
+		if ((data < 0) || (hi_nibble < 0) || (lo_nibble < 0))
+		{
+		    return false;
+		}
+
+		string checksum_str = {char(hi_nibble), char(lo_nibble)};
+
+		if (strtoul(checksum_str.c_str(), NULL, 16) != checksum)
+		{
+		    writedata("-");
+		    continue;
+		}
+
+		writedata("+");
+		return true;
+	    }
+	    break;
+	    default: break; // Acknowledgements and stray bytes
+	}
+    }
+}
+
+void Bee8086GDBStub::sendpacket(const string &data)
+{
+    uint8_t checksum = 0;
+
+    for (auto c : data)
+    {
+	checksum += uint8_t(c);
+    }
+
+    stringstream packet;
+    packet << "$" << data << "#" << hex << setw(2) << setfill('0') << int(checksum);
+    last_packet = packet.str();
+    writedata(last_packet);
+}
+
+bool Bee8086GDBStub::checkinterrupt()
+{
+    int data = 0;
+
+    while ((data = readbyte(false)) >= 0)
+    {
+	if (data == 0x03)
+	{
+	    return true;
+	}
+    }
+
+    return false;
+}
+
+bool Bee8086GDBStub::handlepacket(const string &packet)
+{
+    if (packet.empty())
+    {
+	sendpacket("");
+	return true;
+    }
+
+    string args = packet.substr(1);
+
+    switch (packet[0])
+    {
+	case '?': sendpacket("S05"); break;
+	case 'g': sendpacket(readregisters()); break;
+	case 'G':
+	{
+	    writeregisters(args);
+	    sendpacket("OK");
+	}
+	break;
+	case 'p':
+	{
+	    int index = strtol(args.c_str(), NULL, 16);
+
+	    if (index < 16)
+	    {
+		sendpacket(tohex(getregister(index), 4));
+	    }
+	    else
+	    {
+		sendpacket("xxxxxxxx");
+	    }
+	}
+	break;
+	case 'P':
+	{
+	    size_t equals = args.find('=');
+
+	    if (equals == string::npos)
+	    {
+		sendpacket("E01");
+		break;
+	    }
+
+	    int index = strtol(args.c_str(), NULL, 16);
+	    setregister(index, fromhex(args, (equals + 1), 4));
+	    sendpacket("OK");
+	}
+	break;
+	case 'm':
+	{
+	    size_t comma = args.find(',');
+
+	    if (comma == string::npos)
+	    {
+		sendpacket("E01");
+		break;
+	    }
+
+	    uint32_t addr = strtoul(args.c_str(), NULL, 16);
+	    size_t length = strtoul(args.c_str() + comma + 1, NULL, 16);
+	    string data = "";
+
+	    for (size_t index = 0; index < length; index++)
+	    {
+		data += tohex(inter.readByte((addr + index) & 0xFFFFF), 1);
+	    }
+
+	    sendpacket(data);
+	}
+	break;
+	case 'M':
+	{
+	    size_t comma = args.find(',');
+	    size_t colon = args.find(':');
+
+	    if ((comma == string::npos) || (colon == string::npos))
+	    {
+		sendpacket("E01");
+		break;
+	    }
+
+	    uint32_t addr = strtoul(args.c_str(), NULL, 16);
+	    size_t length = strtoul(args.c_str() + comma + 1, NULL, 16);
+
+	    for (size_t index = 0; index < length; index++)
+	    {
+		inter.writeByte(((addr + index) & 0xFFFFF), fromhex(args, (colon + 1 + (index * 2)), 1));
+	    }
+
+	    sendpacket("OK");
+	}
+	break;
+	case 'c':
+	{
+	    // Don't stop straight away at the breakpoint we're resuming from
+	    core.resume();
+	    is_running = true;
+	    return false;
+	}
+	break;
+	case 's':
+	{
+	    core.resume();
+	    step_cycles += stepcpu();
+	    sendpacket("S05");
+	}
+	break;
+	case 'b':
+	{
+	    // Reverse execution (only available with a time-travel debugger)
+	    if ((time_travel == NULL) || ((args != "s") && (args != "c")))
+	    {
+		sendpacket("");
+		break;
+	    }
+
+	    bool is_stopped = (args == "s") ? time_travel->reversestep() : time_travel->reversecontinue();
+	    sendpacket(is_stopped ? "S05" : "T05replaylog:begin;");
+	}
+	break;
+	case 'Z':
+	case 'z':
+	{
+	    // Software and hardware breakpoints are handled the same way
+	    if ((args.size() < 3) || ((args[0] != '0') && (args[0] != '1')))
+	    {
+		sendpacket("");
+		break;
+	    }
+
+	    uint32_t addr = strtoul(args.c_str() + 2, NULL, 16);
+
+	    if (packet[0] == 'Z')
+	    {
+		core.addbreakpoint(addr);
+	    }
+	    else
+	    {
+		core.removebreakpoint(addr);
+	    }
+
+	    sendpacket("OK");
+	}
+	break;
+	case 'q':
+	{
+	    if (args.compare(0, 9, "Supported") == 0)
+	    {
+		string features = "PacketSize=1000";
+
+		if (time_travel != NULL)
+		{
+		    features += ";ReverseStep+;ReverseContinue+";
+		}
+
+		sendpacket(features);
+	    }
+	    else if (args == "Attached")
+	    {
+		sendpacket("1");
+	    }
+	    else if (args == "fThreadInfo")
+	    {
+		sendpacket("m1");
+	    }
+	    else if (args == "sThreadInfo")
+	    {
+		sendpacket("l");
+	    }
+	    else if (args == "C")
+	    {
+		sendpacket("QC1");
+	    }
+	    else
+	    {
+		sendpacket("");
+	    }
+	}
+	break;
+	case 'H': sendpacket("OK"); break;
+	case 'D':
+	{
+	    sendpacket("OK");
+	    core.clearbreakpoints();
+	    closesocket_bee(client_fd);
+	    client_fd = -1;
+	    return false;
+	}
+	break;
+	case 'k':
+	{
+	    core.clearbreakpoints();
+	    closesocket_bee(client_fd);
+	    client_fd = -1;
+	    return false;
+	}
+	break;
+	default: sendpacket(""); break;
+    }
+
+    return true;
+}
+
+// Registers are laid out in the same order as GDB's i386 registers:
+// EAX, ECX, EDX, EBX, ESP, EBP, ESI, EDI, EIP, EFLAGS, CS, SS, DS, ES, FS, GS
+uint32_t Bee8086GDBStub::getregister(int index)
+{
+    Bee8086State state = core.getstate();
+
+    switch (index)
+    {
+	case 0: return state.ax; break;
+	case 1: return state.cx; break;
+	case 2: return state.dx; break;
+	case 3: return state.bx; break;
+	case 4: return state.sp; break;
+	case 5: return state.bp; break;
+	case 6: return state.si; break;
+	case 7: return state.di; break;
+	case 8: return state.ip; break;
+	case 9: return state.flags; break;
+	case 10: return state.cs; break;
+	case 11: return state.ss; break;
+	case 12: return state.ds; break;
+	case 13: return state.es; break;
+	default: return 0; break;
+    }
+}
+
+void Bee8086GDBStub::setregister(int index, uint32_t val)
+{
+    Bee8086State state = core.getstate();
+    uint16_t reg_val = (val & 0xFFFF);
+
+    switch (index)
+    {
+	case 0: state.ax = reg_val; break;
+	case 1: state.cx = reg_val; break;
+	case 2: state.dx = reg_val; break;
+	case 3: state.bx = reg_val; break;
+	case 4: state.sp = reg_val; break;
+	case 5: state.bp = reg_val; break;
+	case 6: state.si = reg_val; break;
+	case 7: state.di = reg_val; break;
+	case 8: state.ip = reg_val; break;
+	case 9: state.flags = reg_val; break;
+	case 10: state.cs = reg_val; break;
+	case 11: state.ss = reg_val; break;
+	case 12: state.ds = reg_val; break;
+	case 13: state.es = reg_val; break;
+	default: return; break;
+    }
+
+    core.setstate(state);
+}
+
+string Bee8086GDBStub::readregisters()
+{
+    string data = "";
+
+    for (int index = 0; index < 16; index++)
+    {
+	data += tohex(getregister(index), 4);
+    }
+
+    return data;
+}
+
+void Bee8086GDBStub::writeregisters(const string &data)
+{
+    for (int index = 0; index < 16; index++)
+    {
+	if (data.size() < size_t((index + 1) * 8))
+	{
+	    break;
+	}
+
+	setregister(index, fromhex(data, (index * 8), 4));
+    }
+}
+
+// Converts a value to a little-endian hex string
+string Bee8086GDBStub::tohex(uint32_t val, int num_bytes)
+{
+    stringstream ss;
+
+    for (int index = 0; index < num_bytes; index++)
+    {
+	ss << hex << setw(2) << setfill('0') << int((val >> (index * 8)) & 0xFF);
+    }
+
+    return ss.str();
+}
+
+// Converts a little-endian hex string to a value
+uint32_t Bee8086GDBStub::fromhex(const string &str, size_t offs, int num_bytes)
+{
+    uint32_t val = 0;
+
+    for (int index = 0; index < num_bytes; index++)
+    {
+	if ((offs + (index * 2) + 2) > str.size())
+	{
+	    break;
+	}
+
+	uint32_t byte = strtoul(str.substr((offs + (index * 2)), 2).c_str(), NULL, 16);
+	val |= (byte << (index * 8));
+    }
+
+    return val;
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+/*
+    This file is part of the Bee8086 engine.
+    Copyright (C) 2022 BueniaDev.
+
+    Bee8086 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bee8086 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bee8086.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BEE8086_GDBSTUB_H
+#define BEE8086_GDBSTUB_H
+
+#include <cstdint>
+#include "timetravel.h"
+using namespace std;
+
+namespace bee8086
+{
+    // Stub for the GDB remote serial protocol
+    //
+    // Registers are exposed using GDB's i386 register layout (as used by "set architecture i8086"),
+    // and memory and breakpoint addresses are linear (i.e. 0000:7C00 is at address 0x7C00)
+    class Bee8086GDBStub
+    {
+	public:
+	    Bee8086GDBStub(Bee8086 &cpu, Bee8086Interface &cb);
+	    ~Bee8086GDBStub();
+
+	    // Listens for a connection on "address", which is either a TCP port
+	    // on the loopback interface (i.e. "1234"), or a Unix socket (i.e. "unix:/tmp/bee8086.sock")
+	    bool listen(string address);
+
+	    // Waits for GDB to connect (the CPU starts out stopped)
+	    bool waitforclient();
+
+	    // Closes the connection and the listening socket
+	    void close();
+
+	    // Returns true if GDB is still connected
+	    bool isconnected();
+
+	    // Sets the time-travel debugger used to run the CPU (or NULL to run it directly),
+	    // which allows GDB's reverse-stepi and reverse-continue commands to be used
+	    void settimetravel(Bee8086TimeTravel *tt);
+
+	    // Sets the scheduler used to run the CPU (or NULL to run it directly),
+	    // so that device events run on the cycle they're due while GDB is attached
+	    void setscheduler(Bee8086Scheduler *sched);
+
+	    // Runs the CPU for up to "num_cycles" cycles if GDB has resumed it, or serves GDB's requests
+	    // (blocking) until it does if the CPU is stopped, and returns the number of cycles executed
+	    int run(int num_cycles);
+
+	private:
+	    Bee8086 &core;
+	    Bee8086Interface &inter;
+	    Bee8086TimeTravel *time_travel = NULL;
+	    Bee8086Scheduler *scheduler = NULL;
+
+	    intptr_t server_fd = -1;
+	    intptr_t client_fd = -1;
+	    string unix_path = "";
+
+	    bool is_running = false;
+	    int step_cycles = 0;
+	    string last_packet = "";
+
+	    char rx_buffer[4096];
+	    size_t rx_pos = 0;
+	    size_t rx_size = 0;
+
+	    // Reads a byte from the client (returns -1 if none is available
+	    // and "blocking" is false, and -2 if the connection was closed)
+	    int readbyte(bool blocking);
+	    bool writedata(const string &data);
+
+	    // Reads a packet (or an interrupt request) from the client, and returns false if the connection was lost
+	    bool readpacket(string &packet, bool &is_interrupt);
+	    void sendpacket(const string &data);
+
+	    // Handles a single packet, and returns false once the CPU has been resumed
+	    bool handlepacket(const string &packet);
+
+	    // Checks if GDB has asked to stop a running CPU
+	    bool checkinterrupt();
+
+	    // Runs the CPU (through the time-travel debugger or the scheduler, if there is one)
+	    int runcpu(int num_cycles);
+	    int stepcpu();
+	    bool hitbreakpoint();
+
+	    string readregisters();
+	    void writeregisters(const string &data);
+	    uint32_t getregister(int index);
+	    void setregister(int index, uint32_t val);
+
+	    string tohex(uint32_t val, int num_bytes);
+	    uint32_t fromhex(const string &str, size_t offs, int num_bytes);
+    };
+};
+
+#endif // BEE8086_GDBSTUB_H
\ No newline at end of file
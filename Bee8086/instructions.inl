@@ -780,6 +780,24 @@ auto interruptCall(uint8_t int_num) -> void
     cs = readWord(int_addr + 2);
 }
 
+// Hardware interrupts always go through the interrupt vector table
+// (they can't be overridden, since the guest's handler is what acknowledges the device)
+auto hardwareInterrupt(uint8_t int_num) -> int
+{
+    pushReg(status_reg);
+    pushReg(cs);
+    pushReg(ip);
+
+    // Interrupts and single-stepping are disabled inside the handler
+    set_irq(false);
+    status_reg &= ~0x100;
+
+    uint32_t int_addr = (int_num * 4);
+    ip = readWord(int_addr);
+    cs = readWord(int_addr + 2);
+    return 61;
+}
+
 auto intRet() -> int
 {
     popReg(ip);
@@ -0,0 +1,429 @@
+/*
+    This file is part of the Bee8086 engine.
+    Copyright (C) 2022 BueniaDev.
+
+    Bee8086 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bee8086 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bee8086.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "memorymap.h"
+#include <cstring>
+#include <algorithm>
+#include <iomanip>
+using namespace bee8086;
+using namespace std;
+
+// Backing memory for every untouched sparse RAM page
+static const uint8_t zero_page[Bee8086MemoryMap::page_size] = {0};
+
+Bee8086MemoryMap::Bee8086MemoryMap()
+{
+    cleardirty();
+}
+
+Bee8086MemoryMap::~Bee8086MemoryMap()
+{
+
+}
+
+bool Bee8086MemoryMap::addregion(const Bee8086MemoryRegion &region)
+{
+    if (((region.addr & page_mask) != 0) || ((region.size & page_mask) != 0) || ((region.mirror & page_mask) != 0))
+    {
+	cout << "Error: memory region " << region.name << " is not page-aligned" << endl;
+	return false;
+    }
+
+    if ((region.addr + region.size) > 0x100000)
+    {
+	cout << "Error: memory region " << region.name << " is out of range" << endl;
+	return false;
+    }
+
+    bool is_sparse = (region.type == Bee8086MemoryRegion::SparseRAM);
+    bool is_private = (is_sparse || (region.type == Bee8086MemoryRegion::CopyOnWrite));
+
+    if ((region.type != Bee8086MemoryRegion::MMIO) && !is_sparse && (region.data == NULL))
+    {
+	cout << "Error: memory region " << region.name << " has no backing memory" << endl;
+	return false;
+    }
+
+    int index = regions.size();
+    regions.push_back(region);
+    private_pages.emplace_back();
+
+    if (is_private)
+    {
+	uint32_t data_size = (region.mirror != 0) ? region.mirror : region.size;
+	private_pages.back().resize(data_size >> page_shift);
+    }
+
+    for (uint32_t offs = 0; offs < region.size; offs += page_size)
+    {
+	Page &page = pages[(region.addr + offs) >> page_shift];
+	page.region = index;
+	page.offs = offs;
+	page.dirty_addr = (region.addr + ((region.mirror != 0) ? (offs % region.mirror) : offs));
+	page.read_ptr = NULL;
+	page.write_ptr = NULL;
+
+	if (is_sparse)
+	{
+	    page.read_ptr = const_cast<uint8_t*>(zero_page);
+	}
+	else if (region.type != Bee8086MemoryRegion::MMIO)
+	{
+	    uint32_t data_offs = (region.mirror != 0) ? (offs % region.mirror) : offs;
+	    page.read_ptr = (region.data + data_offs);
+
+	    if (region.type == Bee8086MemoryRegion::RAM)
+	    {
+		page.write_ptr = page.read_ptr;
+	    }
+	}
+    }
+
+    return true;
+}
+
+bool Bee8086MemoryMap::addregions(const vector<Bee8086MemoryRegion> &region_list)
+{
+    for (auto &region : region_list)
+    {
+	if (!addregion(region))
+	{
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+void Bee8086MemoryMap::clear()
+{
+    pages.fill(Page());
+    regions.clear();
+    private_pages.clear();
+    num_touched_pages = 0;
+}
+
+size_t Bee8086MemoryMap::gettouchedpages()
+{
+    return num_touched_pages;
+}
+
+bool Bee8086MemoryMap::commitpage(uint32_t addr)
+{
+    const Page &page = pages[addr >> page_shift];
+
+    if ((page.region < 0) || (page.write_ptr != NULL))
+    {
+	return false;
+    }
+
+    int index = page.region;
+    const Bee8086MemoryRegion &region = regions[index];
+
+    if ((region.type != Bee8086MemoryRegion::SparseRAM) && (region.type != Bee8086MemoryRegion::CopyOnWrite))
+    {
+	return false;
+    }
+
+    uint32_t data_offs = (region.mirror != 0) ? (page.offs % region.mirror) : page.offs;
+
+    // Start off with whatever the page held before (zeroes or the shared contents)
+    unique_ptr<uint8_t[]> &data = private_pages[index][data_offs >> page_shift];
+    data.reset(new uint8_t[page_size]);
+    memcpy(data.get(), page.read_ptr, page_size);
+    num_touched_pages += 1;
+
+    // Point every page that mirrors this one at the new memory
+    for (uint32_t offs = data_offs; offs < region.size; offs += ((region.mirror != 0) ? region.mirror : region.size))
+    {
+	Page &mirror_page = pages[(region.addr + offs) >> page_shift];
+
+	if (mirror_page.region == index)
+	{
+	    mirror_page.read_ptr = data.get();
+	    mirror_page.write_ptr = data.get();
+	}
+    }
+
+    return true;
+}
+
+const Bee8086MemoryRegion *Bee8086MemoryMap::getregion(uint32_t addr)
+{
+    int index = pages[(addr & 0xFFFFF) >> page_shift].region;
+    return (index >= 0) ? &regions[index] : NULL;
+}
+
+uint8_t *Bee8086MemoryMap::getpointer(uint32_t addr)
+{
+    addr &= 0xFFFFF;
+    uint8_t *page_ptr = pages[addr >> page_shift].read_ptr;
+    return (page_ptr != NULL) ? (page_ptr + (addr & page_mask)) : NULL;
+}
+
+uint8_t Bee8086MemoryMap::readslow(uint32_t addr)
+{
+    const Page &page = pages[addr >> page_shift];
+
+    if (page.region < 0)
+    {
+	return 0xFF;
+    }
+
+    const Bee8086MemoryRegion &region = regions[page.region];
+
+    if (!region.read)
+    {
+	return 0xFF;
+    }
+
+    return region.read(page.offs + (addr & page_mask));
+}
+
+void Bee8086MemoryMap::writeslow(uint32_t addr, uint8_t data)
+{
+    const Page &page = pages[addr >> page_shift];
+
+    if (page.region < 0)
+    {
+	return;
+    }
+
+    const Bee8086MemoryRegion &region = regions[page.region];
+
+    if ((region.type == Bee8086MemoryRegion::MMIO) && region.write)
+    {
+	region.write((page.offs + (addr & page_mask)), data);
+    }
+    else if (commitpage(addr))
+    {
+	page.write_ptr[addr & page_mask] = data;
+	markdirty(page.dirty_addr | (addr & page_mask));
+    }
+}
+
+void Bee8086MemoryMap::readBlock(uint32_t addr, uint8_t *data, size_t size)
+{
+    while (size > 0)
+    {
+	addr &= 0xFFFFF;
+	const Page &page = pages[addr >> page_shift];
+	uint32_t page_offs = (addr & page_mask);
+	size_t length = min<size_t>(size, (page_size - page_offs));
+
+	if (page.read_ptr != NULL)
+	{
+	    memcpy(data, (page.read_ptr + page_offs), length);
+	}
+	else
+	{
+	    for (size_t index = 0; index < length; index++)
+	    {
+		data[index] = readslow(addr + index);
+	    }
+	}
+
+	addr += length;
+	data += length;
+	size -= length;
+    }
+}
+
+void Bee8086MemoryMap::writeBlock(uint32_t addr, const uint8_t *data, size_t size)
+{
+    while (size > 0)
+    {
+	addr &= 0xFFFFF;
+	const Page &page = pages[addr >> page_shift];
+	uint32_t page_offs = (addr & page_mask);
+	size_t length = min<size_t>(size, (page_size - page_offs));
+
+	// Writing what's already there (i.e. zeroes to untouched sparse RAM) doesn't need to allocate the page
+	if ((page.write_ptr == NULL) && (page.read_ptr != NULL) && (memcmp((page.read_ptr + page_offs), data, length) != 0))
+	{
+	    commitpage(addr);
+	}
+
+	if (page.write_ptr != NULL)
+	{
+	    memcpy((page.write_ptr + page_offs), data, length);
+	    markdirtyrange((page.dirty_addr | page_offs), length);
+	}
+	else if (page.read_ptr == NULL)
+	{
+	    for (size_t index = 0; index < length; index++)
+	    {
+		writeslow((addr + index), data[index]);
+	    }
+	}
+
+	addr += length;
+	data += length;
+	size -= length;
+    }
+}
+
+void Bee8086MemoryMap::printmap(ostream &stream)
+{
+    const char *type_names[] = {"RAM", "ROM", "MMIO", "Sparse RAM", "Copy-on-write RAM"};
+
+    uint32_t page = 0;
+
+    while (page < num_pages)
+    {
+	int region = pages[page].region;
+	uint32_t start = page;
+
+	while ((page < num_pages) && (pages[page].region == region))
+	{
+	    page += 1;
+	}
+
+	stream << hex << uppercase << setw(5) << setfill('0') << (start << page_shift) << "-";
+	stream << setw(5) << setfill('0') << ((page << page_shift) - 1) << ": ";
+
+	if (region < 0)
+	{
+	    stream << "(unmapped)";
+	}
+	else
+	{
+	    stream << type_names[regions[region].type] << " " << regions[region].name;
+	}
+
+	stream << nouppercase << dec << endl;
+    }
+}
+
+void Bee8086MemoryMap::markdirtyrange(uint32_t addr, size_t size)
+{
+    forrange(addr, size, [this](uint32_t word_index, uint64_t mask)
+    {
+	atomic<uint64_t> &word = dirty_bits[word_index];
+
+	if ((word.load(memory_order_relaxed) & mask) != mask)
+	{
+	    word.fetch_or(mask, memory_order_release);
+	}
+    });
+}
+
+void Bee8086MemoryMap::forrange(uint32_t addr, uint32_t size, function<void(uint32_t, uint64_t)> func)
+{
+    if (size == 0)
+    {
+	return;
+    }
+
+    uint32_t first_block = ((addr & 0xFFFFF) >> dirty_shift);
+    uint32_t last_block = min<uint32_t>((((addr & 0xFFFFF) + size - 1) >> dirty_shift), ((num_dirty_words * 64) - 1));
+
+    for (uint32_t word_index = (first_block >> 6); word_index <= (last_block >> 6); word_index++)
+    {
+	uint32_t low = max<uint32_t>(first_block, (word_index * 64)) & 63;
+	uint32_t high = min<uint32_t>(last_block, ((word_index * 64) + 63)) & 63;
+	uint64_t mask = ((high == 63) ? ~0ULL : ((1ULL << (high + 1)) - 1)) & ~((1ULL << low) - 1);
+	func(word_index, mask);
+    }
+}
+
+bool Bee8086MemoryMap::isdirty(uint32_t addr, uint32_t size)
+{
+    lock_guard<mutex> lock(pending_mutex);
+    bool is_dirty = false;
+
+    forrange(addr, size, [&](uint32_t word_index, uint64_t mask)
+    {
+	is_dirty |= (((dirty_bits[word_index].load(memory_order_acquire) | range_pending[word_index]) & mask) != 0);
+    });
+
+    return is_dirty;
+}
+
+bool Bee8086MemoryMap::fetchdirty(uint32_t addr, uint32_t size)
+{
+    lock_guard<mutex> lock(pending_mutex);
+    bool is_dirty = false;
+
+    forrange(addr, size, [&](uint32_t word_index, uint64_t mask)
+    {
+	atomic<uint64_t> &word = dirty_bits[word_index];
+	uint64_t bits = 0;
+
+	// Skip the locked operation for words that don't have any of the bits set
+	if ((word.load(memory_order_relaxed) & mask) != 0)
+	{
+	    bits = (word.fetch_and(~mask, memory_order_acq_rel) & mask);
+	}
+
+	// Fetching pages still has to see these bits
+	page_pending[word_index] |= bits;
+	bits |= (range_pending[word_index] & mask);
+	range_pending[word_index] &= ~mask;
+	is_dirty |= (bits != 0);
+    });
+
+    return is_dirty;
+}
+
+vector<uint32_t> Bee8086MemoryMap::fetchdirtypages()
+{
+    lock_guard<mutex> lock(pending_mutex);
+    vector<uint32_t> dirty_pages;
+
+    // Each word covers 4 pages (16 blocks per page)
+    constexpr uint32_t blocks_per_page = (page_size / dirty_block_size);
+
+    for (uint32_t word_index = 0; word_index < num_dirty_words; word_index++)
+    {
+	uint64_t bits = 0;
+
+	if (dirty_bits[word_index].load(memory_order_relaxed) != 0)
+	{
+	    bits = dirty_bits[word_index].exchange(0, memory_order_acq_rel);
+	}
+
+	// Fetching ranges still has to see these bits
+	range_pending[word_index] |= bits;
+	bits |= page_pending[word_index];
+	page_pending[word_index] = 0;
+
+	for (uint32_t page = 0; page < (64 / blocks_per_page); page++)
+	{
+	    if (((bits >> (page * blocks_per_page)) & ((1ULL << blocks_per_page) - 1)) != 0)
+	    {
+		dirty_pages.push_back(((word_index * 64) + (page * blocks_per_page)) << dirty_shift);
+	    }
+	}
+    }
+
+    return dirty_pages;
+}
+
+void Bee8086MemoryMap::cleardirty()
+{
+    lock_guard<mutex> lock(pending_mutex);
+
+    for (auto &word : dirty_bits)
+    {
+	word.store(0, memory_order_relaxed);
+    }
+
+    range_pending.fill(0);
+    page_pending.fill(0);
+}
\ No newline at end of file
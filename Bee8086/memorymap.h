@@ -0,0 +1,207 @@
+/*
+    This file is part of the Bee8086 engine.
+    Copyright (C) 2022 BueniaDev.
+
+    Bee8086 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bee8086 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bee8086.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BEE8086_MEMORYMAP_H
+#define BEE8086_MEMORYMAP_H
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include "bee8086.h"
+using namespace std;
+
+namespace bee8086
+{
+    // Region of the 8086's address space
+    struct Bee8086MemoryRegion
+    {
+	enum Type : int
+	{
+	    RAM = 0,
+	    ROM = 1, // Writes are ignored
+	    MMIO = 2, // Accesses are passed to the read and write handlers
+	    SparseRAM = 3, // RAM owned by the memory map, where each page is only allocated when it's first written to
+	    CopyOnWrite = 4, // RAM that starts out as a (shared, read-only) copy of the backing memory,
+			     // where each page is copied when it's first written to
+	};
+
+	string name = "";
+	uint32_t addr = 0; // Start address (must be page-aligned)
+	uint32_t size = 0; // Size (must be a multiple of the page size)
+	Type type = RAM;
+	uint8_t *data = NULL; // Backing memory for RAM, ROM and copy-on-write regions (unused for sparse RAM)
+	uint32_t mirror = 0; // If non-zero, the backing memory repeats every "mirror" bytes
+	function<uint8_t(uint32_t)> read; // MMIO read handler (called with the offset into the region)
+	function<void(uint32_t, uint8_t)> write; // MMIO write handler (called with the offset into the region)
+    };
+
+    // Maps the 1 MB address space in fixed-size pages to RAM, ROM or MMIO handlers,
+    // so that each access is dispatched with a single table lookup
+    //
+    // Unmapped addresses read as open bus (0xFF), and writes to them are ignored
+    //
+    // Untouched sparse RAM pages all point to a shared zero page for reads (and untouched copy-on-write pages
+    // to their backing memory), and have no write pointer, so the first write to one of them takes the slow path,
+    // which allocates a private copy of the page
+    //
+    // Every write to RAM marks its 256-byte block as dirty, so that other threads
+    // (i.e. the video renderer) can cheaply find out what has changed since they last checked
+    // (writes through a mirror mark the block they really go to, and MMIO writes aren't tracked)
+    //
+    // Ranges (fetchdirty()) and whole pages (fetchdirtypages()) are fetched separately, so that
+    // the video adapters and the time-travel checkpoints each see every write, without clearing it for the other
+    class Bee8086MemoryMap
+    {
+	public:
+	    static constexpr uint32_t page_shift = 12;
+	    static constexpr uint32_t page_size = (1 << page_shift);
+	    static constexpr uint32_t page_mask = (page_size - 1);
+	    static constexpr uint32_t num_pages = (0x100000 >> page_shift);
+
+	    static constexpr uint32_t dirty_shift = 8;
+	    static constexpr uint32_t dirty_block_size = (1 << dirty_shift);
+	    static constexpr uint32_t num_dirty_words = ((0x100000 >> dirty_shift) / 64);
+
+	    Bee8086MemoryMap();
+	    ~Bee8086MemoryMap();
+
+	    // Maps a region (on top of any regions that were added before it),
+	    // and returns false if it isn't page-aligned
+	    bool addregion(const Bee8086MemoryRegion &region);
+
+	    // Maps a list of regions in order
+	    bool addregions(const vector<Bee8086MemoryRegion> &region_list);
+
+	    // Unmaps every region
+	    void clear();
+
+	    // Fetches the region an address is mapped to (or NULL if it's unmapped)
+	    const Bee8086MemoryRegion *getregion(uint32_t addr);
+
+	    // Fetches a pointer to the host memory behind an address
+	    // (or NULL if the address isn't mapped to RAM or ROM)
+	    uint8_t *getpointer(uint32_t addr);
+
+	    uint8_t readByte(uint32_t addr)
+	    {
+		addr &= 0xFFFFF;
+		const Page &page = pages[addr >> page_shift];
+
+		if (page.read_ptr != NULL)
+		{
+		    return page.read_ptr[addr & page_mask];
+		}
+
+		return readslow(addr);
+	    }
+
+	    void writeByte(uint32_t addr, uint8_t data)
+	    {
+		addr &= 0xFFFFF;
+		const Page &page = pages[addr >> page_shift];
+
+		if (page.write_ptr != NULL)
+		{
+		    page.write_ptr[addr & page_mask] = data;
+		    markdirty(page.dirty_addr | (addr & page_mask));
+		    return;
+		}
+
+		writeslow(addr, data);
+	    }
+
+	    // Copies blocks of memory a page at a time
+	    // (RAM and ROM pages are copied directly, while MMIO pages go through their handlers)
+	    void readBlock(uint32_t addr, uint8_t *data, size_t size);
+	    void writeBlock(uint32_t addr, const uint8_t *data, size_t size);
+
+	    // Prints the memory map
+	    void printmap(ostream &stream);
+
+	    // Fetches the number of sparse RAM and copy-on-write pages that have been allocated
+	    size_t gettouchedpages();
+
+	    // Returns true if any part of a range has been written to since its dirty bits were last fetched with fetchdirty()
+	    bool isdirty(uint32_t addr, uint32_t size);
+
+	    // Same as isdirty(), but also clears the range's dirty bits
+	    bool fetchdirty(uint32_t addr, uint32_t size);
+
+	    // Fetches the addresses of every 4 KB page that has been written to since the last call
+	    vector<uint32_t> fetchdirtypages();
+
+	    // Clears all of the dirty bits
+	    void cleardirty();
+
+	private:
+	    struct Page
+	    {
+		uint8_t *read_ptr = NULL; // Start of the page in host memory (RAM and ROM)
+		uint8_t *write_ptr = NULL; // Start of the page in host memory (RAM only)
+		int region = -1; // Index of the region the page is mapped to
+		uint32_t offs = 0; // Offset of the page into its region
+		uint32_t dirty_addr = 0; // Address that writes to the page are tracked at (the first mirror of the page)
+	    };
+
+	    array<Page, num_pages> pages;
+	    vector<Bee8086MemoryRegion> regions;
+
+	    // Allocated sparse RAM and copy-on-write pages
+	    // (for each region, indexed by the page's offset into the region's backing memory)
+	    vector<vector<unique_ptr<uint8_t[]>>> private_pages;
+	    size_t num_touched_pages = 0;
+
+	    // One bit per 256-byte block
+	    array<atomic<uint64_t>, num_dirty_words> dirty_bits;
+
+	    // Bits that have been taken out of "dirty_bits" by one kind of fetch, but not yet seen by the other
+	    // (these are only touched when fetching, so writes never have to look at them)
+	    array<uint64_t, num_dirty_words> range_pending;
+	    array<uint64_t, num_dirty_words> page_pending;
+	    mutex pending_mutex;
+
+	    void markdirty(uint32_t addr)
+	    {
+		uint32_t block = (addr >> dirty_shift);
+		uint64_t mask = (1ULL << (block & 63));
+		atomic<uint64_t> &word = dirty_bits[block >> 6];
+
+		// Checking first avoids a locked read-modify-write for every write to a block that's already dirty
+		if ((word.load(memory_order_relaxed) & mask) == 0)
+		{
+		    word.fetch_or(mask, memory_order_release);
+		}
+	    }
+
+	    void markdirtyrange(uint32_t addr, size_t size);
+
+	    // Applies "func" to the index of each dirty word in a range, along with the mask of the range's bits in that word
+	    void forrange(uint32_t addr, uint32_t size, function<void(uint32_t, uint64_t)> func);
+
+	    uint8_t readslow(uint32_t addr);
+	    void writeslow(uint32_t addr, uint8_t data);
+
+	    // Allocates a private copy of the page behind an address (and any mirrors of it),
+	    // and returns false if the address isn't sparse RAM or copy-on-write
+	    bool commitpage(uint32_t addr);
+    };
+};
+
+#endif // BEE8086_MEMORYMAP_H
\ No newline at end of file
@@ -0,0 +1,537 @@
+/*
+    This file is part of the Bee8086 engine.
+    Copyright (C) 2022 BueniaDev.
+
+    Bee8086 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bee8086 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bee8086.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "recorder.h"
+#include <algorithm>
+using namespace bee8086;
+using namespace std;
+
+Bee8086Recorder::Bee8086Recorder(Bee8086 &cpu, Bee8086Interface &cb) : core(cpu), inter(cb)
+{
+
+}
+
+Bee8086Recorder::~Bee8086Recorder()
+{
+
+}
+
+void Bee8086Recorder::setmode(Mode mode)
+{
+    current_mode = mode;
+
+    if (current_mode == Record)
+    {
+	position = events.size();
+    }
+}
+
+Bee8086Recorder::Mode Bee8086Recorder::getmode()
+{
+    return current_mode;
+}
+
+const deque<Bee8086InputEvent> &Bee8086Recorder::getlog()
+{
+    return events;
+}
+
+size_t Bee8086Recorder::getposition()
+{
+    return position;
+}
+
+void Bee8086Recorder::setposition(size_t pos)
+{
+    position = min(pos, events.size());
+    is_desynced = false;
+}
+
+void Bee8086Recorder::truncate(size_t pos)
+{
+    if (pos < events.size())
+    {
+	events.erase((events.begin() + pos), events.end());
+    }
+
+    position = min(position, events.size());
+}
+
+void Bee8086Recorder::discard(size_t count)
+{
+    count = min(count, events.size());
+    events.erase(events.begin(), (events.begin() + count));
+    position = (position > count) ? (position - count) : 0;
+}
+
+void Bee8086Recorder::clear()
+{
+    events.clear();
+    position = 0;
+    is_desynced = false;
+    end_cycles = 0;
+    end_instrs = 0;
+}
+
+bool Bee8086Recorder::isdesynced()
+{
+    return is_desynced;
+}
+
+bool Bee8086Recorder::isfinished()
+{
+    return (position >= events.size());
+}
+
+uint64_t Bee8086Recorder::getendcycles()
+{
+    return end_cycles;
+}
+
+uint64_t Bee8086Recorder::getendinstrs()
+{
+    return end_instrs;
+}
+
+const Bee8086InputEvent *Bee8086Recorder::nextevent(Bee8086InputEvent::Type type)
+{
+    if ((position >= events.size()) || (events[position].type != type))
+    {
+	if (!is_desynced)
+	{
+	    cout << "Replay desynced at instruction " << dec << core.getinstrcount() << endl;
+	}
+
+	is_desynced = true;
+	return NULL;
+    }
+
+    // The log still gets fed back if the cycle counts don't match,
+    // but the run can no longer be trusted to be reproducible
+    if ((events[position].cycle != core.getcycles()) && !is_desynced)
+    {
+	cout << "Replay desynced at cycle " << dec << core.getcycles() << " (expected cycle " << events[position].cycle << ")" << endl;
+	is_desynced = true;
+    }
+
+    return &events[position++];
+}
+
+bool Bee8086Recorder::issamestate(const Bee8086State &lhs, const Bee8086State &rhs)
+{
+    return ((lhs.ax == rhs.ax) && (lhs.bx == rhs.bx) && (lhs.cx == rhs.cx) && (lhs.dx == rhs.dx) &&
+	(lhs.ip == rhs.ip) && (lhs.sp == rhs.sp) && (lhs.bp == rhs.bp) && (lhs.si == rhs.si) && (lhs.di == rhs.di) &&
+	(lhs.cs == rhs.cs) && (lhs.ds == rhs.ds) && (lhs.ss == rhs.ss) && (lhs.es == rhs.es) && (lhs.flags == rhs.flags) &&
+	(lhs.mem_segment == rhs.mem_segment) && (lhs.is_segment_override == rhs.is_segment_override) && (lhs.is_rep == rhs.is_rep));
+}
+
+void Bee8086Recorder::capturewrite(uint32_t addr, const uint8_t *data, size_t size)
+{
+    // Merge writes to consecutive addresses (i.e. a sector being copied into memory)
+    if (!captured_writes.empty())
+    {
+	Bee8086MemWrite &last = captured_writes.back();
+
+	if ((last.addr + last.data.size()) == addr)
+	{
+	    last.data.insert(last.data.end(), data, (data + size));
+	    return;
+	}
+    }
+
+    Bee8086MemWrite write;
+    write.addr = addr;
+    write.data.assign(data, (data + size));
+    captured_writes.push_back(write);
+}
+
+uint8_t Bee8086Recorder::readByte(uint32_t addr)
+{
+    return inter.readByte(addr);
+}
+
+void Bee8086Recorder::writeByte(uint32_t addr, uint8_t val)
+{
+    if (is_capturing)
+    {
+	capturewrite(addr, &val, 1);
+    }
+
+    inter.writeByte(addr, val);
+}
+
+void Bee8086Recorder::readBlock(uint32_t addr, uint8_t *data, size_t size)
+{
+    inter.readBlock(addr, data, size);
+}
+
+void Bee8086Recorder::writeBlock(uint32_t addr, const uint8_t *data, size_t size)
+{
+    if (is_capturing)
+    {
+	capturewrite(addr, data, size);
+    }
+
+    inter.writeBlock(addr, data, size);
+}
+
+uint8_t Bee8086Recorder::portIn(uint16_t port)
+{
+    if (current_mode == Replay)
+    {
+	const Bee8086InputEvent *event = nextevent(Bee8086InputEvent::PortIn);
+
+	if ((event != NULL) && (event->port == port))
+	{
+	    return event->value;
+	}
+
+	is_desynced = true;
+    }
+
+    uint8_t value = inter.portIn(port);
+
+    if (current_mode == Record)
+    {
+	Bee8086InputEvent event;
+	event.type = Bee8086InputEvent::PortIn;
+	event.cycle = core.getcycles();
+	event.instr = core.getinstrcount();
+	event.port = port;
+	event.value = value;
+	events.push_back(event);
+	position = events.size();
+    }
+
+    return value;
+}
+
+void Bee8086Recorder::portOut(uint16_t port, uint8_t val)
+{
+    inter.portOut(port, val);
+}
+
+bool Bee8086Recorder::isInterruptOverride(uint8_t int_num)
+{
+    return inter.isInterruptOverride(int_num);
+}
+
+void Bee8086Recorder::interruptOverride(Bee8086 &state, uint8_t int_num)
+{
+    if (current_mode == Replay)
+    {
+	// Nothing was logged for an override that only repeated its instruction,
+	// so one is repeated until the log reaches the instruction it finished at
+	if ((position >= events.size()) || (events[position].instr > core.getinstrcount()))
+	{
+	    state.repeatinstruction();
+	    return;
+	}
+
+	const Bee8086InputEvent *event = nextevent(Bee8086InputEvent::Interrupt);
+
+	if ((event != NULL) && (event->int_num == int_num))
+	{
+	    for (auto &write : event->writes)
+	    {
+		inter.writeBlock(write.addr, write.data.data(), write.data.size());
+	    }
+
+	    state.setstate(event->state);
+	    return;
+	}
+
+	is_desynced = true;
+    }
+
+    if (current_mode != Record)
+    {
+	inter.interruptOverride(state, int_num);
+	return;
+    }
+
+    Bee8086InputEvent event;
+    event.type = Bee8086InputEvent::Interrupt;
+    event.cycle = core.getcycles();
+    event.instr = core.getinstrcount();
+    event.int_num = int_num;
+
+    Bee8086State before = state.getstate();
+    captured_writes.clear();
+    is_capturing = true;
+    inter.interruptOverride(state, int_num);
+    is_capturing = false;
+
+    event.state = state.getstate();
+
+    // An override that's waiting on a device (and so only repeats its instruction) changes nothing,
+    // so it isn't logged (otherwise every wait would fill up the log with thousands of identical events)
+    if (state.isrepeating() && captured_writes.empty() && issamestate(before, event.state))
+    {
+	return;
+    }
+    event.writes.swap(captured_writes);
+    events.push_back(event);
+    position = events.size();
+}
+
+uint32_t Bee8086Recorder::convertSeg(uint16_t seg, uint16_t offs)
+{
+    return inter.convertSeg(seg, offs);
+}
+
+bool Bee8086Recorder::isInterruptPending()
+{
+    // During replay, hardware interrupts are taken at exactly the same instruction as they were when recording
+    if (current_mode == Replay)
+    {
+	return ((position < events.size()) && (events[position].type == Bee8086InputEvent::InterruptAck) && (events[position].instr == core.getinstrcount()));
+    }
+
+    return inter.isInterruptPending();
+}
+
+uint8_t Bee8086Recorder::acknowledgeInterrupt()
+{
+    if (current_mode == Replay)
+    {
+	const Bee8086InputEvent *event = nextevent(Bee8086InputEvent::InterruptAck);
+
+	if (event != NULL)
+	{
+	    return event->value;
+	}
+
+	is_desynced = true;
+    }
+
+    uint8_t int_num = inter.acknowledgeInterrupt();
+
+    if (current_mode == Record)
+    {
+	Bee8086InputEvent event;
+	event.type = Bee8086InputEvent::InterruptAck;
+	event.cycle = core.getcycles();
+	event.instr = core.getinstrcount();
+	event.value = int_num;
+	events.push_back(event);
+	position = events.size();
+    }
+
+    return int_num;
+}
+
+// Log file format (all values are little-endian):
+// "BEE8086R" signature, 32-bit version, 64-bit end cycle count, 64-bit end instruction count, 64-bit number of events,
+// and then for each event: 8-bit type, 64-bit cycle count, 64-bit instruction count,
+// 16-bit port, 8-bit value (or the interrupt number of a hardware interrupt) and 8-bit interrupt number, followed (for interrupt events)
+// by the CPU state, a 32-bit number of memory writes, and each write's 32-bit address, 32-bit size and data
+static const char log_signature[8] = {'B', 'E', 'E', '8', '0', '8', '6', 'R'};
+static const uint32_t log_version = 1;
+
+void Bee8086Recorder::writevalue(ofstream &file, uint64_t val, int num_bytes)
+{
+    for (int index = 0; index < num_bytes; index++)
+    {
+	file.put(char((val >> (index * 8)) & 0xFF));
+    }
+}
+
+uint64_t Bee8086Recorder::readvalue(ifstream &file, int num_bytes)
+{
+    uint64_t val = 0;
+
+    for (int index = 0; index < num_bytes; index++)
+    {
+	val |= (uint64_t(uint8_t(file.get())) << (index * 8));
+    }
+
+    return val;
+}
+
+void Bee8086Recorder::writestate(ofstream &file, const Bee8086State &state)
+{
+    uint16_t regs[14] = {state.ax, state.bx, state.cx, state.dx, state.ip, state.sp, state.bp, state.si, state.di, state.cs, state.ds, state.ss, state.es, state.flags};
+
+    for (int index = 0; index < 14; index++)
+    {
+	writevalue(file, regs[index], 2);
+    }
+
+    writevalue(file, state.cycles, 8);
+    writevalue(file, state.instrs, 8);
+    writevalue(file, uint32_t(state.mem_segment), 4);
+    writevalue(file, state.is_segment_override, 1);
+    writevalue(file, state.is_rep, 1);
+}
+
+Bee8086State Bee8086Recorder::readstate(ifstream &file)
+{
+    Bee8086State state;
+    uint16_t regs[14];
+
+    for (int index = 0; index < 14; index++)
+    {
+	regs[index] = readvalue(file, 2);
+    }
+
+    state.ax = regs[0];
+    state.bx = regs[1];
+    state.cx = regs[2];
+    state.dx = regs[3];
+    state.ip = regs[4];
+    state.sp = regs[5];
+    state.bp = regs[6];
+    state.si = regs[7];
+    state.di = regs[8];
+    state.cs = regs[9];
+    state.ds = regs[10];
+    state.ss = regs[11];
+    state.es = regs[12];
+    state.flags = regs[13];
+    state.cycles = readvalue(file, 8);
+    state.instrs = readvalue(file, 8);
+    state.mem_segment = int(readvalue(file, 4));
+    state.is_segment_override = (readvalue(file, 1) != 0);
+    state.is_rep = (readvalue(file, 1) != 0);
+    return state;
+}
+
+bool Bee8086Recorder::savelog(string filename)
+{
+    ofstream file(filename.c_str(), ios::out | ios::binary);
+
+    if (!file.is_open())
+    {
+	cout << "Error: could not open " << filename << endl;
+	return false;
+    }
+
+    file.write(log_signature, sizeof(log_signature));
+    writevalue(file, log_version, 4);
+    writevalue(file, core.getcycles(), 8);
+    writevalue(file, core.getinstrcount(), 8);
+    writevalue(file, events.size(), 8);
+
+    for (auto &event : events)
+    {
+	writevalue(file, event.type, 1);
+	writevalue(file, event.cycle, 8);
+	writevalue(file, event.instr, 8);
+	writevalue(file, event.port, 2);
+	writevalue(file, event.value, 1);
+	writevalue(file, event.int_num, 1);
+
+	if (event.type != Bee8086InputEvent::Interrupt)
+	{
+	    continue;
+	}
+
+	writestate(file, event.state);
+	writevalue(file, event.writes.size(), 4);
+
+	for (auto &write : event.writes)
+	{
+	    writevalue(file, write.addr, 4);
+	    writevalue(file, write.data.size(), 4);
+	    file.write((const char*)write.data.data(), write.data.size());
+	}
+    }
+
+    if (!file.good())
+    {
+	cout << "Error: could not write " << filename << endl;
+	return false;
+    }
+
+    file.close();
+    return true;
+}
+
+bool Bee8086Recorder::loadlog(string filename)
+{
+    ifstream file(filename.c_str(), ios::in | ios::binary);
+
+    if (!file.is_open())
+    {
+	cout << "Error: could not open " << filename << endl;
+	return false;
+    }
+
+    char signature[8];
+    file.read(signature, sizeof(signature));
+
+    if (!file.good() || !equal(signature, (signature + 8), log_signature) || (readvalue(file, 4) != log_version))
+    {
+	cout << "Error: " << filename << " is not a Bee8086 input log" << endl;
+	return false;
+    }
+
+    clear();
+
+    end_cycles = readvalue(file, 8);
+    end_instrs = readvalue(file, 8);
+    uint64_t num_events = readvalue(file, 8);
+
+    for (uint64_t index = 0; (index < num_events) && file.good(); index++)
+    {
+	Bee8086InputEvent event;
+	event.type = Bee8086InputEvent::Type(readvalue(file, 1));
+	event.cycle = readvalue(file, 8);
+	event.instr = readvalue(file, 8);
+	event.port = readvalue(file, 2);
+	event.value = readvalue(file, 1);
+	event.int_num = readvalue(file, 1);
+
+	if (event.type == Bee8086InputEvent::Interrupt)
+	{
+	    event.state = readstate(file);
+	    uint32_t num_writes = readvalue(file, 4);
+
+	    for (uint32_t write_index = 0; (write_index < num_writes) && file.good(); write_index++)
+	    {
+		Bee8086MemWrite write;
+		write.addr = readvalue(file, 4);
+		uint32_t size = readvalue(file, 4);
+
+		// No single write can be bigger than the 8086's address space
+		if (size > 0x100000)
+		{
+		    file.setstate(ios::failbit);
+		    break;
+		}
+
+		write.data.resize(size);
+		file.read((char*)write.data.data(), write.data.size());
+		event.writes.push_back(write);
+	    }
+	}
+
+	events.push_back(event);
+    }
+
+    if (!file.good())
+    {
+	cout << "Error: " << filename << " is truncated" << endl;
+	clear();
+	return false;
+    }
+
+    file.close();
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,156 @@
+/*
+    This file is part of the Bee8086 engine.
+    Copyright (C) 2022 BueniaDev.
+
+    Bee8086 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bee8086 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bee8086.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BEE8086_RECORDER_H
+#define BEE8086_RECORDER_H
+
+#include <deque>
+#include <fstream>
+#include "bee8086.h"
+using namespace std;
+
+namespace bee8086
+{
+    // Memory written by an interrupt override function
+    struct Bee8086MemWrite
+    {
+	uint32_t addr = 0;
+	vector<uint8_t> data;
+    };
+
+    // Non-deterministic input to the CPU
+    struct Bee8086InputEvent
+    {
+	enum Type : int
+	{
+	    PortIn = 0, // Value read from an I/O port
+	    Interrupt = 1, // Side effects of an interrupt override function
+	    InterruptAck = 2, // Hardware interrupt taken by the CPU (with its interrupt number in "value")
+	};
+
+	Type type = PortIn;
+	uint64_t cycle = 0; // Cycle count at which the event happened
+	uint64_t instr = 0; // Instruction count at which the event happened
+	uint16_t port = 0;
+	uint8_t value = 0;
+	uint8_t int_num = 0;
+	Bee8086State state; // CPU state after the interrupt override function returned
+	vector<Bee8086MemWrite> writes;
+    };
+
+    // Interface layer that sits between the CPU and the host's interface,
+    // and either logs every non-deterministic input to the CPU (port reads, hardware interrupts and
+    // the side effects of interrupt override functions), or feeds a log back to the CPU
+    // instead of calling into the host's devices
+    //
+    // During replay, port writes are still passed through to the host, and each event's
+    // cycle count is checked against the CPU's to catch any divergence as early as possible
+    class Bee8086Recorder : public Bee8086Interface
+    {
+	public:
+	    enum Mode : int
+	    {
+		Passthrough = 0,
+		Record = 1,
+		Replay = 2,
+	    };
+
+	    Bee8086Recorder(Bee8086 &cpu, Bee8086Interface &cb);
+	    ~Bee8086Recorder();
+
+	    void setmode(Mode mode);
+	    Mode getmode();
+
+	    // Fetches the log
+	    const deque<Bee8086InputEvent> &getlog();
+
+	    // Fetches/sets the index of the next event to be replayed
+	    // (while recording, this is always the end of the log)
+	    size_t getposition();
+	    void setposition(size_t pos);
+
+	    // Drops every event from "pos" onwards
+	    void truncate(size_t pos);
+
+	    // Drops the first "count" events
+	    void discard(size_t count);
+
+	    // Clears the log
+	    void clear();
+
+	    // Returns true if the replayed events stopped matching what the CPU asked for
+	    bool isdesynced();
+
+	    // Returns true once every event in the log has been replayed
+	    bool isfinished();
+
+	    // Saves the log (along with the CPU's current cycle and instruction counts,
+	    // which mark the end of the recording) to a file
+	    bool savelog(string filename);
+
+	    // Loads a log from a file, and rewinds to the start of it
+	    bool loadlog(string filename);
+
+	    // Fetches the cycle and instruction counts at which the loaded log's recording ended
+	    uint64_t getendcycles();
+	    uint64_t getendinstrs();
+
+	    uint8_t readByte(uint32_t addr);
+	    void writeByte(uint32_t addr, uint8_t val);
+	    uint8_t portIn(uint16_t port);
+	    void portOut(uint16_t port, uint8_t val);
+	    bool isInterruptOverride(uint8_t int_num);
+	    void interruptOverride(Bee8086 &state, uint8_t int_num);
+	    uint32_t convertSeg(uint16_t seg, uint16_t offs);
+	    void readBlock(uint32_t addr, uint8_t *data, size_t size);
+	    void writeBlock(uint32_t addr, const uint8_t *data, size_t size);
+	    bool isInterruptPending();
+	    uint8_t acknowledgeInterrupt();
+
+	private:
+	    Bee8086 &core;
+	    Bee8086Interface &inter;
+
+	    Mode current_mode = Passthrough;
+	    deque<Bee8086InputEvent> events;
+	    size_t position = 0;
+	    bool is_desynced = false;
+
+	    uint64_t end_cycles = 0;
+	    uint64_t end_instrs = 0;
+
+	    // Memory writes made by the interrupt override function currently running (if any)
+	    bool is_capturing = false;
+	    vector<Bee8086MemWrite> captured_writes;
+
+	    void capturewrite(uint32_t addr, const uint8_t *data, size_t size);
+
+	    // Returns true if both states have the same registers (ignoring the cycle and instruction counts)
+	    bool issamestate(const Bee8086State &lhs, const Bee8086State &rhs);
+
+	    void writevalue(ofstream &file, uint64_t val, int num_bytes);
+	    uint64_t readvalue(ifstream &file, int num_bytes);
+	    void writestate(ofstream &file, const Bee8086State &state);
+	    Bee8086State readstate(ifstream &file);
+
+	    // Fetches the next event to be replayed, or NULL if it doesn't match the given type
+	    const Bee8086InputEvent *nextevent(Bee8086InputEvent::Type type);
+    };
+};
+
+#endif // BEE8086_RECORDER_H
\ No newline at end of file
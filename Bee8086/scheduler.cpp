@@ -0,0 +1,115 @@
+/*
+    This file is part of the Bee8086 engine.
+    Copyright (C) 2022 BueniaDev.
+
+    Bee8086 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bee8086 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bee8086.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "scheduler.h"
+#include <algorithm>
+using namespace bee8086;
+using namespace std;
+
+Bee8086Scheduler::Bee8086Scheduler(Bee8086 &cpu) : core(cpu)
+{
+
+}
+
+Bee8086Scheduler::~Bee8086Scheduler()
+{
+
+}
+
+int Bee8086Scheduler::schedule(uint64_t delay, Callback func)
+{
+    return scheduleat((core.getcycles() + delay), func);
+}
+
+int Bee8086Scheduler::scheduleat(uint64_t cycle, Callback func)
+{
+    int id = next_id++;
+    events[make_pair(cycle, id)] = func;
+    event_cycles[id] = cycle;
+    return id;
+}
+
+void Bee8086Scheduler::cancel(int id)
+{
+    auto it = event_cycles.find(id);
+
+    if (it == event_cycles.end())
+    {
+	return;
+    }
+
+    events.erase(make_pair(it->second, id));
+    event_cycles.erase(it);
+}
+
+void Bee8086Scheduler::clear()
+{
+    events.clear();
+    event_cycles.clear();
+}
+
+uint64_t Bee8086Scheduler::getnextevent()
+{
+    if (events.empty())
+    {
+	return UINT64_MAX;
+    }
+
+    return events.begin()->first.first;
+}
+
+uint64_t Bee8086Scheduler::getcycles()
+{
+    return core.getcycles();
+}
+
+void Bee8086Scheduler::runevents()
+{
+    // Events can schedule (or cancel) other events, so take each one off the queue before running it
+    while (!events.empty() && (events.begin()->first.first <= core.getcycles()))
+    {
+	auto it = events.begin();
+	Callback func = it->second;
+	event_cycles.erase(it->first.second);
+	events.erase(it);
+	func();
+    }
+}
+
+int Bee8086Scheduler::runcycles(int num_cycles)
+{
+    int cycles = 0;
+
+    while (cycles < num_cycles)
+    {
+	uint64_t next_event = getnextevent();
+	uint64_t current = core.getcycles();
+	uint64_t until_event = (next_event > current) ? (next_event - current) : 1;
+	int budget = int(min<uint64_t>((num_cycles - cycles), until_event));
+
+	cycles += core.runcycles(budget);
+	runevents();
+
+	if (core.hitbreakpoint())
+	{
+	    break;
+	}
+    }
+
+    return cycles;
+}
\ No newline at end of file
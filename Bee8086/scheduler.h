@@ -0,0 +1,73 @@
+/*
+    This file is part of the Bee8086 engine.
+    Copyright (C) 2022 BueniaDev.
+
+    Bee8086 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bee8086 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bee8086.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BEE8086_SCHEDULER_H
+#define BEE8086_SCHEDULER_H
+
+#include <map>
+#include <functional>
+#include "bee8086.h"
+using namespace std;
+
+namespace bee8086
+{
+    // Schedules device events (i.e. DMA transfers completing) at specific CPU cycles
+    class Bee8086Scheduler
+    {
+	public:
+	    using Callback = function<void()>;
+
+	    Bee8086Scheduler(Bee8086 &cpu);
+	    ~Bee8086Scheduler();
+
+	    // Schedules "func" to run "delay" cycles from now, and returns an ID that can be used to cancel it
+	    int schedule(uint64_t delay, Callback func);
+
+	    // Schedules "func" to run at an absolute cycle count
+	    int scheduleat(uint64_t cycle, Callback func);
+
+	    // Cancels a pending event
+	    void cancel(int id);
+
+	    // Cancels every pending event
+	    void clear();
+
+	    // Fetches the cycle count of the next pending event (or UINT64_MAX if there isn't one)
+	    uint64_t getnextevent();
+
+	    // Fetches the CPU's current cycle count
+	    uint64_t getcycles();
+
+	    // Runs every event that's due by the CPU's current cycle count (in order)
+	    void runevents();
+
+	    // Runs the CPU for up to "num_cycles" cycles (stopping at breakpoints),
+	    // running each event as soon as the CPU reaches its cycle, and returns the number of cycles executed
+	    int runcycles(int num_cycles);
+
+	private:
+	    Bee8086 &core;
+
+	    // Events are ordered by cycle, and then by the order they were scheduled in
+	    map<pair<uint64_t, int>, Callback> events;
+	    map<int, uint64_t> event_cycles;
+	    int next_id = 0;
+    };
+};
+
+#endif // BEE8086_SCHEDULER_H
\ No newline at end of file
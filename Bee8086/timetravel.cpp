@@ -0,0 +1,580 @@
+/*
+    This file is part of the Bee8086 engine.
+    Copyright (C) 2022 BueniaDev.
+
+    Bee8086 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bee8086 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bee8086.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "timetravel.h"
+#include <cstring>
+#include <algorithm>
+using namespace bee8086;
+using namespace std;
+
+Bee8086TimeTravel::Bee8086TimeTravel(Bee8086 &cpu, Bee8086Interface &cb) : core(cpu), inter(cb), recorder(cpu, cb)
+{
+    core.setinterface(&recorder);
+    recorder.setmode(Bee8086Recorder::Record);
+}
+
+Bee8086TimeTravel::~Bee8086TimeTravel()
+{
+    core.setinterface(&inter);
+}
+
+void Bee8086TimeTravel::setscheduler(Bee8086Scheduler *sched)
+{
+    scheduler = sched;
+}
+
+void Bee8086TimeTravel::setmemorymap(Bee8086MemoryMap *map)
+{
+    memory_map = map;
+}
+
+void Bee8086TimeTravel::setinterval(uint64_t num_cycles)
+{
+    interval = max<uint64_t>(num_cycles, 1);
+}
+
+void Bee8086TimeTravel::setmaxcheckpoints(size_t num_checkpoints)
+{
+    max_checkpoints = max<size_t>(num_checkpoints, 1);
+
+    while (checkpoints.size() > max_checkpoints)
+    {
+	dropcheckpoint();
+    }
+}
+
+Bee8086Recorder &Bee8086TimeTravel::getrecorder()
+{
+    return recorder;
+}
+
+uint64_t Bee8086TimeTravel::getstart()
+{
+    start();
+    return checkpoints.front().state.instrs;
+}
+
+uint64_t Bee8086TimeTravel::getend()
+{
+    return max(end_instr, core.getinstrcount());
+}
+
+size_t Bee8086TimeTravel::getmemoryusage()
+{
+    size_t usage = (first_memory.size() + last_memory.size());
+
+    for (auto &checkpoint : checkpoints)
+    {
+	usage += sizeof(Checkpoint);
+
+	for (auto &delta : checkpoint.deltas)
+	{
+	    usage += (sizeof(PageDelta) + delta.data.size());
+	}
+    }
+
+    for (auto &event : recorder.getlog())
+    {
+	usage += sizeof(Bee8086InputEvent);
+
+	for (auto &write : event.writes)
+	{
+	    usage += (sizeof(Bee8086MemWrite) + write.data.size());
+	}
+    }
+
+    return usage;
+}
+
+// Takes the first checkpoint (if it hasn't been taken yet)
+void Bee8086TimeTravel::start()
+{
+    if (!checkpoints.empty())
+    {
+	return;
+    }
+
+    first_memory.resize(memory_size);
+    inter.readBlock(0, first_memory.data(), memory_size);
+    last_memory = first_memory;
+
+    // Only pages written from here on can differ from the first checkpoint
+    if (memory_map != NULL)
+    {
+	memory_map->fetchdirtypages();
+    }
+
+    Checkpoint checkpoint;
+    checkpoint.state = core.getstate();
+    checkpoint.log_pos = recorder.getposition();
+    checkpoints.push_back(checkpoint);
+
+    end_instr = core.getinstrcount();
+    next_checkpoint = (core.getcycles() + interval);
+}
+
+void Bee8086TimeTravel::takecheckpoint()
+{
+    Checkpoint checkpoint;
+    checkpoint.state = core.getstate();
+    checkpoint.log_pos = recorder.getposition();
+
+    vector<uint8_t> page(page_size);
+
+    for (auto addr : getchangedpages())
+    {
+	inter.readBlock(addr, page.data(), page_size);
+	uint8_t *prev = &last_memory[addr];
+
+	if (memcmp(prev, page.data(), page_size) == 0)
+	{
+	    continue;
+	}
+
+	PageDelta delta;
+	delta.page = addr;
+	encodedelta(prev, page.data(), delta.data);
+	checkpoint.deltas.push_back(delta);
+	memcpy(prev, page.data(), page_size);
+    }
+
+    checkpoints.push_back(checkpoint);
+    next_checkpoint = (core.getcycles() + interval);
+
+    while (checkpoints.size() > max_checkpoints)
+    {
+	dropcheckpoint();
+    }
+}
+
+// Fetches the pages that might have changed since the newest checkpoint
+// (which is every page, unless the memory map's dirty tracking can narrow it down)
+vector<uint32_t> Bee8086TimeTravel::getchangedpages()
+{
+    vector<uint32_t> pages;
+    vector<bool> is_changed((memory_size / page_size), (memory_map == NULL));
+
+    if (memory_map != NULL)
+    {
+	for (auto addr : memory_map->fetchdirtypages())
+	{
+	    is_changed[addr / page_size] = true;
+
+	    // Writes are tracked at the first mirror of a page, so every other mirror of it has changed as well
+	    const Bee8086MemoryRegion *region = memory_map->getregion(addr);
+
+	    if ((region != NULL) && (region->mirror != 0))
+	    {
+		for (uint32_t mirror_addr = addr; mirror_addr < (region->addr + region->size); mirror_addr += region->mirror)
+		{
+		    is_changed[mirror_addr / page_size] = true;
+		}
+	    }
+	}
+
+	// MMIO writes aren't tracked, so those pages are always compared
+	for (uint32_t addr = 0; addr < memory_size; addr += page_size)
+	{
+	    const Bee8086MemoryRegion *region = memory_map->getregion(addr);
+
+	    if ((region != NULL) && (region->type == Bee8086MemoryRegion::MMIO))
+	    {
+		is_changed[addr / page_size] = true;
+	    }
+	}
+    }
+
+    for (uint32_t addr = 0; addr < memory_size; addr += page_size)
+    {
+	if (is_changed[addr / page_size])
+	{
+	    pages.push_back(addr);
+	}
+    }
+
+    return pages;
+}
+
+// Drops the oldest checkpoint, making the one after it the start of the history
+void Bee8086TimeTravel::dropcheckpoint()
+{
+    if (checkpoints.size() < 2)
+    {
+	return;
+    }
+
+    checkpoints.pop_front();
+
+    Checkpoint &first = checkpoints.front();
+
+    for (auto &delta : first.deltas)
+    {
+	applydelta(delta.data, &first_memory[delta.page]);
+    }
+
+    first.deltas.clear();
+
+    size_t num_events = first.log_pos;
+    recorder.discard(num_events);
+
+    for (auto &checkpoint : checkpoints)
+    {
+	checkpoint.log_pos -= num_events;
+    }
+}
+
+// Finds the latest checkpoint at or before "instr"
+size_t Bee8086TimeTravel::findcheckpoint(uint64_t instr)
+{
+    size_t index = 0;
+
+    for (size_t pos = 0; pos < checkpoints.size(); pos++)
+    {
+	if (checkpoints[pos].state.instrs > instr)
+	{
+	    break;
+	}
+
+	index = pos;
+    }
+
+    return index;
+}
+
+void Bee8086TimeTravel::restorecheckpoint(size_t index)
+{
+    // XOR deltas can be applied in either direction, so rebuild the checkpoint's memory
+    // from whichever end of the history is closer
+    vector<uint8_t> memory;
+    size_t last_index = (checkpoints.size() - 1);
+
+    if (index <= (last_index - index))
+    {
+	memory = first_memory;
+
+	for (size_t pos = 1; pos <= index; pos++)
+	{
+	    for (auto &delta : checkpoints[pos].deltas)
+	    {
+		applydelta(delta.data, &memory[delta.page]);
+	    }
+	}
+    }
+    else
+    {
+	memory = last_memory;
+
+	for (size_t pos = last_index; pos > index; pos--)
+	{
+	    for (auto &delta : checkpoints[pos].deltas)
+	    {
+		applydelta(delta.data, &memory[delta.page]);
+	    }
+	}
+    }
+
+    // Only write back the pages that have changed since then
+    vector<uint8_t> page(page_size);
+
+    for (uint32_t addr = 0; addr < memory_size; addr += page_size)
+    {
+	inter.readBlock(addr, page.data(), page_size);
+
+	if (memcmp(&memory[addr], page.data(), page_size) != 0)
+	{
+	    inter.writeBlock(addr, &memory[addr], page_size);
+	}
+    }
+
+    core.setstate(checkpoints[index].state);
+    recorder.setposition(checkpoints[index].log_pos);
+    updatemode();
+}
+
+// Replays the log up to "instr"
+void Bee8086TimeTravel::replayto(uint64_t instr)
+{
+    while (core.getinstrcount() < instr)
+    {
+	updatemode();
+	core.runinstruction();
+    }
+
+    updatemode();
+}
+
+void Bee8086TimeTravel::updatemode()
+{
+    if (core.getinstrcount() < end_instr)
+    {
+	recorder.setmode(Bee8086Recorder::Replay);
+    }
+    else
+    {
+	recorder.setmode(Bee8086Recorder::Record);
+    }
+}
+
+int Bee8086TimeTravel::step()
+{
+    start();
+    updatemode();
+
+    int cycles = core.runinstruction();
+    end_instr = max(end_instr, core.getinstrcount());
+
+    // Devices only see the instructions run past the end of the history
+    // (anything before that is replayed from the log)
+    if ((scheduler != NULL) && (recorder.getmode() == Bee8086Recorder::Record))
+    {
+	scheduler->runevents();
+    }
+
+    if ((recorder.getmode() == Bee8086Recorder::Record) && (core.getcycles() >= next_checkpoint))
+    {
+	takecheckpoint();
+    }
+
+    return cycles;
+}
+
+int Bee8086TimeTravel::runcycles(int num_cycles)
+{
+    start();
+    is_breakpoint_hit = false;
+
+    int cycles = 0;
+
+    // Replay any part of the history that we've stepped back over
+    // an instruction at a time, since the mode has to switch at exactly the right point
+    while ((cycles < num_cycles) && (core.getinstrcount() < end_instr))
+    {
+	if (core.stopatbreakpoint())
+	{
+	    is_breakpoint_hit = true;
+	    return cycles;
+	}
+
+	updatemode();
+	cycles += core.runinstruction();
+    }
+
+    updatemode();
+
+    while (cycles < num_cycles)
+    {
+	uint64_t until_checkpoint = (next_checkpoint > core.getcycles()) ? (next_checkpoint - core.getcycles()) : 0;
+	int budget = int(min<uint64_t>((num_cycles - cycles), max<uint64_t>(until_checkpoint, 1)));
+	cycles += (scheduler != NULL) ? scheduler->runcycles(budget) : core.runcycles(budget);
+
+	end_instr = max(end_instr, core.getinstrcount());
+
+	if (core.getcycles() >= next_checkpoint)
+	{
+	    takecheckpoint();
+	}
+
+	if (core.hitbreakpoint())
+	{
+	    is_breakpoint_hit = true;
+	    break;
+	}
+    }
+
+    return cycles;
+}
+
+bool Bee8086TimeTravel::hitbreakpoint()
+{
+    return is_breakpoint_hit;
+}
+
+bool Bee8086TimeTravel::seek(uint64_t instr)
+{
+    start();
+    end_instr = max(end_instr, core.getinstrcount());
+
+    if ((instr < getstart()) || (instr > end_instr))
+    {
+	return false;
+    }
+
+    size_t index = findcheckpoint(instr);
+
+    // Replay forwards from where we are if there's no closer checkpoint
+    uint64_t current = core.getinstrcount();
+
+    if ((current > instr) || (checkpoints[index].state.instrs > current))
+    {
+	restorecheckpoint(index);
+    }
+
+    replayto(instr);
+    return true;
+}
+
+bool Bee8086TimeTravel::reversestep()
+{
+    start();
+
+    uint64_t current = core.getinstrcount();
+
+    if (current <= getstart())
+    {
+	return false;
+    }
+
+    return seek(current - 1);
+}
+
+bool Bee8086TimeTravel::reversecontinue()
+{
+    start();
+    end_instr = max(end_instr, core.getinstrcount());
+
+    uint64_t current = core.getinstrcount();
+
+    if (current <= getstart())
+    {
+	return false;
+    }
+
+    size_t index = findcheckpoint(current - 1);
+
+    // Search each stretch of the history between checkpoints (latest first)
+    // for the last instruction that starts at a breakpoint
+    while (true)
+    {
+	uint64_t end = (index == (checkpoints.size() - 1)) ? current : min(current, checkpoints[index + 1].state.instrs);
+	restorecheckpoint(index);
+
+	bool is_found = false;
+	uint64_t found_instr = 0;
+
+	while (core.getinstrcount() < end)
+	{
+	    if (core.atbreakpoint())
+	    {
+		is_found = true;
+		found_instr = core.getinstrcount();
+	    }
+
+	    updatemode();
+	    core.runinstruction();
+	}
+
+	if (is_found)
+	{
+	    seek(found_instr);
+	    return true;
+	}
+
+	if (index == 0)
+	{
+	    restorecheckpoint(0);
+	    return false;
+	}
+
+	index -= 1;
+    }
+}
+
+// Encodes "prev ^ cur" as a series of (zero run length, literal length, literal bytes) records,
+// with both lengths as 16-bit little-endian values
+void Bee8086TimeTravel::encodedelta(const uint8_t *prev, const uint8_t *cur, vector<uint8_t> &out)
+{
+    out.clear();
+
+    uint32_t pos = 0;
+
+    while (pos < page_size)
+    {
+	uint32_t zero_start = pos;
+
+	while ((pos < page_size) && (prev[pos] == cur[pos]))
+	{
+	    pos += 1;
+	}
+
+	uint32_t literal_start = pos;
+
+	// End a literal run once there are at least 4 matching bytes in a row
+	while (pos < page_size)
+	{
+	    if (prev[pos] == cur[pos])
+	    {
+		uint32_t run = 0;
+
+		while (((pos + run) < page_size) && (prev[pos + run] == cur[pos + run]) && (run < 4))
+		{
+		    run += 1;
+		}
+
+		if ((run == 4) || ((pos + run) == page_size))
+		{
+		    break;
+		}
+
+		pos += run;
+	    }
+	    else
+	    {
+		pos += 1;
+	    }
+	}
+
+	uint32_t zero_len = (literal_start - zero_start);
+	uint32_t literal_len = (pos - literal_start);
+
+	if (literal_len == 0)
+	{
+	    break;
+	}
+
+	out.push_back(zero_len & 0xFF);
+	out.push_back(zero_len >> 8);
+	out.push_back(literal_len & 0xFF);
+	out.push_back(literal_len >> 8);
+
+	for (uint32_t index = literal_start; index < pos; index++)
+	{
+	    out.push_back(prev[index] ^ cur[index]);
+	}
+    }
+
+    out.shrink_to_fit();
+}
+
+void Bee8086TimeTravel::applydelta(const vector<uint8_t> &delta, uint8_t *page)
+{
+    size_t offs = 0;
+    uint32_t pos = 0;
+
+    while ((offs + 4) <= delta.size())
+    {
+	uint32_t zero_len = (delta[offs] | (delta[offs + 1] << 8));
+	uint32_t literal_len = (delta[offs + 2] | (delta[offs + 3] << 8));
+	offs += 4;
+	pos += zero_len;
+
+	for (uint32_t index = 0; index < literal_len; index++)
+	{
+	    page[pos++] ^= delta[offs++];
+	}
+    }
+}
\ No newline at end of file
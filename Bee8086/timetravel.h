@@ -0,0 +1,139 @@
+/*
+    This file is part of the Bee8086 engine.
+    Copyright (C) 2022 BueniaDev.
+
+    Bee8086 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Bee8086 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Bee8086.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BEE8086_TIMETRAVEL_H
+#define BEE8086_TIMETRAVEL_H
+
+#include "recorder.h"
+#include "scheduler.h"
+#include "memorymap.h"
+using namespace std;
+
+namespace bee8086
+{
+    // Time-travel debugger
+    //
+    // While running forwards, a checkpoint (the CPU state and the memory pages that changed
+    // since the previous checkpoint, XORed against it and run-length encoded) is taken every
+    // "interval" cycles, and every non-deterministic input is logged by a Bee8086Recorder.
+    // Stepping backwards restores the nearest earlier checkpoint and replays the log
+    // from there up to the target instruction.
+    //
+    // Only the CPU and memory are rewound; devices outside the CPU will see
+    // any port writes made while replaying a second time.
+    class Bee8086TimeTravel
+    {
+	public:
+	    // Installs a recorder between "cpu" and "cb"
+	    Bee8086TimeTravel(Bee8086 &cpu, Bee8086Interface &cb);
+	    ~Bee8086TimeTravel();
+
+	    // Sets the scheduler used to run the CPU (or NULL to run it directly),
+	    // so that device events run on the cycle they're due
+	    void setscheduler(Bee8086Scheduler *sched);
+
+	    // Sets the memory map behind the interface (or NULL if there isn't one),
+	    // so that checkpoints only have to look at the pages written since the previous one
+	    void setmemorymap(Bee8086MemoryMap *map);
+
+	    // Sets the number of cycles between checkpoints
+	    void setinterval(uint64_t num_cycles);
+
+	    // Sets the maximum number of checkpoints to keep (the oldest checkpoints,
+	    // and the events logged before them, are dropped once this is exceeded)
+	    void setmaxcheckpoints(size_t num_checkpoints);
+
+	    // Runs a single instruction, and returns the number of cycles it took
+	    int step();
+
+	    // Runs the CPU for up to "num_cycles" cycles (stopping at breakpoints, like Bee8086::runcycles()),
+	    // and returns the number of cycles executed
+	    int runcycles(int num_cycles);
+
+	    // Returns true if the last call to runcycles() stopped at a breakpoint
+	    bool hitbreakpoint();
+
+	    // Steps back by one instruction, and returns false if the start of the history was reached
+	    bool reversestep();
+
+	    // Runs backwards to the most recent breakpoint, and returns false
+	    // (after stopping at the start of the history) if none was hit
+	    bool reversecontinue();
+
+	    // Moves to an instruction count between the start of the history and the furthest point reached
+	    bool seek(uint64_t instr);
+
+	    // Fetches the range of instruction counts that can be moved to
+	    uint64_t getstart();
+	    uint64_t getend();
+
+	    // Fetches the approximate amount of memory used by the checkpoints and the log (in bytes)
+	    size_t getmemoryusage();
+
+	    Bee8086Recorder &getrecorder();
+
+	private:
+	    struct PageDelta
+	    {
+		uint32_t page = 0;
+		vector<uint8_t> data; // Run-length encoded XOR of the page against the previous checkpoint
+	    };
+
+	    struct Checkpoint
+	    {
+		Bee8086State state;
+		size_t log_pos = 0;
+		vector<PageDelta> deltas;
+	    };
+
+	    static constexpr uint32_t page_size = 0x1000;
+	    static constexpr uint32_t memory_size = 0x100000;
+
+	    Bee8086 &core;
+	    Bee8086Interface &inter;
+	    Bee8086Recorder recorder;
+	    Bee8086Scheduler *scheduler = NULL;
+	    Bee8086MemoryMap *memory_map = NULL;
+
+	    uint64_t interval = 1000000;
+	    size_t max_checkpoints = 64;
+
+	    deque<Checkpoint> checkpoints;
+	    vector<uint8_t> first_memory; // Memory at the oldest checkpoint
+	    vector<uint8_t> last_memory; // Memory at the newest checkpoint
+
+	    // Furthest point reached (everything before this is replayed from the log)
+	    uint64_t end_instr = 0;
+	    uint64_t next_checkpoint = 0;
+	    bool is_breakpoint_hit = false;
+
+	    void start();
+	    void takecheckpoint();
+	    vector<uint32_t> getchangedpages();
+	    void dropcheckpoint();
+	    void restorecheckpoint(size_t index);
+	    size_t findcheckpoint(uint64_t instr);
+	    void replayto(uint64_t instr);
+	    void updatemode();
+
+	    void encodedelta(const uint8_t *prev, const uint8_t *cur, vector<uint8_t> &out);
+	    void applydelta(const vector<uint8_t> &delta, uint8_t *page);
+    };
+};
+
+#endif // BEE8086_TIMETRAVEL_H
\ No newline at end of file